@@ -0,0 +1,334 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAIConsiderationKernels.h"
+
+#include "RAILogCategory.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTime.h"
+#include "Math/RandomStream.h"
+#include "Math/VectorRegister.h"
+
+//*************************************************************************
+//* FRAICurveLanes
+//*************************************************************************
+
+void FRAICurveLanes::Reset()
+{
+	RawInputs.Reset();
+	InputMin.Reset();
+	InvInputRange.Reset();
+	Slope.Reset();
+	Steepness.Reset();
+	XShift.Reset();
+	YShift.Reset();
+	Tables.Reset();
+	OutputIndices.Reset();
+}
+
+void FRAICurveLanes::Add(const FRAIConsiderationProgram& Program, int32 InstructionIndex, float RawInput, int32 OutputIndex)
+{
+	const FRAIConsiderationProgram::FInstruction& Instruction = Program.Instructions[InstructionIndex];
+
+	RawInputs.Add(RawInput);
+	InputMin.Add(Instruction.InputMin);
+	InvInputRange.Add(Instruction.InvInputRange);
+	Slope.Add(Instruction.Slope);
+	Steepness.Add(Instruction.Steepness);
+	XShift.Add(Instruction.XShift);
+	YShift.Add(Instruction.YShift);
+	Tables.Add(Instruction.TableOffset != INDEX_NONE ? Program.CurveTables.GetData() + Instruction.TableOffset : nullptr);
+	OutputIndices.Add(OutputIndex);
+}
+
+//*************************************************************************
+//* Scalar reference
+//*************************************************************************
+
+float FRAIConsiderationKernels::EvaluateCurve(ERAIResponseCurveType Type, float RawInput, float InputMin, float InvInputRange,
+                                              float Slope, float Steepness, float XShift, float YShift, const float* Table)
+{
+	const float X = FMath::Clamp((RawInput - InputMin) * InvInputRange, 0.f, 1.f);
+
+	float Y = 0.f;
+	switch (Type)
+	{
+	case ERAIResponseCurveType::Linear:
+		Y = Slope * (X - XShift) + YShift;
+		break;
+
+	case ERAIResponseCurveType::Quadratic:
+		Y = Slope * (X - XShift) * (X - XShift) + YShift;
+		break;
+
+	case ERAIResponseCurveType::Logistic:
+		Y = Slope / (1.f + FMath::Exp(-Steepness * (X - XShift))) + YShift;
+		break;
+
+	case ERAIResponseCurveType::Curve:
+		if (Table)
+		{
+			const float Sample = X * FRAIConsiderationProgram::CurveTableSegments;
+			const int32 Lower = FMath::Min(FMath::FloorToInt32(Sample), FRAIConsiderationProgram::CurveTableSegments - 1);
+			Y = FMath::Lerp(Table[Lower], Table[Lower + 1], Sample - Lower);
+		}
+		break;
+	}
+
+	return FMath::Clamp(Y, 0.f, 1.f);
+}
+
+void FRAIConsiderationKernels::EvaluateCurvesScalar(ERAIResponseCurveType Type, const FRAICurveLanes& Lanes, int32 First, int32 Count,
+                                                    float* OutResponses)
+{
+	for (int32 Lane = 0; Lane < Count; ++Lane)
+	{
+		const int32 Index = First + Lane;
+		OutResponses[Lane] = EvaluateCurve(Type, Lanes.RawInputs[Index], Lanes.InputMin[Index], Lanes.InvInputRange[Index],
+		                                   Lanes.Slope[Index], Lanes.Steepness[Index], Lanes.XShift[Index], Lanes.YShift[Index],
+		                                   Lanes.Tables[Index]);
+	}
+}
+
+void FRAIConsiderationKernels::CompareInterruptGapsScalar(const float* CandidatePriorities, const float* ActivePriorities,
+                                                          const float* Gaps, bool* OutShouldInterrupt, int32 Num)
+{
+	for (int32 Index = 0; Index < Num; ++Index)
+	{
+		OutShouldInterrupt[Index] = CandidatePriorities[Index] - ActivePriorities[Index] > Gaps[Index];
+	}
+}
+
+//*************************************************************************
+//* Vectorized
+//*************************************************************************
+
+void FRAIConsiderationKernels::EvaluateCurves(ERAIResponseCurveType Type, const FRAICurveLanes& Lanes, int32 First, int32 Count,
+                                              float* OutResponses)
+{
+	const VectorRegister4Float Zero = GlobalVectorConstants::FloatZero;
+	const VectorRegister4Float One = GlobalVectorConstants::FloatOne;
+	const int32 VectorCount = Count - Count % LaneWidth;
+
+	for (int32 Lane = 0; Lane < VectorCount; Lane += LaneWidth)
+	{
+		const int32 Index = First + Lane;
+
+		const VectorRegister4Float Raw = VectorLoad(Lanes.RawInputs.GetData() + Index);
+		const VectorRegister4Float Min = VectorLoad(Lanes.InputMin.GetData() + Index);
+		const VectorRegister4Float InvRange = VectorLoad(Lanes.InvInputRange.GetData() + Index);
+		const VectorRegister4Float X = VectorMin(VectorMax(VectorMultiply(VectorSubtract(Raw, Min), InvRange), Zero), One);
+
+		VectorRegister4Float Y;
+		if (Type == ERAIResponseCurveType::Curve)
+		{
+			// Table lookups are a gather, do the index math in scalar and only the lerp in vector form
+			alignas(16) float XValues[LaneWidth];
+			alignas(16) float LowerValues[LaneWidth];
+			alignas(16) float UpperValues[LaneWidth];
+			alignas(16) float Alphas[LaneWidth];
+			VectorStoreAligned(X, XValues);
+
+			for (int32 SubLane = 0; SubLane < LaneWidth; ++SubLane)
+			{
+				const float* Table = Lanes.Tables[Index + SubLane];
+				const float Sample = XValues[SubLane] * FRAIConsiderationProgram::CurveTableSegments;
+				const int32 Lower = FMath::Min(FMath::FloorToInt32(Sample), FRAIConsiderationProgram::CurveTableSegments - 1);
+				LowerValues[SubLane] = Table ? Table[Lower] : 0.f;
+				UpperValues[SubLane] = Table ? Table[Lower + 1] : 0.f;
+				Alphas[SubLane] = Sample - Lower;
+			}
+
+			const VectorRegister4Float Lower = VectorLoadAligned(LowerValues);
+			const VectorRegister4Float Upper = VectorLoadAligned(UpperValues);
+			Y = VectorMultiplyAdd(VectorSubtract(Upper, Lower), VectorLoadAligned(Alphas), Lower);
+		}
+		else
+		{
+			const VectorRegister4Float Slope = VectorLoad(Lanes.Slope.GetData() + Index);
+			const VectorRegister4Float Shifted = VectorSubtract(X, VectorLoad(Lanes.XShift.GetData() + Index));
+			const VectorRegister4Float YShift = VectorLoad(Lanes.YShift.GetData() + Index);
+
+			switch (Type)
+			{
+			case ERAIResponseCurveType::Quadratic:
+				Y = VectorMultiplyAdd(VectorMultiply(Slope, Shifted), Shifted, YShift);
+				break;
+
+			case ERAIResponseCurveType::Logistic:
+				{
+					const VectorRegister4Float Steepness = VectorLoad(Lanes.Steepness.GetData() + Index);
+					const VectorRegister4Float Exponent = VectorExp(VectorNegate(VectorMultiply(Steepness, Shifted)));
+					Y = VectorAdd(VectorDivide(Slope, VectorAdd(One, Exponent)), YShift);
+				}
+				break;
+
+			default:
+				Y = VectorMultiplyAdd(Slope, Shifted, YShift);
+				break;
+			}
+		}
+
+		VectorStore(VectorMin(VectorMax(Y, Zero), One), OutResponses + Lane);
+	}
+
+	EvaluateCurvesScalar(Type, Lanes, First + VectorCount, Count - VectorCount, OutResponses + VectorCount);
+}
+
+void FRAIConsiderationKernels::CompareInterruptGaps(const float* CandidatePriorities, const float* ActivePriorities, const float* Gaps,
+                                                    bool* OutShouldInterrupt, int32 Num)
+{
+	const int32 VectorCount = Num - Num % LaneWidth;
+
+	for (int32 Index = 0; Index < VectorCount; Index += LaneWidth)
+	{
+		const VectorRegister4Float Difference = VectorSubtract(VectorLoad(CandidatePriorities + Index), VectorLoad(ActivePriorities + Index));
+		const int32 Mask = VectorMaskBits(VectorCompareGT(Difference, VectorLoad(Gaps + Index)));
+
+		OutShouldInterrupt[Index + 0] = (Mask & 1) != 0;
+		OutShouldInterrupt[Index + 1] = (Mask & 2) != 0;
+		OutShouldInterrupt[Index + 2] = (Mask & 4) != 0;
+		OutShouldInterrupt[Index + 3] = (Mask & 8) != 0;
+	}
+
+	CompareInterruptGapsScalar(CandidatePriorities + VectorCount, ActivePriorities + VectorCount, Gaps + VectorCount,
+	                           OutShouldInterrupt + VectorCount, Num - VectorCount);
+}
+
+void FRAIConsiderationKernels::ShouldInterruptBatch(const float* CandidatePriorities, const float* ActivePriorities,
+                                                    const ERAIInterruptionType* InterruptTypes, const float* GapTables,
+                                                    const int32* GapTableOffsets, bool* OutShouldInterrupt, int32 Num)
+{
+	// Gather the gaps a block at a time so the comparison itself stays vectorized
+	constexpr int32 BlockSize = 256;
+	float Gaps[BlockSize];
+
+	for (int32 BlockStart = 0; BlockStart < Num; BlockStart += BlockSize)
+	{
+		const int32 BlockCount = FMath::Min(BlockSize, Num - BlockStart);
+		for (int32 Index = 0; Index < BlockCount; ++Index)
+		{
+			Gaps[Index] = GapTables[GapTableOffsets[BlockStart + Index] + static_cast<int32>(InterruptTypes[BlockStart + Index])];
+		}
+
+		CompareInterruptGaps(CandidatePriorities + BlockStart, ActivePriorities + BlockStart, Gaps,
+		                     OutShouldInterrupt + BlockStart, BlockCount);
+	}
+}
+
+//*************************************************************************
+//* Microbenchmark
+//*************************************************************************
+
+#if !UE_BUILD_SHIPPING
+
+static void BenchmarkConsiderationKernels(const TArray<FString>& Args)
+{
+	const int32 LaneCount = Args.Num() > 0 ? FMath::Max(FRAIConsiderationKernels::LaneWidth, FCString::Atoi(*Args[0])) : 100000;
+	constexpr int32 Iterations = 50;
+
+	FRandomStream Random(1234);
+	TArray<float> Table;
+	for (int32 Sample = 0; Sample <= FRAIConsiderationProgram::CurveTableSegments; ++Sample)
+	{
+		Table.Add(Random.FRand());
+	}
+
+	FRAICurveLanes Lanes;
+	for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+	{
+		Lanes.RawInputs.Add(Random.FRandRange(-10.f, 110.f));
+		Lanes.InputMin.Add(0.f);
+		Lanes.InvInputRange.Add(1.f / 100.f);
+		Lanes.Slope.Add(Random.FRandRange(-1.f, 1.f));
+		Lanes.Steepness.Add(Random.FRandRange(1.f, 20.f));
+		Lanes.XShift.Add(Random.FRand());
+		Lanes.YShift.Add(Random.FRand());
+		Lanes.Tables.Add(Table.GetData());
+		Lanes.OutputIndices.Add(Lane);
+	}
+
+	TArray<float> ScalarOut;
+	TArray<float> VectorOut;
+	ScalarOut.SetNumUninitialized(LaneCount);
+	VectorOut.SetNumUninitialized(LaneCount);
+
+	const ERAIResponseCurveType Types[] = {
+		ERAIResponseCurveType::Linear, ERAIResponseCurveType::Quadratic, ERAIResponseCurveType::Logistic, ERAIResponseCurveType::Curve
+	};
+
+	for (const ERAIResponseCurveType Type : Types)
+	{
+		const double ScalarStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			FRAIConsiderationKernels::EvaluateCurvesScalar(Type, Lanes, 0, LaneCount, ScalarOut.GetData());
+		}
+		const double ScalarSeconds = FPlatformTime::Seconds() - ScalarStart;
+
+		const double VectorStart = FPlatformTime::Seconds();
+		for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+		{
+			FRAIConsiderationKernels::EvaluateCurves(Type, Lanes, 0, LaneCount, VectorOut.GetData());
+		}
+		const double VectorSeconds = FPlatformTime::Seconds() - VectorStart;
+
+		float MaxError = 0.f;
+		for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+		{
+			MaxError = FMath::Max(MaxError, FMath::Abs(ScalarOut[Lane] - VectorOut[Lane]));
+		}
+
+		UE_LOG(LogRAI, Display, TEXT("%-10s scalar %6.2f ns/lane, vector %6.2f ns/lane, speedup %.2fx, max error %g"),
+		       *StaticEnum<ERAIResponseCurveType>()->GetNameStringByValue(static_cast<int64>(Type)),
+		       ScalarSeconds * 1e9 / (LaneCount * Iterations), VectorSeconds * 1e9 / (LaneCount * Iterations),
+		       VectorSeconds > 0.0 ? ScalarSeconds / VectorSeconds : 0.0, MaxError);
+	}
+
+	TArray<bool> ScalarDecisions;
+	TArray<bool> VectorDecisions;
+	ScalarDecisions.SetNumUninitialized(LaneCount);
+	VectorDecisions.SetNumUninitialized(LaneCount);
+
+	TArray<float> CandidatePriorities;
+	TArray<float> ActivePriorities;
+	TArray<float> Gaps;
+	for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+	{
+		CandidatePriorities.Add(Random.FRandRange(0.f, 300.f));
+		ActivePriorities.Add(Random.FRandRange(0.f, 300.f));
+		Gaps.Add(Random.FRandRange(0.f, 100.f));
+	}
+
+	const double ScalarStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		FRAIConsiderationKernels::CompareInterruptGapsScalar(CandidatePriorities.GetData(), ActivePriorities.GetData(), Gaps.GetData(),
+		                                                     ScalarDecisions.GetData(), LaneCount);
+	}
+	const double ScalarSeconds = FPlatformTime::Seconds() - ScalarStart;
+
+	const double VectorStart = FPlatformTime::Seconds();
+	for (int32 Iteration = 0; Iteration < Iterations; ++Iteration)
+	{
+		FRAIConsiderationKernels::CompareInterruptGaps(CandidatePriorities.GetData(), ActivePriorities.GetData(), Gaps.GetData(),
+		                                               VectorDecisions.GetData(), LaneCount);
+	}
+	const double VectorSeconds = FPlatformTime::Seconds() - VectorStart;
+
+	int32 Mismatches = 0;
+	for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+	{
+		Mismatches += ScalarDecisions[Lane] != VectorDecisions[Lane] ? 1 : 0;
+	}
+
+	UE_LOG(LogRAI, Display, TEXT("%-10s scalar %6.2f ns/lane, vector %6.2f ns/lane, speedup %.2fx, mismatches %d"),
+	       TEXT("Interrupt"), ScalarSeconds * 1e9 / (LaneCount * Iterations), VectorSeconds * 1e9 / (LaneCount * Iterations),
+	       VectorSeconds > 0.0 ? ScalarSeconds / VectorSeconds : 0.0, Mismatches);
+}
+
+static FAutoConsoleCommand BenchmarkConsiderationKernelsCommand(
+	TEXT("rai.BenchmarkConsiderationKernels"),
+	TEXT("Compares the scalar and vectorized response curve and interrupt gap kernels. Optional argument: lane count (default 100000)."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&BenchmarkConsiderationKernels));
+
+#endif
@@ -0,0 +1,254 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAIConsiderationSet.h"
+
+#include "RAIConsiderationKernels.h"
+#include "RAILogCategory.h"
+#include "RAIManagerComponent.h"
+#include "RAIManagerToPawnInterface.h"
+#include "RAITaskComponent.h"
+#include "Curves/CurveFloat.h"
+#include "GameFramework/Pawn.h"
+#include "SubSystems/RAIKnowledgeComponent.h"
+
+//*************************************************************************
+//* FRAIConsiderationProgram
+//*************************************************************************
+
+void FRAIConsiderationProgram::GatherInputs(const FRAIConsiderationContext& Context, float* OutRawInputs) const
+{
+	const bool PawnHasInterface = Context.Pawn && Context.Pawn->Implements<URAIManagerToPawnInterface>();
+
+	for (int32 Index = 0; Index < Instructions.Num(); ++Index)
+	{
+		const FInstruction& Instruction = Instructions[Index];
+		float Value = 0.f;
+
+		switch (Instruction.Input)
+		{
+		case ERAIConsiderationInput::Constant:
+			Value = Instruction.InputMax;
+			break;
+
+		case ERAIConsiderationInput::PawnStat:
+			Value = PawnHasInterface ? IRAIManagerToPawnInterface::Execute_GetNormalizedStat(Context.Pawn, Instruction.StatName) : 0.f;
+			break;
+
+		case ERAIConsiderationInput::PawnIsInMelee:
+			Value = PawnHasInterface && IRAIManagerToPawnInterface::Execute_IsInMelee(Context.Pawn) ? 1.f : 0.f;
+			break;
+
+		case ERAIConsiderationInput::HasFocus:
+			Value = Context.Focus ? 1.f : 0.f;
+			break;
+
+		case ERAIConsiderationInput::DistanceToFocus:
+			Value = Context.Manager ? Context.Manager->DistanceToFocus : 0.f;
+			break;
+
+		case ERAIConsiderationInput::DistanceToFocusLastDetectedPoint:
+			Value = Context.Manager ? Context.Manager->DistanceToFocusLastDetectedPoint : 0.f;
+			break;
+
+		case ERAIConsiderationInput::FocusRelation:
+			Value = Context.Knowledge && Context.Focus && Context.Knowledge->HasRelation(Context.Focus, Instruction.Tag) ? 1.f : 0.f;
+			break;
+
+		case ERAIConsiderationInput::TaskIsActive:
+			Value = Context.Task && Context.Task->GetIsTaskActive() ? 1.f : 0.f;
+			break;
+
+		case ERAIConsiderationInput::TimeSinceTaskBegun:
+			Value = Context.Task && Context.Task->GetWorldTimeBegun() >= 0.f
+				        ? Context.WorldTime - Context.Task->GetWorldTimeBegun()
+				        : Instruction.InputMax;
+			break;
+		}
+
+		OutRawInputs[Index] = Value;
+	}
+}
+
+float FRAIConsiderationProgram::EvaluateResponse(int32 InstructionIndex, float RawInput) const
+{
+	const FInstruction& Instruction = Instructions[InstructionIndex];
+	const float* Table = Instruction.TableOffset != INDEX_NONE ? CurveTables.GetData() + Instruction.TableOffset : nullptr;
+
+	return FRAIConsiderationKernels::EvaluateCurve(Instruction.CurveType, RawInput, Instruction.InputMin, Instruction.InvInputRange,
+	                                               Instruction.Slope, Instruction.Steepness, Instruction.XShift, Instruction.YShift, Table);
+}
+
+float FRAIConsiderationProgram::CombineResponses(const float* Responses) const
+{
+	const int32 Count = Instructions.Num();
+	if (Count == 0)
+	{
+		return 0.f;
+	}
+
+	float Combined = Combine == ERAIConsiderationCombine::Multiply ? 1.f : 0.f;
+	if (Combine == ERAIConsiderationCombine::Min)
+	{
+		Combined = TNumericLimits<float>::Max();
+	}
+
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		const float Contribution = Instructions[Index].Weight * Responses[Index];
+
+		switch (Combine)
+		{
+		case ERAIConsiderationCombine::Multiply:
+			Combined *= Contribution;
+			break;
+
+		case ERAIConsiderationCombine::Average:
+		case ERAIConsiderationCombine::Sum:
+			Combined += Contribution;
+			break;
+
+		case ERAIConsiderationCombine::Min:
+			Combined = FMath::Min(Combined, Contribution);
+			break;
+
+		case ERAIConsiderationCombine::Max:
+			Combined = FMath::Max(Combined, Contribution);
+			break;
+		}
+	}
+
+	if (Combine == ERAIConsiderationCombine::Average)
+	{
+		Combined = WeightSum > 0.f ? Combined / WeightSum : 0.f;
+	}
+
+	return Combined * PriorityScale;
+}
+
+float FRAIConsiderationProgram::Score(const float* RawInputs) const
+{
+	float Responses[MaxInstructions];
+	for (int32 Index = 0; Index < Instructions.Num(); ++Index)
+	{
+		Responses[Index] = EvaluateResponse(Index, RawInputs[Index]);
+	}
+
+	return CombineResponses(Responses);
+}
+
+float FRAIConsiderationProgram::Evaluate(const FRAIConsiderationContext& Context) const
+{
+	float RawInputs[MaxInstructions];
+	GatherInputs(Context, RawInputs);
+	return Score(RawInputs);
+}
+
+//*************************************************************************
+//* URAIConsiderationSet
+//*************************************************************************
+
+static ERAIPriorityDependency GetInputDependencies(ERAIConsiderationInput Input)
+{
+	switch (Input)
+	{
+	case ERAIConsiderationInput::PawnStat:
+	case ERAIConsiderationInput::PawnIsInMelee:
+		return ERAIPriorityDependency::PawnStats;
+
+	case ERAIConsiderationInput::HasFocus:
+	case ERAIConsiderationInput::DistanceToFocus:
+	case ERAIConsiderationInput::DistanceToFocusLastDetectedPoint:
+		return ERAIPriorityDependency::Focus;
+
+	case ERAIConsiderationInput::FocusRelation:
+		return ERAIPriorityDependency::Focus | ERAIPriorityDependency::Knowledge;
+
+	case ERAIConsiderationInput::TimeSinceTaskBegun:
+		return ERAIPriorityDependency::Always;
+
+	// TaskIsActive is covered by the manager invalidating a task when it starts or ends
+	case ERAIConsiderationInput::Constant:
+	case ERAIConsiderationInput::TaskIsActive:
+	default:
+		return ERAIPriorityDependency::None;
+	}
+}
+
+TSharedPtr<const FRAIConsiderationProgram> URAIConsiderationSet::GetProgram() const
+{
+	if (!CompiledProgram.IsValid())
+	{
+		CompiledProgram = Compile();
+	}
+
+	return CompiledProgram;
+}
+
+#if WITH_EDITOR
+void URAIConsiderationSet::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Managers that already compiled keep their copy, newly initialized ones pick up the edit
+	CompiledProgram.Reset();
+}
+#endif
+
+TSharedPtr<const FRAIConsiderationProgram> URAIConsiderationSet::Compile() const
+{
+	TSharedPtr<FRAIConsiderationProgram> Program = MakeShared<FRAIConsiderationProgram>();
+	Program->Combine = CombineOperator;
+	Program->PriorityScale = PriorityScale;
+
+	int32 ConsiderationCount = Considerations.Num();
+	if (ConsiderationCount > FRAIConsiderationProgram::MaxInstructions)
+	{
+		UE_LOG(LogRAI, Warning, TEXT("Consideration set %s has %d considerations, only the first %d are used"),
+		       *GetName(), ConsiderationCount, FRAIConsiderationProgram::MaxInstructions);
+		ConsiderationCount = FRAIConsiderationProgram::MaxInstructions;
+	}
+
+	Program->Instructions.Reserve(ConsiderationCount);
+
+	for (int32 Index = 0; Index < ConsiderationCount; ++Index)
+	{
+		const FRAIConsideration& Consideration = Considerations[Index];
+		FRAIConsiderationProgram::FInstruction& Instruction = Program->Instructions.AddDefaulted_GetRef();
+
+		Instruction.Input = Consideration.Input;
+		Instruction.CurveType = Consideration.ResponseCurve.Type;
+		Instruction.InputMin = Consideration.InputMin;
+		Instruction.InputMax = Consideration.InputMax;
+		const float InputRange = Consideration.InputMax - Consideration.InputMin;
+		Instruction.InvInputRange = FMath::IsNearlyZero(InputRange) ? 0.f : 1.f / InputRange;
+		Instruction.Slope = Consideration.ResponseCurve.Slope;
+		Instruction.Steepness = Consideration.ResponseCurve.Steepness;
+		Instruction.XShift = Consideration.ResponseCurve.XShift;
+		Instruction.YShift = Consideration.ResponseCurve.YShift;
+		Instruction.Weight = Consideration.Weight;
+		Instruction.StatName = Consideration.StatName;
+		Instruction.Tag = Consideration.Tag;
+		Program->WeightSum += Consideration.Weight;
+		Program->Dependencies |= GetInputDependencies(Consideration.Input);
+
+		if (Instruction.CurveType == ERAIResponseCurveType::Curve)
+		{
+			Instruction.TableOffset = Program->CurveTables.Num();
+
+			const UCurveFloat* Curve = Consideration.ResponseCurve.Curve;
+			if (!Curve)
+			{
+				UE_LOG(LogRAI, Warning, TEXT("Consideration %d in %s uses a Curve response without a curve asset, it will score 0"),
+				       Index, *GetName());
+			}
+
+			for (int32 Sample = 0; Sample <= FRAIConsiderationProgram::CurveTableSegments; ++Sample)
+			{
+				const float X = static_cast<float>(Sample) / FRAIConsiderationProgram::CurveTableSegments;
+				Program->CurveTables.Add(Curve ? Curve->GetFloatValue(X) : 0.f);
+			}
+		}
+	}
+
+	return Program;
+}
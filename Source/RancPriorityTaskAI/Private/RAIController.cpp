@@ -4,12 +4,14 @@
 
 #include "GameplayTagContainer.h"
 #include "RAILogCategory.h"
+#include "RAIStats.h"
 #include "RAIManagerComponent.h"
 #include "RAITaskComponent.h"
 #include "Perception/AIPerceptionComponent.h"
 #include "NavigationSystem.h"
 #include "Navigation/PathFollowingComponent.h"
 #include "GameFramework/Pawn.h"
+#include "TimerManager.h"
 #include "VisualLogger/VisualLogger.h"
 #include "DrawDebugHelpers.h"
 
@@ -40,33 +42,81 @@ inline void ARAIController::BeginPlay()
 	}
 }
 
-void ARAIController::TraceThought(FString Thought)
+void ARAIController::TraceThought(const FString& Thought)
 {
-    Thoughts.Add(Thought);
-	OnThoughtTrace.Broadcast(Thought);
+#if RAI_THOUGHT_TRACE_ENABLED
+	ThoughtBuffer.SetCapacity(MaxThoughtMemoryCount);
+	ThoughtBuffer.AddText(Thought, GetWorld()->GetTimeSeconds());
+	PublishLatestThought();
+#endif
+}
+
+void ARAIController::TraceThoughtEvent(ERAIThoughtType Type, FName Subject, int32 Value)
+{
+#if RAI_THOUGHT_TRACE_ENABLED
+	ThoughtBuffer.SetCapacity(MaxThoughtMemoryCount);
+	ThoughtBuffer.Add(Type, Subject, Value, GetWorld()->GetTimeSeconds());
+	PublishLatestThought();
+#endif
+}
+
+void ARAIController::GetThoughts(TArray<FString>& OutThoughts) const
+{
+	OutThoughts.Reset();
+#if RAI_THOUGHT_TRACE_ENABLED
+	ThoughtBuffer.CopyFormatted(OutThoughts);
+#endif
+}
 
-	// Check if the thoughts count exceeds the maximum allowed
-	if (Thoughts.Num() > MaxThoughtMemoryCount)
+#if RAI_THOUGHT_TRACE_ENABLED
+void ARAIController::PublishLatestThought()
+{
+	const bool HasListeners = OnThoughtTrace.IsBound();
+	if (!MirrorThoughtsToArray && !HasListeners)
 	{
-		// Calculate the number of thoughts to remove
-		int32 ThoughtsToRemove = Thoughts.Num() - MaxThoughtMemoryCount;
+		return;
+	}
 
-		// Remove the older half of thoughts
-		Thoughts.RemoveAt(0, ThoughtsToRemove);
+	if (HasListeners)
+	{
+		OnThoughtTrace.Broadcast(FRAIThoughtBuffer::Format(ThoughtBuffer.Last()));
+	}
+
+	// Every thought traced this frame is picked up by one rebuild
+	if (MirrorThoughtsToArray && !ThoughtsMirrorDirty)
+	{
+		ThoughtsMirrorDirty = true;
+		GetWorldTimerManager().SetTimerForNextTick(this, &ARAIController::RefreshThoughtsMirror);
 	}
 }
 
+void ARAIController::RefreshThoughtsMirror()
+{
+	ThoughtsMirrorDirty = false;
+	Thoughts.Reset();
+	ThoughtBuffer.CopyFormatted(Thoughts);
+}
+#endif
+
 void ARAIController::TriggerCustom(TSubclassOf<URAITaskComponent> Task, FGameplayTag Trigger, UObject* Payload)
 {
 	if (ManagerComponent)
 	{
+		// GetTaskByClass reports a missing task once per class
 		if (auto* FoundTask = ManagerComponent->GetTaskByClass(Task))
 		{
 			FoundTask->OnCustomTrigger(Trigger, Payload);
 		}
-		else
+	}
+}
+
+void ARAIController::TriggerCustomByHandle(FRAITaskHandle TaskHandle, FGameplayTag Trigger, UObject* Payload)
+{
+	if (ManagerComponent)
+	{
+		if (auto* FoundTask = ManagerComponent->GetTaskByHandle(TaskHandle))
 		{
-			UE_LOG(LogRAI, Warning, TEXT("TriggerCustom: Task not found: %s"), *Task->GetName());
+			FoundTask->OnCustomTrigger(Trigger, Payload);
 		}
 	}
 }
@@ -87,7 +137,7 @@ void ARAIController::SetRAIActive(bool ShouldBeActive)
 	bRAIActive = ShouldBeActive;
 	ManagerComponent->SetActive(ShouldBeActive);
 
-	TraceThought(FString("RAI set to: ") + (ShouldBeActive ? "Active" : "Inactive"));
+	RAI_TRACE_THOUGHT(this, ERAIThoughtType::RAIActiveChanged, NAME_None, ShouldBeActive ? 1 : 0);
 	if (ShouldBeActive)
 	{
 		AIPerceptionComponent->OnTargetPerceptionUpdated.AddDynamic(this, &ARAIController::OnPerceptionUpdated);
@@ -122,7 +172,7 @@ void ARAIController::OnPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus)
 {
 	if (ManagerComponent)
 	{
-		ManagerComponent->OnPerceptionStimulus(Actor, Stimulus);
+		ManagerComponent->QueuePerceptionStimulus(Actor, Stimulus);
 	}
 }
 
@@ -131,6 +181,9 @@ void ARAIController::OnPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus)
 
 FPathFollowingRequestResult ARAIController::MoveTo(const FAIMoveRequest& MoveRequest, FNavPathSharedPtr* OutPath)
 {
+	// A new move replaces the one an asynchronous smooth path was being stitched for
+	AbortAsyncSmoothPath();
+
 	if (!bEnableSmoothPaths)
 		return Super::MoveTo(MoveRequest, OutPath);
 	
@@ -160,6 +213,79 @@ FPathFollowingRequestResult ARAIController::MoveTo(const FAIMoveRequest& MoveReq
 		return ResultData;
 	}
 
+	// --- Cached Smooth Path ---
+	URAISmoothPathCacheSubsystem* PathCache = UseSmoothPathCache ? GetWorld()->GetSubsystem<URAISmoothPathCacheSubsystem>() : nullptr;
+	FRAISmoothPathKey CacheKey;
+	const ANavigationData* NavData = nullptr;
+	if (PathCache && !MakeSmoothPathKey(MoveRequest, *PathCache, CacheKey, NavData))
+	{
+		PathCache = nullptr;
+	}
+
+	if (PathCache)
+	{
+		FNavPathSharedPtr CachedPath = PathCache->FindPath(CacheKey, *NavData, GetPawn()->GetActorLocation(), MoveRequest.GetGoalLocation());
+		if (CachedPath.IsValid())
+		{
+			UE_VLOG(this, LogSmoothPathAI, Log, TEXT("Using cached smooth path with %d points."), CachedPath->GetPathPoints().Num());
+
+			if (MoveRequest.GetGoalActor() != nullptr)
+			{
+				CachedPath->SetGoalActorObservation(*MoveRequest.GetGoalActor(), 100.0f);
+			}
+
+			if (OutPath)
+			{
+				*OutPath = CachedPath;
+			}
+
+			ResultData.MoveId = RequestMove(MoveRequest, CachedPath);
+			ResultData.Code = ResultData.MoveId.IsValid() ? EPathFollowingRequestResult::RequestSuccessful : EPathFollowingRequestResult::Failed;
+			return ResultData;
+		}
+	}
+
+	if (AsyncSmoothPaths)
+	{
+		UE_VLOG(this, LogSmoothPathAI, Log, TEXT("Attempting to generate an asynchronous smooth path..."));
+		FNavPathSharedPtr FirstSegment = BeginAsyncSmoothPath(MoveRequest);
+
+		if (FirstSegment.IsValid())
+		{
+			if (OutPath)
+			{
+				*OutPath = FirstSegment;
+			}
+
+			ResultData.MoveId = RequestMove(MoveRequest, FirstSegment);
+			ResultData.Code = ResultData.MoveId.IsValid() ? EPathFollowingRequestResult::RequestSuccessful : EPathFollowingRequestResult::Failed;
+
+			if (ResultData.MoveId.IsValid() && AsyncSmoothPath.IsValid())
+			{
+				AsyncSmoothMoveId = ResultData.MoveId;
+				if (PathCache)
+				{
+					AsyncSmoothCacheKey = CacheKey;
+					AsyncSmoothCacheInvalidations = PathCache->Invalidations;
+				}
+			}
+			else
+			{
+				AbortAsyncSmoothPath();
+
+				// A single segment is the complete path
+				if (PathCache && ResultData.MoveId.IsValid())
+				{
+					PathCache->AddPath(CacheKey, *FirstSegment);
+				}
+			}
+			return ResultData;
+		}
+
+		UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("Failed to start an asynchronous smooth path. Falling back to default AAIController::MoveTo."));
+		return Super::MoveTo(MoveRequest, OutPath);
+	}
+
 	// --- Custom Smooth Path Logic ---
 	UE_VLOG(this, LogSmoothPathAI, Log, TEXT("Attempting to generate a smooth path..."));
 	FNavPathSharedPtr SmoothPath = GenerateSmoothPath(MoveRequest);
@@ -167,6 +293,11 @@ FPathFollowingRequestResult ARAIController::MoveTo(const FAIMoveRequest& MoveReq
 	if (SmoothPath.IsValid() && SmoothPath->IsValid() && SmoothPath->GetPathPoints().Num() > 0)
 	{
 		UE_VLOG(this, LogSmoothPathAI, Log, TEXT("Successfully generated smooth path with %d points."), SmoothPath->GetPathPoints().Num());
+
+		if (PathCache)
+		{
+			PathCache->AddPath(CacheKey, *SmoothPath);
+		}
 		
 		if (OutPath)
 		{
@@ -185,18 +316,71 @@ FPathFollowingRequestResult ARAIController::MoveTo(const FAIMoveRequest& MoveReq
 
 FNavPathSharedPtr ARAIController::GenerateSmoothPath(const FAIMoveRequest& MoveRequest) const
 {
-	const APawn* ControlledPawn = GetPawn();
-	if (!ControlledPawn) return nullptr;
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(RAI_GenerateSmoothPath, RAIChannel);
 
 	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
 	if (!NavSys) return nullptr;
 
 	TArray<FVector> CandidatePoints;
+	if (!BuildSmoothPathCandidates(MoveRequest, CandidatePoints)) return nullptr;
+
+	FNavPathSharedPtr CompositePath = nullptr;
+
+	for (int32 i = 0; i < CandidatePoints.Num() - 1; ++i)
+	{
+		const FVector& StartPoint = CandidatePoints[i];
+		const FVector& EndPoint = CandidatePoints[i + 1];
+
+		FPathFindingQuery Query;
+		if (!BuildPathfindingQuery(MoveRequest, StartPoint, Query))
+		{
+			UE_VLOG(this, LogSmoothPathAI, Error, TEXT("Failed to build pathfinding query for segment %d."), i);
+			return nullptr;
+		}
+		Query.EndLocation = EndPoint;
+
+		RAI_COUNT(SmoothPathSegments, 1);
+		FPathFindingResult PathResult = NavSys->FindPathSync(Query);
+
+		if (PathResult.IsSuccessful() && PathResult.Path.IsValid())
+		{
+			UE_VLOG(this, LogSmoothPathAI, Verbose, TEXT("✓ SUCCESS: Found path for segment %d to %d."), i, i + 1);
+
+			if (!CompositePath.IsValid())
+			{
+				CompositePath = PathResult.Path;
+			}
+			else
+			{
+				StitchPathSegments(CompositePath, PathResult.Path);
+			}
+		}
+		else
+		{
+			UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("✗ FAILED: Could not find path for segment %d to %d. Aborting smooth path generation."), i, i + 1);
+			return nullptr;
+		}
+	}
+
+	if (CompositePath.IsValid() && MoveRequest.GetGoalActor() != nullptr)
+	{
+		CompositePath->SetGoalActorObservation(*MoveRequest.GetGoalActor(), 100.0f);
+	}
+
+	return CompositePath;
+}
+
+bool ARAIController::BuildSmoothPathCandidates(const FAIMoveRequest& MoveRequest, TArray<FVector>& OutCandidatePoints) const
+{
+	const APawn* ControlledPawn = GetPawn();
+	if (!ControlledPawn) return false;
+
+	OutCandidatePoints.Reset();
 	FVector CurrentPos = ControlledPawn->GetActorLocation();
 	FVector CurrentDir = ControlledPawn->GetActorForwardVector().GetSafeNormal2D();
 	const FVector GoalLocation = MoveRequest.GetGoalLocation();
 
-	CandidatePoints.Add(CurrentPos);
+	OutCandidatePoints.Add(CurrentPos);
 
 	const float AngleThresholdDot = FMath::Cos(FMath::DegreesToRadians(CurveAngleThreshold));
 
@@ -221,78 +405,240 @@ FNavPathSharedPtr ARAIController::GenerateSmoothPath(const FAIMoveRequest& MoveR
 
 		const FVector NextPos = CurrentPos + NextDir * SegmentLength;
 		
-		CandidatePoints.Add(NextPos);
+		OutCandidatePoints.Add(NextPos);
 
 		UE_VLOG_LOCATION(this, LogSmoothPathAI, Verbose, NextPos, 25.f, FColor::Yellow, TEXT("Candidate Point %d"), i);
 
 		// --- Debug line for intermediate points ---
 		if (bDebugSmoothPath && i > 0)
 		{
-			DrawDebugLine(GetWorld(), CandidatePoints[i], CandidatePoints[i + 1], FColor::Green, false, 5.f, 0, 2.0f);
+			DrawDebugLine(GetWorld(), OutCandidatePoints[i], OutCandidatePoints[i + 1], FColor::Green, false, 5.f, 0, 2.0f);
 		}
 
 		CurrentPos = NextPos;
 		CurrentDir = NextDir;
 	}
 
-	CandidatePoints.Add(GoalLocation);
+	OutCandidatePoints.Add(GoalLocation);
 
 	// --- Debug line to the final goal ---
-	if (bDebugSmoothPath && CandidatePoints.Num() >= 2)
+	if (bDebugSmoothPath && OutCandidatePoints.Num() >= 2)
 	{
-		DrawDebugLine(GetWorld(), CandidatePoints[CandidatePoints.Num() - 2], GoalLocation, FColor::Red, false, 5.f, 0, 3.0f);
+		DrawDebugLine(GetWorld(), OutCandidatePoints[OutCandidatePoints.Num() - 2], GoalLocation, FColor::Red, false, 5.f, 0, 3.0f);
 		DrawDebugSphere(GetWorld(), GoalLocation, 25.f, 12, FColor::Red, false, 5.f);
 	}
 
-	if (CandidatePoints.Num() < 2)
+	if (OutCandidatePoints.Num() < 2)
 	{
 		UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("Not enough candidate points generated to form a path."));
-		return nullptr;
+		return false;
 	}
 
-	FNavPathSharedPtr CompositePath = nullptr;
+	return true;
+}
 
-	for (int32 i = 0; i < CandidatePoints.Num() - 1; ++i)
-	{
-		const FVector& StartPoint = CandidatePoints[i];
-		const FVector& EndPoint = CandidatePoints[i + 1];
+FNavPathSharedPtr ARAIController::BeginAsyncSmoothPath(const FAIMoveRequest& MoveRequest)
+{
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL(RAI_BeginAsyncSmoothPath, RAIChannel);
 
-		FPathFindingQuery Query;
-		if (!BuildPathfindingQuery(MoveRequest, StartPoint, Query))
+	UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!NavSys) return nullptr;
+
+	TArray<FVector> CandidatePoints;
+	if (!BuildSmoothPathCandidates(MoveRequest, CandidatePoints)) return nullptr;
+
+	// Build every query before issuing any, so a failure here leaves nothing in flight
+	const int32 SegmentCount = CandidatePoints.Num() - 1;
+	TArray<FPathFindingQuery> Queries;
+	Queries.SetNum(SegmentCount);
+
+	for (int32 i = 0; i < SegmentCount; ++i)
+	{
+		if (!BuildPathfindingQuery(MoveRequest, CandidatePoints[i], Queries[i]))
 		{
 			UE_VLOG(this, LogSmoothPathAI, Error, TEXT("Failed to build pathfinding query for segment %d."), i);
 			return nullptr;
 		}
-		Query.EndLocation = EndPoint;
+		Queries[i].EndLocation = CandidatePoints[i + 1];
+	}
 
-		FPathFindingResult PathResult = NavSys->FindPathSync(Query);
+	AsyncSmoothMoveRequest = MoveRequest;
+	AsyncSegmentQueryIds.SetNumZeroed(SegmentCount);
+	AsyncSegments.SetNum(SegmentCount);
 
-		if (PathResult.IsSuccessful() && PathResult.Path.IsValid())
+	for (int32 i = 1; i < SegmentCount; ++i)
+	{
+		RAI_COUNT(SmoothPathSegments, 1);
+		AsyncSegmentQueryIds[i] = NavSys->FindPathAsync(Queries[i].NavAgentProperties, Queries[i],
+			FNavPathQueryDelegate::CreateUObject(this, &ARAIController::OnSmoothSegmentFound));
+
+		if (AsyncSegmentQueryIds[i] == INVALID_NAVQUERYID)
 		{
-			UE_VLOG(this, LogSmoothPathAI, Verbose, TEXT("✓ SUCCESS: Found path for segment %d to %d."), i, i + 1);
+			UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("✗ FAILED: Could not query segment %d to %d. Aborting smooth path generation."), i, i + 1);
+			AbortAsyncSmoothPath();
+			return nullptr;
+		}
+	}
 
-			if (!CompositePath.IsValid())
-			{
-				CompositePath = PathResult.Path;
-			}
-			else
-			{
-				StitchPathSegments(CompositePath, PathResult.Path);
-			}
+	// The pawn needs a path to start on right away, the first segment is the shortest
+	RAI_COUNT(SmoothPathSegments, 1);
+	FPathFindingResult FirstResult = NavSys->FindPathSync(Queries[0]);
+
+	if (!FirstResult.IsSuccessful() || !FirstResult.Path.IsValid())
+	{
+		UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("✗ FAILED: Could not find path for segment 0 to 1. Aborting smooth path generation."));
+		AbortAsyncSmoothPath();
+		return nullptr;
+	}
+
+	if (SegmentCount == 1)
+	{
+		AbortAsyncSmoothPath();
+		if (MoveRequest.GetGoalActor() != nullptr)
+		{
+			FirstResult.Path->SetGoalActorObservation(*MoveRequest.GetGoalActor(), 100.0f);
 		}
-		else
+		return FirstResult.Path;
+	}
+
+	UE_VLOG(this, LogSmoothPathAI, Verbose, TEXT("Started on segment 0 to 1, %d segments pending."), SegmentCount - 1);
+	AsyncSmoothPath = FirstResult.Path;
+	NextSegmentToStitch = 1;
+
+	// Path following tests arrival against the end of the path, which would be the first candidate point otherwise.
+	// The pawn heads straight for the goal from there if the next segment is late
+	AsyncSmoothPath->GetPathPoints().Add(FNavPathPoint(CandidatePoints.Last()));
+	return AsyncSmoothPath;
+}
+
+void ARAIController::OnSmoothSegmentFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr SegmentPath)
+{
+	const int32 SegmentIndex = QueryId != INVALID_NAVQUERYID ? AsyncSegmentQueryIds.IndexOfByKey(QueryId) : INDEX_NONE;
+	if (SegmentIndex == INDEX_NONE) return; // Belongs to an aborted smooth path
+
+	AsyncSegmentQueryIds[SegmentIndex] = INVALID_NAVQUERYID;
+
+	UPathFollowingComponent* PFollowComp = GetPathFollowingComponent();
+	if (PFollowComp == nullptr || PFollowComp->GetStatus() == EPathFollowingStatus::Idle
+		|| !AsyncSmoothMoveId.IsEquivalent(PFollowComp->GetCurrentRequestId()))
+	{
+		UE_VLOG(this, LogSmoothPathAI, Log, TEXT("The smooth path move has ended, discarding its pending segments."));
+		AbortAsyncSmoothPath();
+		return;
+	}
+
+	if (Result != ENavigationQueryResult::Success || !SegmentPath.IsValid())
+	{
+		UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("✗ FAILED: Could not find path for segment %d to %d. Falling back to the default path."), SegmentIndex, SegmentIndex + 1);
+		FallBackFromAsyncSmoothPath();
+		return;
+	}
+
+	UE_VLOG(this, LogSmoothPathAI, Verbose, TEXT("✓ SUCCESS: Found path for segment %d to %d."), SegmentIndex, SegmentIndex + 1);
+	AsyncSegments[SegmentIndex] = SegmentPath;
+
+	// Arrived ahead of an earlier segment, it is stitched once that one arrives
+	if (!AsyncSegments[NextSegmentToStitch].IsValid()) return;
+
+	// The segments continue from the last stitched point, not from the provisional goal
+	TArray<FNavPathPoint>& PathPoints = AsyncSmoothPath->GetPathPoints();
+	const FNavPathPoint ProvisionalGoal = PathPoints.Pop(EAllowShrinking::No);
+
+	while (NextSegmentToStitch < AsyncSegments.Num() && AsyncSegments[NextSegmentToStitch].IsValid())
+	{
+		StitchPathSegments(AsyncSmoothPath, AsyncSegments[NextSegmentToStitch]);
+		AsyncSegments[NextSegmentToStitch].Reset();
+		++NextSegmentToStitch;
+	}
+
+	if (NextSegmentToStitch < AsyncSegments.Num())
+	{
+		PathPoints.Add(ProvisionalGoal);
+	}
+
+	FNavPathSharedPtr Path = AsyncSmoothPath;
+	const FAIRequestID MoveId = AsyncSmoothMoveId;
+
+	// Forget the completed smooth path before updating the move, which may finish it and start another
+	if (NextSegmentToStitch == AsyncSegments.Num())
+	{
+		if (AsyncSmoothMoveRequest.GetGoalActor() != nullptr)
 		{
-			UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("✗ FAILED: Could not find path for segment %d to %d. Aborting smooth path generation."), i, i + 1);
-			return nullptr;
+			Path->SetGoalActorObservation(*AsyncSmoothMoveRequest.GetGoalActor(), 100.0f);
+		}
+		UE_VLOG(this, LogSmoothPathAI, Log, TEXT("Stitched all segments of the smooth path, %d points."), Path->GetPathPoints().Num());
+
+		// A segment found before a navmesh rebuild would outlive the invalidation in the cache
+		URAISmoothPathCacheSubsystem* PathCache = GetWorld()->GetSubsystem<URAISmoothPathCacheSubsystem>();
+		if (PathCache && AsyncSmoothCacheKey.IsSet() && PathCache->Invalidations == AsyncSmoothCacheInvalidations)
+		{
+			PathCache->AddPath(AsyncSmoothCacheKey.GetValue(), *Path);
 		}
+		AbortAsyncSmoothPath();
 	}
 
-	if (CompositePath.IsValid() && MoveRequest.GetGoalActor() != nullptr)
+	PFollowComp->UpdateMove(Path.ToSharedRef(), MoveId);
+}
+
+bool ARAIController::MakeSmoothPathKey(const FAIMoveRequest& MoveRequest, const URAISmoothPathCacheSubsystem& PathCache,
+                                       FRAISmoothPathKey& OutKey, const ANavigationData*& OutNavData) const
+{
+	const APawn* ControlledPawn = GetPawn();
+	const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld());
+	if (!ControlledPawn || !NavSys) return false;
+
+	OutNavData = NavSys->GetNavDataForProps(GetNavAgentPropertiesRef());
+	if (!OutNavData) return false;
+
+	// Same filter BuildPathfindingQuery ends up using
+	const TSubclassOf<UNavigationQueryFilter> Filter = MoveRequest.GetNavigationFilter() ? MoveRequest.GetNavigationFilter() : DefaultNavigationFilterClass;
+
+	OutKey = PathCache.MakeKey(ControlledPawn->GetActorLocation(), ControlledPawn->GetActorForwardVector(), MoveRequest.GetGoalLocation(),
+	                           *OutNavData, Filter, MoveRequest.IsUsingPartialPaths(), CurveAngleThreshold, MaxCurveSegments, MinCurveSegmentLength);
+	return true;
+}
+
+void ARAIController::AbortAsyncSmoothPath()
+{
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
 	{
-		CompositePath->SetGoalActorObservation(*MoveRequest.GetGoalActor(), 100.0f);
+		for (const uint32 QueryId : AsyncSegmentQueryIds)
+		{
+			if (QueryId != INVALID_NAVQUERYID)
+			{
+				NavSys->AbortAsyncFindPathRequest(QueryId);
+			}
+		}
 	}
 
-	return CompositePath;
+	AsyncSegmentQueryIds.Reset();
+	AsyncSegments.Reset();
+	AsyncSmoothPath.Reset();
+	AsyncSmoothCacheKey.Reset();
+	AsyncSmoothMoveId = FAIRequestID::InvalidRequest;
+	NextSegmentToStitch = 0;
+}
+
+void ARAIController::FallBackFromAsyncSmoothPath()
+{
+	const FAIMoveRequest MoveRequest = AsyncSmoothMoveRequest;
+	const FAIRequestID MoveId = AsyncSmoothMoveId;
+	AbortAsyncSmoothPath();
+
+	UPathFollowingComponent* PFollowComp = GetPathFollowingComponent();
+	FPathFindingQuery Query;
+	if (PFollowComp && BuildPathfindingQuery(MoveRequest, Query))
+	{
+		FNavPathSharedPtr DefaultPath;
+		FindPathForMoveRequest(MoveRequest, Query, DefaultPath);
+
+		if (DefaultPath.IsValid() && PFollowComp->UpdateMove(DefaultPath.ToSharedRef(), MoveId))
+		{
+			return;
+		}
+	}
+
+	UE_VLOG(this, LogSmoothPathAI, Warning, TEXT("No default path either, the pawn heads straight for the goal from the end of the stitched segments."));
 }
 
 void ARAIController::StitchPathSegments(FNavPathSharedPtr& InOutBasePath, const FNavPathSharedPtr& PathToAdd) const
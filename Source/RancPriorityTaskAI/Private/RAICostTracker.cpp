@@ -0,0 +1,210 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAICostTracker.h"
+
+#include "RAILogCategory.h"
+#include "RAITaskComponent.h"
+#include "HAL/IConsoleManager.h"
+
+static int32 GRAICostEnabled = 1;
+static FAutoConsoleVariableRef CVarRAICostEnabled(
+	TEXT("rai.Cost.Enabled"),
+	GRAICostEnabled,
+	TEXT("Record the cost of scoring, beginning and ending tasks per task class, see rai.Cost.Top."));
+
+static float GRAICostDefaultBudgetMs = 0.f;
+static FAutoConsoleVariableRef CVarRAICostDefaultBudgetMs(
+	TEXT("rai.Cost.DefaultBudgetMs"),
+	GRAICostDefaultBudgetMs,
+	TEXT("Budget in milliseconds for a single task call of classes without a CostBudgetMs, read when the class is first seen. 0 disables it."));
+
+static const TCHAR* GetPhaseName(ERAICostPhase Phase)
+{
+	switch (Phase)
+	{
+	case ERAICostPhase::Score:
+		return TEXT("CalculatePriority");
+	case ERAICostPhase::Begin:
+		return TEXT("BeginTask");
+	case ERAICostPhase::End:
+		return TEXT("EndTask");
+	default:
+		return TEXT("All");
+	}
+}
+
+FRAICostScope*& FRAICostScope::GetCurrent()
+{
+	static thread_local FRAICostScope* Current = nullptr;
+	return Current;
+}
+
+void FRAICostStats::Add(double Seconds)
+{
+	Count++;
+	TotalSeconds += Seconds;
+	MaxSeconds = FMath::Max(MaxSeconds, Seconds);
+
+	const double QuarterMicroseconds = FMath::Max(Seconds * 4e6, 1.0);
+	const int32 Bucket = FMath::Min(FMath::FloorToInt32(2.0 * FMath::Log2(QuarterMicroseconds)), BucketCount - 1);
+	Buckets[Bucket]++;
+}
+
+double FRAICostStats::GetPercentileSeconds(double Percentile) const
+{
+	const uint64 Target = FMath::CeilToInt64(Percentile * Count);
+	uint64 Seen = 0;
+	for (int32 Bucket = 0; Bucket < BucketCount; ++Bucket)
+	{
+		Seen += Buckets[Bucket];
+		if (Seen >= Target && Seen > 0)
+		{
+			// Never report more than was actually measured
+			return FMath::Min(0.25e-6 * FMath::Pow(2.0, (Bucket + 1) * 0.5), MaxSeconds);
+		}
+	}
+
+	return MaxSeconds;
+}
+
+FRAICostTracker& FRAICostTracker::Get()
+{
+	static FRAICostTracker Tracker;
+	return Tracker;
+}
+
+bool FRAICostTracker::IsEnabled()
+{
+	return GRAICostEnabled != 0;
+}
+
+int32 FRAICostTracker::RegisterClass(const UClass* TaskClass)
+{
+	if (!TaskClass)
+	{
+		return INDEX_NONE;
+	}
+
+	if (const int32* Slot = SlotByClass.Find(TaskClass))
+	{
+		return *Slot;
+	}
+
+	const int32 Slot = Entries.AddDefaulted();
+	FClassEntry& Entry = Entries[Slot];
+	Entry.ClassName = TaskClass->GetName();
+
+	const URAITaskComponent* Defaults = Cast<URAITaskComponent>(TaskClass->GetDefaultObject());
+	Entry.BudgetMs = Defaults && Defaults->CostBudgetMs > 0.f ? Defaults->CostBudgetMs : GRAICostDefaultBudgetMs;
+
+	SlotByClass.Add(TaskClass, Slot);
+	return Slot;
+}
+
+void FRAICostTracker::Record(int32 ClassSlot, ERAICostPhase Phase, uint64 Cycles)
+{
+	if (!Entries.IsValidIndex(ClassSlot))
+	{
+		return;
+	}
+
+	FClassEntry& Entry = Entries[ClassSlot];
+	const int32 PhaseIndex = static_cast<int32>(Phase);
+	const double Seconds = FPlatformTime::ToSeconds64(Cycles);
+	Entry.Phases[PhaseIndex].Add(Seconds);
+
+	if (Entry.BudgetMs > 0.f && Seconds * 1000.0 > Entry.BudgetMs && !Entry.AnnouncedOverBudget[PhaseIndex])
+	{
+		Entry.AnnouncedOverBudget[PhaseIndex] = true;
+		UE_LOG(LogRAI, Warning, TEXT("Task %s took %.3f ms in %s, over its budget of %.3f ms. Reported once, see rai.Cost.Top"),
+		       *Entry.ClassName, Seconds * 1000.0, GetPhaseName(Phase), Entry.BudgetMs);
+	}
+}
+
+void FRAICostTracker::LogTop(int32 Count, ERAICostPhase Phase) const
+{
+	struct FRow
+	{
+		const FClassEntry* Entry;
+		ERAICostPhase Phase;
+		double TotalSeconds;
+	};
+
+	TArray<FRow> Rows;
+	for (const FClassEntry& Entry : Entries)
+	{
+		for (int32 PhaseIndex = 0; PhaseIndex < static_cast<int32>(ERAICostPhase::Num); ++PhaseIndex)
+		{
+			const ERAICostPhase RowPhase = static_cast<ERAICostPhase>(PhaseIndex);
+			if ((Phase == ERAICostPhase::Num || Phase == RowPhase) && Entry.Phases[PhaseIndex].Count > 0)
+			{
+				Rows.Add({&Entry, RowPhase, Entry.Phases[PhaseIndex].TotalSeconds});
+			}
+		}
+	}
+
+	Rows.Sort([](const FRow& A, const FRow& B) { return A.TotalSeconds > B.TotalSeconds; });
+
+	UE_LOG(LogRAI, Display, TEXT("Most expensive RAI task classes, %s:"), GetPhaseName(Phase));
+	UE_LOG(LogRAI, Display, TEXT("%-40s %-18s %10s %10s %10s %10s %12s %10s"), TEXT("Class"), TEXT("Phase"), TEXT("Calls"),
+	       TEXT("Mean us"), TEXT("P99 us"), TEXT("Max us"), TEXT("Total ms"), TEXT("Budget ms"));
+
+	for (int32 RowIndex = 0; RowIndex < FMath::Min(Count, Rows.Num()); ++RowIndex)
+	{
+		const FRow& Row = Rows[RowIndex];
+		const FRAICostStats& Stats = Row.Entry->Phases[static_cast<int32>(Row.Phase)];
+		UE_LOG(LogRAI, Display, TEXT("%-40s %-18s %10llu %10.2f %10.2f %10.2f %12.3f %10.3f"), *Row.Entry->ClassName, GetPhaseName(Row.Phase),
+		       Stats.Count, Stats.GetMeanSeconds() * 1e6, Stats.GetPercentileSeconds(0.99) * 1e6, Stats.MaxSeconds * 1e6,
+		       Stats.TotalSeconds * 1e3, Row.Entry->BudgetMs);
+	}
+}
+
+void FRAICostTracker::Reset()
+{
+	for (FClassEntry& Entry : Entries)
+	{
+		for (int32 PhaseIndex = 0; PhaseIndex < static_cast<int32>(ERAICostPhase::Num); ++PhaseIndex)
+		{
+			Entry.Phases[PhaseIndex] = FRAICostStats();
+			Entry.AnnouncedOverBudget[PhaseIndex] = false;
+		}
+	}
+}
+
+static void LogTopTaskCosts(const TArray<FString>& Args)
+{
+	int32 Count = 10;
+	ERAICostPhase Phase = ERAICostPhase::Num;
+
+	for (const FString& Arg : Args)
+	{
+		if (Arg.IsNumeric())
+		{
+			Count = FMath::Max(FCString::Atoi(*Arg), 1);
+		}
+		else if (Arg.Equals(TEXT("Score"), ESearchCase::IgnoreCase))
+		{
+			Phase = ERAICostPhase::Score;
+		}
+		else if (Arg.Equals(TEXT("Begin"), ESearchCase::IgnoreCase))
+		{
+			Phase = ERAICostPhase::Begin;
+		}
+		else if (Arg.Equals(TEXT("End"), ESearchCase::IgnoreCase))
+		{
+			Phase = ERAICostPhase::End;
+		}
+	}
+
+	FRAICostTracker::Get().LogTop(Count, Phase);
+}
+
+static FAutoConsoleCommand LogTopTaskCostsCommand(
+	TEXT("rai.Cost.Top"),
+	TEXT("Logs the most expensive task classes across all AIs by total time. Optional arguments: count (default 10), Score, Begin or End."),
+	FConsoleCommandWithArgsDelegate::CreateStatic(&LogTopTaskCosts));
+
+static FAutoConsoleCommand ResetTaskCostsCommand(
+	TEXT("rai.Cost.Reset"),
+	TEXT("Clears the recorded task class costs and rearms the over budget warnings."),
+	FConsoleCommandDelegate::CreateLambda([]() { FRAICostTracker::Get().Reset(); }));
@@ -0,0 +1,336 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAIDecisionRecorder.h"
+
+#include "RAILogCategory.h"
+#include "Containers/Ticker.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFileManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Tasks/Task.h"
+#include <atomic>
+
+static int32 GRAIRecorderEnabled = 0;
+static FAutoConsoleVariableRef CVarRAIRecorderEnabled(
+	TEXT("rai.Recorder.Enabled"),
+	GRAIRecorderEnabled,
+	TEXT("Record AI decisions into a ring file under Saved/RAITrace. Off unless -RAIRecord is on the command line."));
+
+static int32 GRAIRecorderMaxFiles = 5;
+static FAutoConsoleVariableRef CVarRAIRecorderMaxFiles(
+	TEXT("rai.Recorder.MaxFiles"),
+	GRAIRecorderMaxFiles,
+	TEXT("Number of session ring files kept under Saved/RAITrace, the oldest are deleted when a new session starts recording."));
+
+static int32 GRAIRecorderRingMB = 32;
+static FAutoConsoleVariableRef CVarRAIRecorderRingMB(
+	TEXT("rai.Recorder.RingMB"),
+	GRAIRecorderRingMB,
+	TEXT("Size in megabytes of the decision ring file, read when the file is created. Older events are overwritten once it is full."));
+
+static float GRAIRecorderFlushInterval = 0.5f;
+static FAutoConsoleVariableRef CVarRAIRecorderFlushInterval(
+	TEXT("rai.Recorder.FlushInterval"),
+	GRAIRecorderFlushInterval,
+	TEXT("Seconds between two flushes of the per thread decision buffers to the ring file, read when recording starts."));
+
+static float GRAIRecorderSnapshotKeyframe = 1.f;
+static FAutoConsoleVariableRef CVarRAIRecorderSnapshotKeyframe(
+	TEXT("rai.Recorder.SnapshotKeyframe"),
+	GRAIRecorderSnapshotKeyframe,
+	TEXT("Seconds after which a rescored priority is recorded again even if it did not change. Keep it below the StaleSeconds of the trace analyzer."));
+
+/* Single producer, single consumer buffer. Only its thread writes events, only the flush on the game thread reads them */
+struct FRAIRecorderThreadBuffer
+{
+	static constexpr uint32 Capacity = 8192;
+
+	FRAIDecisionEvent Events[Capacity];
+	std::atomic<uint32> WriteIndex{0};
+	std::atomic<uint32> ReadIndex{0};
+	std::atomic<uint32> Dropped{0};
+};
+
+struct FRAIRecorderState
+{
+	FCriticalSection BuffersLock;
+	TArray<TUniquePtr<FRAIRecorderThreadBuffer>> Buffers;
+	bool IsTickerRegistered = false;
+	FTSTicker::FDelegateHandle TickerHandle;
+
+	// Only touched by Flush on the game thread. Events stay staged while the previous write is still running
+	TArray<FRAIDecisionEvent> Staging;
+	uint64 StagedDropped = 0;
+	UE::Tasks::FTask WriteTask;
+
+	// Only touched by WriteTask, or by the game thread once it completed
+	TUniquePtr<IFileHandle> RingFile;
+	TUniquePtr<IFileHandle> NamesFile;
+	FString RingFilePath;
+	FRAIDecisionFileHeader Header;
+	TSet<uint32> WrittenNameIds;
+	TArray<FRAIDecisionEvent> Writing;
+	uint64 WritingDropped = 0;
+	bool OpenFailed = false;
+};
+
+static FRAIRecorderState& GetRecorderState()
+{
+	static FRAIRecorderState State;
+	return State;
+}
+
+static std::atomic<bool> GRAIRecorderShutDown{false};
+static thread_local FRAIRecorderThreadBuffer* GRAIRecorderThreadBuffer = nullptr;
+
+static bool TickRecorderFlush(float DeltaTime)
+{
+	FRAIDecisionRecorder::Flush();
+	return true;
+}
+
+static FRAIRecorderThreadBuffer* AcquireThreadBuffer()
+{
+	FRAIRecorderState& State = GetRecorderState();
+	FScopeLock Lock(&State.BuffersLock);
+
+	FRAIRecorderThreadBuffer* Buffer = State.Buffers.Add_GetRef(MakeUnique<FRAIRecorderThreadBuffer>()).Get();
+	GRAIRecorderThreadBuffer = Buffer;
+
+	if (!State.IsTickerRegistered)
+	{
+		State.IsTickerRegistered = true;
+		State.TickerHandle = FTSTicker::GetCoreTicker().AddTicker(
+			FTickerDelegate::CreateStatic(&TickRecorderFlush), FMath::Max(GRAIRecorderFlushInterval, 0.01f));
+	}
+
+	return Buffer;
+}
+
+void FRAIDecisionRecorder::Record(ERAIDecisionEventType Type, const UObject* Agent, FName Task, FName Other, float Value)
+{
+	if (!GRAIRecorderEnabled || GRAIRecorderShutDown.load(std::memory_order_relaxed))
+	{
+		return;
+	}
+
+	FRAIRecorderThreadBuffer* Buffer = GRAIRecorderThreadBuffer;
+	if (!Buffer)
+	{
+		Buffer = AcquireThreadBuffer();
+	}
+
+	const uint32 Write = Buffer->WriteIndex.load(std::memory_order_relaxed);
+	if (Write - Buffer->ReadIndex.load(std::memory_order_acquire) >= FRAIRecorderThreadBuffer::Capacity)
+	{
+		Buffer->Dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	const UWorld* World = Agent ? Agent->GetWorld() : nullptr;
+
+	FRAIDecisionEvent& Event = Buffer->Events[Write % FRAIRecorderThreadBuffer::Capacity];
+	Event.WorldTime = World ? World->GetTimeSeconds() : 0.0;
+	Event.Frame = static_cast<uint32>(GFrameCounter);
+	Event.AgentId = Agent ? Agent->GetUniqueID() : 0;
+	Event.TaskNameId = Task.GetDisplayIndex().ToUnstableInt();
+	Event.OtherNameId = Other.GetDisplayIndex().ToUnstableInt();
+	Event.Value = Value;
+	Event.Type = Type;
+
+	Buffer->WriteIndex.store(Write + 1, std::memory_order_release);
+}
+
+static bool EnsureRingFileOpen(FRAIRecorderState& State)
+{
+	if (State.RingFile)
+	{
+		return true;
+	}
+
+	if (State.OpenFailed)
+	{
+		return false;
+	}
+
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("RAITrace");
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	PlatformFile.CreateDirectoryTree(*Directory);
+
+	// Every session preallocates a full ring, keep room for this one within MaxFiles. The names start with the date, oldest first
+	TArray<FString> OldFiles;
+	IFileManager::Get().FindFiles(OldFiles, *(Directory / TEXT("RAIDecisions_*.rai")), true, false);
+	OldFiles.Sort();
+	const int32 FilesToDelete = OldFiles.Num() - (FMath::Max(GRAIRecorderMaxFiles, 1) - 1);
+	for (int32 FileIndex = 0; FileIndex < FilesToDelete; ++FileIndex)
+	{
+		const FString OldPath = Directory / OldFiles[FileIndex];
+		PlatformFile.DeleteFile(*OldPath);
+		PlatformFile.DeleteFile(*FRAIDecisionRecorder::GetNamesFilePath(OldPath));
+	}
+
+	const FDateTime Now = FDateTime::Now();
+	State.RingFilePath = Directory / FString::Printf(TEXT("RAIDecisions_%s_%u.rai"), *Now.ToString(TEXT("%Y%m%d_%H%M%S")),
+	                                                 FPlatformProcess::GetCurrentProcessId());
+
+	State.RingFile.Reset(PlatformFile.OpenWrite(*State.RingFilePath, false, true));
+	State.NamesFile.Reset(PlatformFile.OpenWrite(*FRAIDecisionRecorder::GetNamesFilePath(State.RingFilePath), false, true));
+	if (!State.RingFile || !State.NamesFile)
+	{
+		UE_LOG(LogRAI, Warning, TEXT("Could not create the decision recorder file %s, recording is disabled"), *State.RingFilePath);
+		State.RingFile.Reset();
+		State.NamesFile.Reset();
+		State.OpenFailed = true;
+		return false;
+	}
+
+	State.Header = FRAIDecisionFileHeader();
+	State.Header.Capacity = FMath::Max<int64>(1, static_cast<int64>(FMath::Max(GRAIRecorderRingMB, 1)) * 1024 * 1024 / sizeof(FRAIDecisionEvent));
+	State.Header.SessionStartTicks = Now.GetTicks();
+
+	// Preallocate the ring so the file never grows while recording
+	const int64 FileSize = sizeof(FRAIDecisionFileHeader) + static_cast<int64>(State.Header.Capacity) * sizeof(FRAIDecisionEvent);
+	State.RingFile->Truncate(FileSize);
+	State.RingFile->Seek(0);
+	State.RingFile->Write(reinterpret_cast<const uint8*>(&State.Header), sizeof(FRAIDecisionFileHeader));
+
+	UE_LOG(LogRAI, Display, TEXT("Recording AI decisions to %s"), *State.RingFilePath);
+	return true;
+}
+
+static void WriteNewNames(FRAIRecorderState& State)
+{
+	TAnsiStringBuilder<1024> Lines;
+
+	auto AddName = [&State, &Lines](uint32 NameId)
+	{
+		bool AlreadyWritten = false;
+		State.WrittenNameIds.Add(NameId, &AlreadyWritten);
+		if (!AlreadyWritten)
+		{
+			const FName Name = FName::CreateFromDisplayId(FNameEntryId::FromUnstableInt(NameId), 0);
+			Lines << NameId << '\t' << TCHAR_TO_UTF8(*Name.ToString()) << '\n';
+		}
+	};
+
+	for (const FRAIDecisionEvent& Event : State.Writing)
+	{
+		AddName(Event.TaskNameId);
+		AddName(Event.OtherNameId);
+	}
+
+	if (Lines.Len() > 0)
+	{
+		State.NamesFile->Write(reinterpret_cast<const uint8*>(Lines.GetData()), Lines.Len());
+		State.NamesFile->Flush();
+	}
+}
+
+/* Writes the events handed over by Flush, on a background task */
+static void WriteEvents(FRAIRecorderState& State)
+{
+	if (!EnsureRingFileOpen(State))
+	{
+		State.Writing.Reset();
+		return;
+	}
+
+	WriteNewNames(State);
+
+	// Copy into the ring, wrapping around at the end of the file
+	const uint64 Capacity = State.Header.Capacity;
+	int32 Written = 0;
+	while (Written < State.Writing.Num())
+	{
+		const uint64 Slot = (State.Header.TotalEvents + Written) % Capacity;
+		const int32 Count = static_cast<int32>(FMath::Min<uint64>(State.Writing.Num() - Written, Capacity - Slot));
+
+		State.RingFile->Seek(sizeof(FRAIDecisionFileHeader) + Slot * sizeof(FRAIDecisionEvent));
+		State.RingFile->Write(reinterpret_cast<const uint8*>(State.Writing.GetData() + Written), Count * sizeof(FRAIDecisionEvent));
+		Written += Count;
+	}
+
+	State.Header.TotalEvents += State.Writing.Num();
+	State.Header.DroppedEvents += State.WritingDropped;
+	State.RingFile->Seek(0);
+	State.RingFile->Write(reinterpret_cast<const uint8*>(&State.Header), sizeof(FRAIDecisionFileHeader));
+
+	// The trace matters most when the process crashes, so it goes to disk on every write rather than at shutdown
+	State.RingFile->Flush();
+	State.Writing.Reset();
+}
+
+void FRAIDecisionRecorder::Flush()
+{
+	FRAIRecorderState& State = GetRecorderState();
+	{
+		FScopeLock Lock(&State.BuffersLock);
+		for (const TUniquePtr<FRAIRecorderThreadBuffer>& Buffer : State.Buffers)
+		{
+			const uint32 Read = Buffer->ReadIndex.load(std::memory_order_relaxed);
+			const uint32 Write = Buffer->WriteIndex.load(std::memory_order_acquire);
+			for (uint32 Index = Read; Index != Write; ++Index)
+			{
+				State.Staging.Add(Buffer->Events[Index % FRAIRecorderThreadBuffer::Capacity]);
+			}
+
+			Buffer->ReadIndex.store(Write, std::memory_order_release);
+			State.StagedDropped += Buffer->Dropped.exchange(0, std::memory_order_relaxed);
+		}
+	}
+
+	if ((State.Staging.Num() == 0 && State.StagedDropped == 0) || (State.WriteTask.IsValid() && !State.WriteTask.IsCompleted()))
+	{
+		return;
+	}
+
+	Swap(State.Staging, State.Writing);
+	State.WritingDropped = State.StagedDropped;
+	State.StagedDropped = 0;
+
+	// Seeking and flushing the file would stall the game thread
+	State.WriteTask = UE::Tasks::Launch(UE_SOURCE_LOCATION, [&State]() { WriteEvents(State); }, UE::Tasks::ETaskPriority::BackgroundNormal);
+}
+
+void FRAIDecisionRecorder::Startup()
+{
+	if (FParse::Param(FCommandLine::Get(), TEXT("RAIRecord")))
+	{
+		CVarRAIRecorderEnabled->Set(1, ECVF_SetByCommandline);
+	}
+}
+
+void FRAIDecisionRecorder::Shutdown()
+{
+	GRAIRecorderShutDown.store(true);
+
+	FRAIRecorderState& State = GetRecorderState();
+	if (State.IsTickerRegistered)
+	{
+		FTSTicker::GetCoreTicker().RemoveTicker(State.TickerHandle);
+		State.IsTickerRegistered = false;
+	}
+
+	// The write in flight may have left events staged, write those too before closing
+	State.WriteTask.Wait();
+	Flush();
+	State.WriteTask.Wait();
+
+	State.RingFile.Reset();
+	State.NamesFile.Reset();
+}
+
+float FRAIDecisionRecorder::GetSnapshotKeyframeInterval()
+{
+	return GRAIRecorderSnapshotKeyframe;
+}
+
+FString FRAIDecisionRecorder::GetCurrentFilePath()
+{
+	FRAIRecorderState& State = GetRecorderState();
+	State.WriteTask.Wait();
+	return State.RingFilePath;
+}
@@ -3,11 +3,21 @@
 #include "RAIManagerComponent.h"
 
 #include "RAITaskComponent.h"
+#include "RAIConsiderationSet.h"
+#include "RAIConsiderationKernels.h"
+#include "RAIPriorityBatch.h"
+#include "RAIDecisionRecorder.h"
+#include "SubSystems/RAIKnowledgeComponent.h"
 #include "GameFramework/Pawn.h"
 #include "RAIController.h"
 #include "RAILogCategory.h"
+#include "RAIStats.h"
+#include "RAICostTracker.h"
 #include "GameFramework/Character.h"
 #include "RancUtilityLibrary.h"
+#include "SubSystems/RAISchedulerSubsystem.h"
+#include "Engine/World.h"
+#include "Perception/AISense.h"
 
 URAIManagerComponent::URAIManagerComponent()
 {
@@ -20,6 +30,21 @@ void URAIManagerComponent::BeginPlay()
 	Super::BeginPlay();
 }
 
+void URAIManagerComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (KnowledgeComponent)
+	{
+		KnowledgeComponent->OnKnowledgeChanged.RemoveAll(this);
+	}
+
+	if (URAISchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<URAISchedulerSubsystem>())
+	{
+		Scheduler->UnregisterManager(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
 void URAIManagerComponent::Initialize(ARAIController* Controller, APawn* Pawn)
 {
 	if (OwningController == nullptr || Character == nullptr)
@@ -41,6 +66,17 @@ void URAIManagerComponent::Initialize(ARAIController* Controller, APawn* Pawn)
 			}
 
 			OwningController->GetComponents<URAITaskComponent>(AllTasks, false);
+
+			KnowledgeComponent = OwningController->FindComponentByClass<URAIKnowledgeComponent>();
+			if (!KnowledgeComponent && Character)
+			{
+				KnowledgeComponent = Character->FindComponentByClass<URAIKnowledgeComponent>();
+			}
+
+			if (KnowledgeComponent)
+			{
+				KnowledgeComponent->OnKnowledgeChanged.AddUObject(this, &URAIManagerComponent::OnKnowledgeChanged);
+			}
 		}
 
 		if (DebugLoggingEnabled)
@@ -48,15 +84,42 @@ void URAIManagerComponent::Initialize(ARAIController* Controller, APawn* Pawn)
 			UE_LOG(LogRAI, Display, TEXT("RAIManagerComponent initialized with %d tasks"), AllTasks.Num())
 		}
 
+		BuildTaskRegistry();
+
 		for (URAITaskComponent* TaskComponent : AllTasks)
 		{
 			TaskComponent->ManagerComponent = this;
 			TaskComponent->DebugLoggingEnabled = DebugLoggingEnabled;
 			TaskComponent->MaxTaskLoopCount = MaxTaskLoopCount;
+			TaskComponent->CostClassSlot = FRAICostTracker::Get().RegisterClass(TaskComponent->GetClass());
 
+			TaskComponent->PrimaryTaskIndex = INDEX_NONE;
 			if (TaskComponent->IsPrimaryTask)
 			{
-				PrimaryTasks.Add(TaskComponent);
+				TaskComponent->PrimaryTaskIndex = PrimaryTasks.Add(TaskComponent);
+				PrimaryTaskStateIndices.Add(TaskComponent->TaskHandle.Index);
+
+				// Compile native considerations once here so scoring never calls into blueprint
+				const bool UseConsiderations = TaskComponent->Considerations && !TaskComponent->UseBlueprintCalculatePriority;
+				PrimaryTaskPrograms.Add(UseConsiderations ? TaskComponent->Considerations->GetProgram() : nullptr);
+
+				ERAIPriorityDependency Dependencies = ERAIPriorityDependency::Always;
+				if (TaskComponent->TrackPriorityDependencies)
+				{
+					Dependencies = static_cast<ERAIPriorityDependency>(TaskComponent->PriorityDependencies);
+					if (UseConsiderations)
+					{
+						Dependencies |= PrimaryTaskPrograms.Last()->Dependencies;
+					}
+					if (!TaskComponent->PriorityDependencyTags.IsEmpty())
+					{
+						Dependencies |= ERAIPriorityDependency::CustomTags;
+					}
+				}
+				PrimaryTaskDependencies.Add(Dependencies);
+				PrimaryTaskScoreTimes.Add(-1.0f);
+				PrimaryTaskSnapshotTimes.Add(-1.0f);
+				DirtyPrimaryTasks.Add(true);
 			}
 
 			TaskComponent->OwnerController = OwningController;
@@ -66,32 +129,136 @@ void URAIManagerComponent::Initialize(ARAIController* Controller, APawn* Pawn)
 		{
 			TaskComponent->Initialize(Character, OwningController);
 		}
+
+		// After Initialize, which may still change ReceivesPerception or PerceptionSenses
+		RefreshPerceptionSubscriptions();
+
+		if (URAISchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<URAISchedulerSubsystem>())
+		{
+			Scheduler->RegisterManager(this);
+		}
 	}
 }
 
-URAITaskComponent* URAIManagerComponent::GetTaskByClass(TSubclassOf<URAITaskComponent> TaskClass) const
+void URAIManagerComponent::BuildTaskRegistry()
 {
-	for (URAITaskComponent* TaskComponent : AllTasks)
+	TaskIndexByClass.Reset();
+	TaskIndexByTag.Reset();
+	ReportedMissingTaskClasses.Reset();
+	TaskState.Reset();
+
+	for (int32 TaskIndex = 0; TaskIndex < AllTasks.Num(); ++TaskIndex)
 	{
-		if (TaskComponent && TaskComponent->IsA(TaskClass))
+		URAITaskComponent* TaskComponent = AllTasks[TaskIndex];
+		TaskState.Add();
+		if (!TaskComponent)
+		{
+			TaskState.IsEnabled[TaskIndex] = false;
+			continue;
+		}
+
+		TaskComponent->TaskHandle.Index = TaskIndex;
+
+		// Seed the state arrays from the configured values, from here on the accessors only use the arrays
+		TaskComponent->CopyStateTo(TaskState);
+
+		// Register the whole hierarchy so lookups by a parent class behave like the IsA scan did, first task wins
+		for (const UClass* Class = TaskComponent->GetClass(); Class; Class = Class->GetSuperClass())
+		{
+			TaskIndexByClass.FindOrAdd(Class, TaskIndex);
+			if (Class == URAITaskComponent::StaticClass())
+			{
+				break;
+			}
+		}
+
+		if (TaskComponent->TaskTag.IsValid())
 		{
-			return TaskComponent;
+			if (const int32* ExistingIndex = TaskIndexByTag.Find(TaskComponent->TaskTag))
+			{
+				UE_LOG(LogRAI, Warning, TEXT("Tasks %s and %s share the TaskTag %s, lookups by tag will return %s"),
+				       *AllTasks[*ExistingIndex]->GetName(), *TaskComponent->GetName(), *TaskComponent->TaskTag.ToString(),
+				       *AllTasks[*ExistingIndex]->GetName());
+			}
+			else
+			{
+				TaskIndexByTag.Add(TaskComponent->TaskTag, TaskIndex);
+			}
 		}
 	}
-	
-	UE_LOG(LogRAI, Error, TEXT("Could not find task of class: %s, did you add the task to your AI?"),
-	       *(TaskClass->GetFName().ToString() ))
+}
+
+void URAIManagerComponent::ReportMissingTask(const UClass* TaskClass) const
+{
+	bool AlreadyReported = false;
+	ReportedMissingTaskClasses.Add(TaskClass, &AlreadyReported);
+	if (!AlreadyReported)
+	{
+		UE_LOG(LogRAI, Warning, TEXT("Could not find task of class: %s, did you add the task to your AI?"),
+		       TaskClass ? *TaskClass->GetName() : TEXT("None"))
+	}
+}
+
+URAITaskComponent* URAIManagerComponent::GetTaskByClass(TSubclassOf<URAITaskComponent> TaskClass) const
+{
+	return GetTaskByHandle(FindTaskHandle(TaskClass));
+}
+
+FRAITaskHandle URAIManagerComponent::FindTaskHandle(TSubclassOf<URAITaskComponent> TaskClass) const
+{
+	FRAITaskHandle Handle;
+	if (const int32* TaskIndex = TaskIndexByClass.Find(TaskClass.Get()))
+	{
+		Handle.Index = *TaskIndex;
+	}
+	else
+	{
+		ReportMissingTask(TaskClass.Get());
+	}
+
+	return Handle;
+}
+
+FRAITaskHandle URAIManagerComponent::FindTaskHandleByTag(FGameplayTag TaskTag) const
+{
+	FRAITaskHandle Handle;
+	if (const int32* TaskIndex = TaskIndexByTag.Find(TaskTag))
+	{
+		Handle.Index = *TaskIndex;
+	}
 
-	return nullptr;
+	return Handle;
+}
+
+URAITaskComponent* URAIManagerComponent::GetTaskByHandle(FRAITaskHandle TaskHandle) const
+{
+	return AllTasks.IsValidIndex(TaskHandle.Index) ? AllTasks[TaskHandle.Index] : nullptr;
 }
 
 void URAIManagerComponent::UpdateActiveTasks()
 {
-	if (OwningController == nullptr)
+	SCOPE_CYCLE_COUNTER(STAT_RAI_UpdateActiveTasks);
+	RAI_COUNT(AgentsUpdated, 1);
+
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+	AdvanceDistantSimulation(WorldTime);
+	FlushPerceptionQueue(WorldTime);
+
+	if (HandlePendingReinvoke())
 	{
 		return;
 	}
 
+	ApplyBestTask(UpdateTaskPriorities());
+}
+
+bool URAIManagerComponent::HandlePendingReinvoke()
+{
+	if (OwningController == nullptr)
+	{
+		return true;
+	}
+
 	if (ActiveTask && ReinvokeActiveTask)
 	{
 		// this is a fallback case where the task returned without finishing or initiating a wait, we will keep
@@ -104,12 +271,16 @@ void URAIManagerComponent::UpdateActiveTasks()
 		}
 
 		ReinvokeActiveTask = false;
+		RAI_RECORD_DECISION(ERAIDecisionEventType::ReinvokeFallback, OwningController, ActiveTask->GetClass()->GetFName(), NAME_None, 0.f);
 		StartTask(ActiveTask);
-		return;
+		return true;
 	}
 
-	URAITaskComponent* BestTask = UpdateTaskPriorities();
+	return false;
+}
 
+void URAIManagerComponent::ApplyBestTask(URAITaskComponent* BestTask, TOptional<bool> PrecomputedShouldInterrupt)
+{
 	if (!BestTask || (ActiveTask && ActiveTask->IsDescendantOf(BestTask)))
 	{
 		return;
@@ -118,7 +289,7 @@ void URAIManagerComponent::UpdateActiveTasks()
 	// If we are continuing the same task
 	if (ActiveTask && (ActiveTask == BestTask))
 	{
-		if (!ActiveTask->IsTaskActive && ActiveTask->IsTaskReady()) // wake up if not active, should never happen
+		if (!ActiveTask->GetIsTaskActive() && ActiveTask->IsTaskReady()) // wake up if not active, should never happen
 		{
 			if (DebugLoggingEnabled)
 			{
@@ -132,7 +303,7 @@ void URAIManagerComponent::UpdateActiveTasks()
 		return;
 	}
 
-	if (!ActiveTask || !ActiveTask->IsTaskActive)
+	if (!ActiveTask || !ActiveTask->GetIsTaskActive())
 	{
 		if (DebugLoggingEnabled)
 		{
@@ -142,23 +313,34 @@ void URAIManagerComponent::UpdateActiveTasks()
 
 		StartTask(BestTask);
 	}
-	else if (BestTask && CheckIfTaskShouldInterrupt(ActiveTask, BestTask))
+	else if (BestTask && (PrecomputedShouldInterrupt.IsSet()
+		                      ? PrecomputedShouldInterrupt.GetValue()
+		                      : CheckIfTaskShouldInterrupt(ActiveTask, BestTask)))
 	{
 		if (DebugLoggingEnabled)
 		{
+			// Logged here rather than in CheckIfTaskShouldInterrupt so batched decisions are reported too
+			URancUtilityLibrary::ThrottledLog(
+				FString("Task ") + BestTask->GetFName().ToString() + FString(" should interrupt ") + ActiveTask
+				->GetFName().ToString() + FString(" = ") + FString("true"), 3.f,
+				FString("ShouldInterrupt"));
 			UE_LOG(LogRAI, Display, TEXT("Task %s is interrupting task %s."),
 			       *(BestTask->GetFName().ToString() ), *(ActiveTask->GetFName().ToString() ))
 		}
 
+		RAI_COUNT(Interrupts, 1);
+		RAI_RECORD_DECISION(ERAIDecisionEventType::TaskInterrupt, OwningController, BestTask->GetClass()->GetFName(),
+		                    ActiveTask->GetClass()->GetFName(), BestTask->GetPriority() - ActiveTask->GetPriority());
+
 		// We are interrupting one task for another
 		if (auto* Ancestor = ActiveTask->GetOldestInvokingAncestor())
 		{
 			// ancestor will trigger EndTask in all its children
-			Ancestor->EndTask(false, 0, true);
+			Ancestor->EndTaskCore(false, 0, true);
 		}
 		else
 		{
-			ActiveTask->EndTask(false, 0, true);
+			ActiveTask->EndTaskCore(false, 0, true);
 		}
 
 		OwningController->StopMovement();
@@ -171,6 +353,22 @@ void URAIManagerComponent::UpdateActiveTasks()
 void URAIManagerComponent::StartTask(URAITaskComponent* Task, FRAITaskInvokeArguments InvokeArguments)
 {
 	ActiveTask = Task;
+#if RAI_DECISION_RECORDER_ENABLED
+	// Tells the trace analyzer that a start without a recent snapshot was decided on a deliberately kept priority
+	if (Task->PrimaryTaskIndex != INDEX_NONE)
+	{
+		const float ScoreTime = PrimaryTaskScoreTimes[Task->PrimaryTaskIndex];
+		const float WorldTime = GetWorld()->GetTimeSeconds();
+		if (ScoreTime >= 0.f && ScoreTime < WorldTime)
+		{
+			RAI_RECORD_DECISION(ERAIDecisionEventType::PriorityCacheHit, OwningController, Task->GetClass()->GetFName(), NAME_None,
+			                    WorldTime - ScoreTime);
+		}
+	}
+#endif
+	// TaskIsActive considerations read this
+	InvalidateTaskPriority(Task);
+	RAI_RECORD_DECISION(ERAIDecisionEventType::TaskEnter, OwningController, Task->GetClass()->GetFName(), NAME_None, Task->GetPriority());
 	Task->BeginTaskCore(InvokeArguments);
 
 	if (DebugLoggingEnabled)
@@ -178,7 +376,7 @@ void URAIManagerComponent::StartTask(URAITaskComponent* Task, FRAITaskInvokeArgu
 		UE_LOG(LogRAI, Display, TEXT("Starting task %s."), *(Task->GetFName().ToString() ))
 	}
 
-	if (Task->IsTaskActive && !Task->IsWaiting && Task->Cooldown <= 0.f)
+	if (Task->GetIsTaskActive() && !Task->GetIsWaiting() && Task->GetCooldown() <= 0.f)
 	{
 		// The task returned without finishing or initiating a wait
 		if (!AnnouncedBadTaskReturnWarning)
@@ -205,52 +403,415 @@ void URAIManagerComponent::ForceInterruptActiveTask(URAITaskComponent* AssumedAc
 		}
 
 		// Interrupt the active task
-		AssumedActiveTask->EndTask(false);
+		AssumedActiveTask->EndTaskCore(false);
 		OnAnyTaskExit.Broadcast(ActiveTask);
 
 		ActiveTask = nullptr;
 	}
 }
 
-void URAIManagerComponent::OnPerceptionStimulus(AActor* Actor, FAIStimulus Stimulus)
+void URAIManagerComponent::RequestUrgentUpdate()
+{
+	if (URAISchedulerSubsystem* Scheduler = GetWorld()->GetSubsystem<URAISchedulerSubsystem>())
+	{
+		Scheduler->RequestUrgentUpdate(this);
+	}
+}
+
+void URAIManagerComponent::InvalidatePriorityInputs(int32 Dependencies)
 {
+	const ERAIPriorityDependency Invalidated = static_cast<ERAIPriorityDependency>(Dependencies);
+
+	for (int32 TaskIndex = 0; TaskIndex < PrimaryTaskDependencies.Num(); ++TaskIndex)
+	{
+		if (EnumHasAnyFlags(PrimaryTaskDependencies[TaskIndex], Invalidated))
+		{
+			DirtyPrimaryTasks[TaskIndex] = true;
+		}
+	}
+}
+
+void URAIManagerComponent::InvalidatePriorityTag(FGameplayTag Tag)
+{
+	for (int32 TaskIndex = 0; TaskIndex < PrimaryTasks.Num(); ++TaskIndex)
+	{
+		const URAITaskComponent* Task = PrimaryTasks[TaskIndex];
+		if (Task && Task->PriorityDependencyTags.HasTag(Tag))
+		{
+			DirtyPrimaryTasks[TaskIndex] = true;
+		}
+	}
+}
+
+void URAIManagerComponent::InvalidateTaskPriority(URAITaskComponent* Task)
+{
+	// Blueprint may pass a task of another AI
+	if (Task && Task->ManagerComponent == this && Task->PrimaryTaskIndex != INDEX_NONE)
+	{
+		DirtyPrimaryTasks[Task->PrimaryTaskIndex] = true;
+	}
+}
+
+void URAIManagerComponent::OnKnowledgeChanged()
+{
+	InvalidatePriorityInputs(static_cast<int32>(ERAIPriorityDependency::Knowledge));
+}
+
+void URAIManagerComponent::SetSimulationField(ERAIField NewField, const FRAIFieldSettings& NewFieldSettings)
+{
+	FieldSettings = NewFieldSettings;
+
+	if (NewField == SimulationField)
+	{
+		return;
+	}
+
+	if (DebugLoggingEnabled)
+	{
+		UE_LOG(LogRAI, Display, TEXT("AI %s moved to the %s"), *GetNameSafe(OwningController),
+		       NewField == ERAIField::NearField ? TEXT("near field") : TEXT("distant field"))
+	}
+
+	SimulationField = NewField;
+	DistantSimulatedUntil = -1.0f;
+
+	// Priorities cached while distant may be stale, possibly by a lot
+	DirtyPrimaryTasks.Init(true, DirtyPrimaryTasks.Num());
+
+	// Running tasks include the invoking ancestors of ActiveTask. Reconciling or demoting one may end others, so work on a copy
+	TArray<URAITaskComponent*, TInlineAllocator<8>> RunningTasks;
+	for (TConstSetBitIterator<> It(TaskState.IsTaskActive); It; ++It)
+	{
+		if (URAITaskComponent* TaskComponent = AllTasks[It.GetIndex()])
+		{
+			RunningTasks.Add(TaskComponent);
+		}
+	}
+
+	if (FieldSettings.SimulationStep <= 0.f)
+	{
+		// Bring coarsely simulated tasks back to the full lifecycle before anyone gets close enough to see them
+		for (URAITaskComponent* TaskComponent : RunningTasks)
+		{
+			if (TaskComponent->IsSimulatingDistant)
+			{
+				TaskComponent->ReconcileWithNearField();
+			}
+		}
+	}
+	else
+	{
+		// Tasks begun in the near field switch to their coarse mode. A demoted innermost task stops its own move, tasks that
+		// stay on the full lifecycle keep moving
+		for (URAITaskComponent* TaskComponent : RunningTasks)
+		{
+			if (TaskComponent->SupportsDistantSimulation && !TaskComponent->IsSimulatingDistant && TaskComponent->GetIsTaskActive())
+			{
+				TaskComponent->DemoteToDistantField();
+			}
+		}
+	}
+
 	for (URAITaskComponent* TaskComponent : AllTasks)
 	{
-		if (TaskComponent && TaskComponent->IsEnabled)
+		if (TaskComponent)
+		{
+			TaskComponent->OnSimulationFieldChanged(NewField);
+		}
+	}
+}
+
+void URAIManagerComponent::AdvanceDistantSimulation(float WorldTime)
+{
+	const float Step = FieldSettings.SimulationStep;
+	if (Step <= 0.f)
+	{
+		return;
+	}
+
+	if (DistantSimulatedUntil < 0.f)
+	{
+		DistantSimulatedUntil = WorldTime;
+		return;
+	}
+
+	// Never run more than a few steps at once, an agent starved by the scheduler should not stall the frame. The last step
+	// takes the whole backlog instead, so cooldowns and timers of the simulated tasks keep up with world time
+	constexpr int32 MaxStepsPerUpdate = 4;
+
+	for (int32 StepCount = 0; StepCount < MaxStepsPerUpdate && WorldTime - DistantSimulatedUntil >= Step; ++StepCount)
+	{
+		const float StepSeconds = StepCount < MaxStepsPerUpdate - 1
+			                          ? Step
+			                          : FMath::FloorToFloat((WorldTime - DistantSimulatedUntil) / Step) * Step;
+		DistantSimulatedUntil += StepSeconds;
+
+		// Only the innermost task of an invoke chain is stepped, its ancestors wait for it to return
+		TArray<URAITaskComponent*, TInlineAllocator<8>> SteppedTasks;
+		for (TConstSetBitIterator<> It(TaskState.IsTaskActive); It; ++It)
+		{
+			URAITaskComponent* TaskComponent = AllTasks[It.GetIndex()];
+			if (TaskComponent && TaskComponent->IsSimulatingDistant && !TaskComponent->ChildInvokedTask)
+			{
+				SteppedTasks.Add(TaskComponent);
+			}
+		}
+
+		for (URAITaskComponent* TaskComponent : SteppedTasks)
+		{
+			if (TaskComponent->GetIsTaskActive() && TaskComponent->IsSimulatingDistant)
+			{
+				TaskComponent->SimulateDistantStepCore(StepSeconds);
+			}
+		}
+	}
+}
+
+void URAIManagerComponent::OnPerceptionStimulus(AActor* Actor, FAIStimulus Stimulus)
+{
+	if (!FieldSettings.ForwardPerception)
+	{
+		// Hold it until the field forwards perception again, dropping a lost sense stimulus would leave the tasks on a stale target
+		CoalesceStimulus(Actor, Stimulus);
+		return;
+	}
+
+	InvalidatePriorityInputs(static_cast<int32>(ERAIPriorityDependency::Perception));
+	DispatchStimulus(Actor, Stimulus);
+}
+
+void URAIManagerComponent::QueuePerceptionStimulus(AActor* Actor, const FAIStimulus& Stimulus)
+{
+	if (!CoalescePerceptionStimuli)
+	{
+		OnPerceptionStimulus(Actor, Stimulus);
+		return;
+	}
+
+	CoalesceStimulus(Actor, Stimulus);
+}
+
+void URAIManagerComponent::CoalesceStimulus(AActor* Actor, const FAIStimulus& Stimulus)
+{
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+
+	for (FQueuedStimulus& Queued : QueuedStimuli)
+	{
+		if (Queued.Actor.Get() == Actor && Queued.Stimulus.Type == Stimulus.Type)
+		{
+			// A change between sensed and lost always wins, otherwise keep the strongest, the newest on ties
+			const bool SensedChanged = Queued.Stimulus.WasSuccessfullySensed() != Stimulus.WasSuccessfullySensed();
+			if (SensedChanged || Stimulus.Strength >= Queued.Stimulus.Strength)
+			{
+				Queued.Stimulus = Stimulus;
+				Queued.QueuedTime = WorldTime;
+			}
+
+			RAI_COUNT(StimuliCoalesced, 1);
+			return;
+		}
+	}
+
+	if (QueuedStimuli.Num() >= MaxQueuedStimuli)
+	{
+		// Lost sense stimuli are the last to go, the tasks would never hear about the loss otherwise
+		int32 DropIndex = QueuedStimuli.IndexOfByPredicate([](const FQueuedStimulus& Queued) { return Queued.Stimulus.WasSuccessfullySensed(); });
+		QueuedStimuli.RemoveAt(DropIndex == INDEX_NONE ? 0 : DropIndex, 1, EAllowShrinking::No);
+	}
+
+	QueuedStimuli.Add({Actor, Stimulus, WorldTime});
+}
+
+void URAIManagerComponent::FlushPerceptionQueue(float WorldTime)
+{
+	if (QueuedStimuli.Num() == 0 || !FieldSettings.ForwardPerception)
+	{
+		return;
+	}
+
+	// Dispatching may queue new stimuli, those wait for the next update
+	TArray<FQueuedStimulus, TInlineAllocator<16>> Delivering(MoveTemp(QueuedStimuli));
+	QueuedStimuli.Reset();
+
+	InvalidatePriorityInputs(static_cast<int32>(ERAIPriorityDependency::Perception));
+
+	for (FQueuedStimulus& Queued : Delivering)
+	{
+		const float Waited = WorldTime - Queued.QueuedTime;
+		AActor* Actor = Queued.Actor.Get();
+
+		// The sensed actor was destroyed while queued
+		if (!Actor && !Queued.Actor.IsExplicitlyNull())
+		{
+			continue;
+		}
+
+		// Age it by the time spent in the queue, the stimulus drops out once past its own expiration age.
+		// A lost sense is always delivered however long it waited, it is what clears the target
+		const bool Expired = Waited > MaxQueuedStimulusAge || (Waited > 0.f && !Queued.Stimulus.AgeStimulus(Waited));
+		if (Expired && Queued.Stimulus.WasSuccessfullySensed())
+		{
+			continue;
+		}
+
+		RAI_COUNT(StimuliDelivered, 1);
+		DispatchStimulus(Actor, Queued.Stimulus);
+	}
+}
+
+void URAIManagerComponent::DispatchStimulus(AActor* Actor, const FAIStimulus& Stimulus)
+{
+	// Only resolved if a subscriber filters by attitude
+	TOptional<ETeamAttitude::Type> Attitude;
+
+	// A handler may refresh the subscriptions or grow them with a new sense, either of which reallocates the list
+	const TArray<int32, TInlineAllocator<16>> Subscribers(GetPerceptionSubscribers(Stimulus.Type));
+
+	for (const int32 TaskIndex : Subscribers)
+	{
+		URAITaskComponent* TaskComponent = AllTasks[TaskIndex];
+		if (TaskComponent && TaskState.IsEnabled[TaskIndex] && AcceptsStimulusSource(TaskComponent, Actor, Attitude))
 		{
 			TaskComponent->OnPerceptionStimulus(Actor, Stimulus);
 		}
 	}
 }
 
+void URAIManagerComponent::RefreshPerceptionSubscriptions()
+{
+	PerceptionSubscribersBySense.Reset();
+	PerceptionSubscribersBuilt.Reset();
+	PerceptionSubscribersAnySense.Reset();
+
+	for (int32 TaskIndex = 0; TaskIndex < AllTasks.Num(); ++TaskIndex)
+	{
+		const URAITaskComponent* TaskComponent = AllTasks[TaskIndex];
+		if (TaskComponent && TaskComponent->ReceivesPerception && TaskComponent->PerceptionSenses.IsEmpty())
+		{
+			PerceptionSubscribersAnySense.Add(TaskIndex);
+		}
+	}
+}
+
+const TArray<int32>& URAIManagerComponent::GetPerceptionSubscribers(FAISenseID Sense)
+{
+	if (!Sense.IsValid())
+	{
+		return PerceptionSubscribersAnySense;
+	}
+
+	const int32 SenseIndex = Sense.Index;
+	if (SenseIndex >= PerceptionSubscribersBySense.Num())
+	{
+		PerceptionSubscribersBySense.SetNum(SenseIndex + 1);
+		PerceptionSubscribersBuilt.SetNum(SenseIndex + 1, false);
+	}
+
+	TArray<int32>& Subscribers = PerceptionSubscribersBySense[SenseIndex];
+	if (!PerceptionSubscribersBuilt[SenseIndex])
+	{
+		PerceptionSubscribersBuilt[SenseIndex] = true;
+
+		// Kept in AllTasks order so tasks are notified in the same order as before subscriptions existed
+		for (int32 TaskIndex = 0; TaskIndex < AllTasks.Num(); ++TaskIndex)
+		{
+			const URAITaskComponent* TaskComponent = AllTasks[TaskIndex];
+			if (!TaskComponent || !TaskComponent->ReceivesPerception)
+			{
+				continue;
+			}
+
+			bool Subscribed = TaskComponent->PerceptionSenses.IsEmpty();
+			for (const TSubclassOf<UAISense>& SenseClass : TaskComponent->PerceptionSenses)
+			{
+				if (SenseClass && UAISense::GetSenseID(SenseClass) == Sense)
+				{
+					Subscribed = true;
+					break;
+				}
+			}
+
+			if (Subscribed)
+			{
+				Subscribers.Add(TaskIndex);
+			}
+		}
+	}
+
+	return Subscribers;
+}
+
+bool URAIManagerComponent::AcceptsStimulusSource(const URAITaskComponent* Task, const AActor* Actor,
+                                                 TOptional<ETeamAttitude::Type>& Attitude) const
+{
+	if (!Task->PerceptionActorTags.IsEmpty())
+	{
+		if (!Actor || !Task->PerceptionActorTags.ContainsByPredicate([Actor](FName Tag) { return Actor->ActorHasTag(Tag); }))
+		{
+			return false;
+		}
+	}
+
+	const FAISenseAffiliationFilter& Affiliations = Task->PerceptionAffiliations;
+	if (Affiliations.bDetectEnemies && Affiliations.bDetectNeutrals && Affiliations.bDetectFriendlies)
+	{
+		return true;
+	}
+
+	if (!Attitude.IsSet())
+	{
+		Attitude = FGenericTeamId::GetAttitude(OwningController, Actor);
+	}
+
+	switch (Attitude.GetValue())
+	{
+	case ETeamAttitude::Hostile:
+		return Affiliations.bDetectEnemies;
+	case ETeamAttitude::Friendly:
+		return Affiliations.bDetectFriendlies;
+	case ETeamAttitude::Neutral:
+	default:
+		return Affiliations.bDetectNeutrals;
+	}
+}
+
 bool URAIManagerComponent::InvokeTask(TSubclassOf<URAITaskComponent> TaskClass, URAITaskComponent* ParentInvokingTask,
                                       FRAITaskInvokeArguments& InvokeArguments)
 {
-	if (URAITaskComponent* InvokedTask = GetTaskByClass(TaskClass))
+	// FindTaskHandle reports a missing task once per class
+	return InvokeTaskByHandle(FindTaskHandle(TaskClass), ParentInvokingTask, InvokeArguments);
+}
+
+bool URAIManagerComponent::InvokeTaskByHandle(FRAITaskHandle TaskHandle, URAITaskComponent* ParentInvokingTask,
+                                              FRAITaskInvokeArguments& InvokeArguments)
+{
+	if (URAITaskComponent* InvokedTask = GetTaskByHandle(TaskHandle))
 	{
 		if (DebugLoggingEnabled)
 		{
 			UE_LOG(LogRAI, Display, TEXT("Invoking task %s."), *(InvokedTask->GetFName().ToString() ))
 		}
 
+		RAI_COUNT(Invokes, 1);
+		RAI_RECORD_DECISION(ERAIDecisionEventType::TaskInvoke, OwningController, InvokedTask->GetClass()->GetFName(),
+		                    ParentInvokingTask->GetClass()->GetFName(), 0.f);
+
 		InvokedTask->ParentInvokingTask = ParentInvokingTask;
 		ParentInvokingTask->ChildInvokedTask = InvokedTask;
 		InvokedTask->InvokeArgs = InvokeArguments;
-		ParentInvokingTask->IsWaiting = true;
+		ParentInvokingTask->SetIsWaiting(true);
 		StartTask(InvokedTask, InvokeArguments);
 
 		return true;
 	}
-	else
-	{
-		UE_LOG(LogRAI, Error, TEXT("Could not find task of class: %s, did you add the task to your AI?"),
-		       *(TaskClass->GetFName().ToString() ))
-	}
+
 	return false;
 }
 
 void URAIManagerComponent::TaskEnded(URAITaskComponent* Task)
 {
+	InvalidateTaskPriority(Task);
+
 	if (Task == ActiveTask)
 	{
 		if (DebugLoggingEnabled)
@@ -273,6 +834,9 @@ void URAIManagerComponent::ReturnToInvokingTask(URAITaskComponent* CompletedTask
 			       *(CompletedTask->GetClass()->GetName()), *(ParentTask->GetClass()->GetName()))
 		}
 
+		RAI_RECORD_DECISION(ERAIDecisionEventType::TaskReturn, OwningController, CompletedTask->GetClass()->GetFName(),
+		                    ParentTask->GetClass()->GetFName(), Success ? 1.f : 0.f);
+
 		ActiveTask = ParentTask;
 		ParentTask->OnInvokedTaskCompleted(Success);
 	}
@@ -281,80 +845,266 @@ void URAIManagerComponent::ReturnToInvokingTask(URAITaskComponent* CompletedTask
 
 URAITaskComponent* URAIManagerComponent::UpdateTaskPriorities()
 {
-	URAITaskComponent* BestTask = nullptr;
+	int32 BestTaskIndex = INDEX_NONE;
 	float BestTaskScore = 0.f;
 
-	for (URAITaskComponent* Task : PrimaryTasks)
+	FRAIConsiderationContext Context = MakeConsiderationContext();
+	DetectFocusChange(Context.Focus);
+
+	// Reads go to TaskState, task components are only touched when a task has to be re-scored
+	for (int32 TaskIndex = 0; TaskIndex < PrimaryTasks.Num(); ++TaskIndex)
 	{
-		if (!Task || !Task->IsEnabled)
+		const int32 StateIndex = PrimaryTaskStateIndices[TaskIndex];
+		if (!TaskState.IsEnabled[StateIndex] || !PrimaryTasks[TaskIndex])
 		{
+			// Its inputs went unobserved while disabled
+			DirtyPrimaryTasks[TaskIndex] = true;
 			continue;
 		}
-		
 
-		float Priority = Task->CalculatePriority();
-		Task->SetPriority(Priority);
+		float Priority = TaskState.Priority[StateIndex];
+		if (NeedsRescore(TaskIndex, Context.WorldTime))
+		{
+			URAITaskComponent* Task = PrimaryTasks[TaskIndex];
+			{
+				RAI_TASK_SCOPE(Task, TEXT("CalculatePriority"));
+				FRAICostScope CostScope(Task->CostClassSlot, ERAICostPhase::Score);
+				if (const FRAIConsiderationProgram* Program = PrimaryTaskPrograms[TaskIndex].Get())
+				{
+					Context.Task = Task;
+					Priority = Program->Evaluate(Context);
+				}
+				else
+				{
+					Priority = Task->CalculatePriority();
+				}
+			}
+			RAI_COUNT(PrioritiesEvaluated, 1);
+			RecordPrioritySnapshot(TaskIndex, TaskState.Priority[StateIndex], Priority, Context.WorldTime);
+			Task->SetPriority(Priority);
+			MarkRescored(TaskIndex, Context.WorldTime);
+		}
 
-		if (Task->IsTaskReady() && Priority > BestTaskScore)
+		if (Priority > BestTaskScore && TaskState.IsTaskReady(StateIndex, Context.WorldTime))
 		{
 			BestTaskScore = Priority;
-			BestTask = Task;
+			BestTaskIndex = TaskIndex;
 		}
 	}
 
-	return BestTask;
+	return BestTaskIndex != INDEX_NONE ? PrimaryTasks[BestTaskIndex] : nullptr;
 }
 
-bool URAIManagerComponent::CheckIfTaskShouldInterrupt(const URAITaskComponent* TaskToInterrupt,
-                                                      const URAITaskComponent* InterruptingTask) const
+FRAIConsiderationContext URAIManagerComponent::MakeConsiderationContext() const
 {
-	if (!ActiveTask || !InterruptingTask)
+	FRAIConsiderationContext Context;
+	Context.Manager = this;
+	Context.Pawn = Character;
+	Context.Focus = ControllerFocus ? ControllerFocus : OwningController->GetFocusActor();
+	Context.Knowledge = KnowledgeComponent;
+	Context.WorldTime = GetWorld()->GetTimeSeconds();
+	return Context;
+}
+
+void URAIManagerComponent::DetectFocusChange(const AActor* Focus)
+{
+	const bool FocusChanged = LastScoredFocus.Get() != Focus ||
+		FMath::Abs(DistanceToFocus - LastScoredDistanceToFocus) > FocusDistanceInvalidationThreshold ||
+		FMath::Abs(DistanceToFocusLastDetectedPoint - LastScoredDistanceToFocusLastDetectedPoint) > FocusDistanceInvalidationThreshold;
+
+	if (FocusChanged)
+	{
+		LastScoredFocus = const_cast<AActor*>(Focus);
+		LastScoredDistanceToFocus = DistanceToFocus;
+		LastScoredDistanceToFocusLastDetectedPoint = DistanceToFocusLastDetectedPoint;
+		InvalidatePriorityInputs(static_cast<int32>(ERAIPriorityDependency::Focus));
+	}
+}
+
+bool URAIManagerComponent::NeedsRescore(int32 TaskIndex, float WorldTime) const
+{
+	if (!FieldSettings.RescoreBlueprintPriorities && !PrimaryTaskPrograms[TaskIndex] && PrimaryTaskScoreTimes[TaskIndex] >= 0.f)
 	{
+		// Blueprint scored tasks keep their last priority in this field
 		return false;
 	}
 
-	const ERAIInterruptionType ActiveTaskInterruptionType = TaskToInterrupt->InterruptType;
+	if (DirtyPrimaryTasks[TaskIndex] || EnumHasAnyFlags(PrimaryTaskDependencies[TaskIndex], ERAIPriorityDependency::Always))
+	{
+		return true;
+	}
+
+	return MaxCachedPriorityAge > 0.f && WorldTime - PrimaryTaskScoreTimes[TaskIndex] >= MaxCachedPriorityAge;
+}
+
+void URAIManagerComponent::MarkRescored(int32 TaskIndex, float WorldTime)
+{
+	DirtyPrimaryTasks[TaskIndex] = false;
+	PrimaryTaskScoreTimes[TaskIndex] = WorldTime;
+}
+
+void URAIManagerComponent::RecordPrioritySnapshot(int32 TaskIndex, float OldPriority, float NewPriority, float WorldTime)
+{
+#if RAI_DECISION_RECORDER_ENABLED
+	// A snapshot per rescore would flood the recorder at full agent count. The keyframe still tells the trace analyzer
+	// that a stable priority was rescored recently
+	float& SnapshotTime = PrimaryTaskSnapshotTimes[TaskIndex];
+	if (NewPriority == OldPriority && SnapshotTime >= 0.f && WorldTime - SnapshotTime < FRAIDecisionRecorder::GetSnapshotKeyframeInterval())
+	{
+		return;
+	}
+
+	SnapshotTime = WorldTime;
+	RAI_RECORD_DECISION(ERAIDecisionEventType::PrioritySnapshot, OwningController, PrimaryTasks[TaskIndex]->GetClass()->GetFName(),
+	                    NAME_None, NewPriority);
+#endif
+}
+
+void URAIManagerComponent::GatherPriorityInputs(FRAIPriorityBatch& Batch)
+{
+	FRAIPriorityBatch::FAgent& Agent = Batch.Agents.AddDefaulted_GetRef();
+	Agent.Manager = this;
+	Agent.FirstJob = Batch.Jobs.Num();
+	Agent.NumJobs = PrimaryTasks.Num();
+
+	FRAIConsiderationContext Context = MakeConsiderationContext();
+	DetectFocusChange(Context.Focus);
 
-	float priorityGap = 0.f;
-	switch (ActiveTaskInterruptionType)
+	for (int32 TaskIndex = 0; TaskIndex < PrimaryTasks.Num(); ++TaskIndex)
+	{
+		const int32 StateIndex = PrimaryTaskStateIndices[TaskIndex];
+		FRAIPriorityBatch::FJob& Job = Batch.Jobs.AddDefaulted_GetRef();
+
+		if (!TaskState.IsEnabled[StateIndex] || !PrimaryTasks[TaskIndex])
+		{
+			DirtyPrimaryTasks[TaskIndex] = true;
+			Job.Skip = true;
+			continue;
+		}
+
+		if (!NeedsRescore(TaskIndex, Context.WorldTime))
+		{
+			// Nothing it reads changed, commit the cached priority as is
+			Job.Score = TaskState.Priority[StateIndex];
+			continue;
+		}
+
+		URAITaskComponent* Task = PrimaryTasks[TaskIndex];
+		MarkRescored(TaskIndex, Context.WorldTime);
+		Job.Rescored = true;
+		RAI_COUNT(PrioritiesEvaluated, 1);
+
+		if (const FRAIConsiderationProgram* Program = PrimaryTaskPrograms[TaskIndex].Get())
+		{
+			// Snapshot the inputs now, the program is scored later on a worker thread
+			Context.Task = Task;
+			Job.Program = Program;
+			Job.InputOffset = Batch.Inputs.AddUninitialized(Program->Num());
+			Program->GatherInputs(Context, Batch.Inputs.GetData() + Job.InputOffset);
+		}
+		else
+		{
+			// Blueprint fallbacks can only run on the game thread, score them during the gather
+			RAI_TASK_SCOPE(Task, TEXT("CalculatePriority"));
+			FRAICostScope CostScope(Task->CostClassSlot, ERAICostPhase::Score);
+			Job.Score = Task->CalculatePriority();
+		}
+	}
+}
+
+URAITaskComponent* URAIManagerComponent::CommitPriorities(const FRAIPriorityBatch& Batch, int32 AgentIndex)
+{
+	const FRAIPriorityBatch::FAgent& Agent = Batch.Agents[AgentIndex];
+	if (!OwningController || Agent.NumJobs != PrimaryTasks.Num())
+	{
+		return nullptr;
+	}
+
+	int32 BestTaskIndex = INDEX_NONE;
+	float BestTaskScore = 0.f;
+	const float WorldTime = GetWorld()->GetTimeSeconds();
+
+	for (int32 TaskIndex = 0; TaskIndex < Agent.NumJobs; ++TaskIndex)
+	{
+		const FRAIPriorityBatch::FJob& Job = Batch.Jobs[Agent.FirstJob + TaskIndex];
+		const int32 StateIndex = PrimaryTaskStateIndices[TaskIndex];
+		if (Job.Skip || !PrimaryTasks[TaskIndex])
+		{
+			continue;
+		}
+
+		// Cached priorities are already in place, only write back the ones that were scored
+		if (Job.Rescored)
+		{
+			RecordPrioritySnapshot(TaskIndex, TaskState.Priority[StateIndex], Job.Score, WorldTime);
+			PrimaryTasks[TaskIndex]->SetPriority(Job.Score);
+		}
+
+		if (Job.Score > BestTaskScore && TaskState.IsTaskReady(StateIndex, WorldTime))
+		{
+			BestTaskScore = Job.Score;
+			BestTaskIndex = TaskIndex;
+		}
+	}
+
+	return BestTaskIndex != INDEX_NONE ? PrimaryTasks[BestTaskIndex] : nullptr;
+}
+
+bool URAIManagerComponent::NeedsInterruptCheck(const URAITaskComponent* BestTask) const
+{
+	return BestTask && ActiveTask && ActiveTask != BestTask && ActiveTask->GetIsTaskActive() && !ActiveTask->IsDescendantOf(BestTask);
+}
+
+float URAIManagerComponent::GetInterruptPriorityGap(ERAIInterruptionType InterruptionType) const
+{
+	switch (InterruptionType)
 	{
 	case ERAIInterruptionType::Always:
-		priorityGap = 0.01f;
-		break;
+		return 0.01f;
 
 	case ERAIInterruptionType::WaitASec:
-		priorityGap = WaitASecInterruptPriorityGap;
-		break;
+		return WaitASecInterruptPriorityGap;
 
 	case ERAIInterruptionType::PreferablyNot:
-		priorityGap = PreferablyNotInterruptPriorityGap;
-		break;
+		return PreferablyNotInterruptPriorityGap;
 
 	case ERAIInterruptionType::OnlyIfNeeded:
-		priorityGap = OnlyIfNeededInterruptPriorityGap;
-		break;
+		return OnlyIfNeededInterruptPriorityGap;
 
 	case ERAIInterruptionType::IfPanic:
-		priorityGap = IfPanicInterruptPriorityGap;
-		break;
+		return IfPanicInterruptPriorityGap;
 
 	case ERAIInterruptionType::IfLifeOrDeath:
-		priorityGap = IfLifeOrDeathInterruptPriorityGap;
-		break;
+		return IfLifeOrDeathInterruptPriorityGap;
 
 	case ERAIInterruptionType::Never:
-		return false;
+	default:
+		return TNumericLimits<float>::Max();
 	}
+}
 
-	bool ShouldInterrupt = (InterruptingTask->GetPriority() - TaskToInterrupt->GetPriority()) > priorityGap;
+void URAIManagerComponent::FillInterruptPriorityGapTable(float* OutGapTable) const
+{
+	for (int32 TypeIndex = 0; TypeIndex < FRAIConsiderationKernels::NumInterruptionTypes; ++TypeIndex)
+	{
+		OutGapTable[TypeIndex] = GetInterruptPriorityGap(static_cast<ERAIInterruptionType>(TypeIndex));
+	}
+}
 
-	if (ShouldInterrupt && DebugLoggingEnabled)
+bool URAIManagerComponent::CheckIfTaskShouldInterrupt(const URAITaskComponent* TaskToInterrupt,
+                                                      const URAITaskComponent* InterruptingTask) const
+{
+	if (!ActiveTask || !InterruptingTask)
 	{
-		URancUtilityLibrary::ThrottledLog(
-			FString("Task ") + InterruptingTask->GetFName().ToString() + FString(" should interrupt ") + TaskToInterrupt
-			->GetFName().ToString() + FString(" = ") + FString("true"), 3.f,
-			FString("ShouldInterrupt"));
+		return false;
 	}
 
-	return ShouldInterrupt;
+	if (TaskToInterrupt->GetInterruptType() == ERAIInterruptionType::Never)
+	{
+		return false;
+	}
+
+	const float priorityGap = GetInterruptPriorityGap(TaskToInterrupt->GetInterruptType());
+
+	return (InterruptingTask->GetPriority() - TaskToInterrupt->GetPriority()) > priorityGap;
 }
@@ -0,0 +1,121 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAIPriorityBatch.h"
+
+#include "RAIConsiderationSet.h"
+#include "RAIManagerComponent.h"
+#include "Async/ParallelFor.h"
+
+// Jobs handed to one worker at a time, small enough to balance, large enough to amortize scheduling
+static constexpr int32 JobsPerParallelChunk = 64;
+// Size of the stack buffer the responses of a run of lanes are scattered from
+static constexpr int32 LanesPerKernelCall = 256;
+
+void FRAIPriorityBatch::Reset()
+{
+	Agents.Reset();
+	Jobs.Reset();
+	Inputs.Reset();
+	Responses.Reset();
+	InterruptCandidatePriorities.Reset();
+	InterruptActivePriorities.Reset();
+	InterruptTypes.Reset();
+	InterruptGapTableOffsets.Reset();
+	InterruptGapTables.Reset();
+	InterruptDecisions.Reset();
+}
+
+void FRAIPriorityBatch::ScoreParallel()
+{
+	Responses.SetNumUninitialized(Inputs.Num());
+
+	const int32 NumJobChunks = FMath::DivideAndRoundUp(Jobs.Num(), JobsPerParallelChunk);
+	if (ChunkLanes.Num() < NumJobChunks)
+	{
+		ChunkLanes.SetNum(NumJobChunks);
+	}
+
+	ParallelFor(NumJobChunks, [this](int32 ChunkIndex)
+	{
+		const int32 FirstJobIndex = ChunkIndex * JobsPerParallelChunk;
+		const int32 EndJobIndex = FMath::Min(FirstJobIndex + JobsPerParallelChunk, Jobs.Num());
+		FRAICurveLanes* CurveLanes = ChunkLanes[ChunkIndex].CurveLanes;
+
+		// Regroup the inputs of this chunk by curve type so each type runs through its kernel as one array
+		for (int32 CurveType = 0; CurveType < UE_ARRAY_COUNT(FChunkLanes::CurveLanes); ++CurveType)
+		{
+			CurveLanes[CurveType].Reset();
+		}
+
+		for (int32 JobIndex = FirstJobIndex; JobIndex < EndJobIndex; ++JobIndex)
+		{
+			const FJob& Job = Jobs[JobIndex];
+			if (Job.Program && !Job.Skip)
+			{
+				for (int32 InstructionIndex = 0; InstructionIndex < Job.Program->Num(); ++InstructionIndex)
+				{
+					const int32 InputIndex = Job.InputOffset + InstructionIndex;
+					const int32 CurveType = static_cast<int32>(Job.Program->Instructions[InstructionIndex].CurveType);
+					CurveLanes[CurveType].Add(*Job.Program, InstructionIndex, Inputs[InputIndex], InputIndex);
+				}
+			}
+		}
+
+		for (int32 CurveType = 0; CurveType < UE_ARRAY_COUNT(FChunkLanes::CurveLanes); ++CurveType)
+		{
+			const FRAICurveLanes& Lanes = CurveLanes[CurveType];
+			for (int32 FirstLane = 0; FirstLane < Lanes.Num(); FirstLane += LanesPerKernelCall)
+			{
+				const int32 LaneCount = FMath::Min(LanesPerKernelCall, Lanes.Num() - FirstLane);
+
+				float KernelResponses[LanesPerKernelCall];
+				FRAIConsiderationKernels::EvaluateCurves(static_cast<ERAIResponseCurveType>(CurveType), Lanes, FirstLane, LaneCount, KernelResponses);
+
+				for (int32 Lane = 0; Lane < LaneCount; ++Lane)
+				{
+					Responses[Lanes.OutputIndices[FirstLane + Lane]] = KernelResponses[Lane];
+				}
+			}
+		}
+
+		for (int32 JobIndex = FirstJobIndex; JobIndex < EndJobIndex; ++JobIndex)
+		{
+			FJob& Job = Jobs[JobIndex];
+			if (Job.Program && !Job.Skip)
+			{
+				Job.Score = Job.Program->CombineResponses(Responses.GetData() + Job.InputOffset);
+			}
+		}
+	}, NumJobChunks <= 1 ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+}
+
+void FRAIPriorityBatch::AddInterruptLane(int32 AgentIndex, float CandidatePriority, float ActivePriority, ERAIInterruptionType InterruptType)
+{
+	FAgent& Agent = Agents[AgentIndex];
+	Agent.InterruptLane = InterruptTypes.Num();
+	InterruptCandidatePriorities.Add(CandidatePriority);
+	InterruptActivePriorities.Add(ActivePriority);
+	InterruptTypes.Add(InterruptType);
+
+	const int32 GapTableOffset = InterruptGapTables.AddUninitialized(FRAIConsiderationKernels::NumInterruptionTypes);
+	InterruptGapTableOffsets.Add(GapTableOffset);
+	if (const URAIManagerComponent* Manager = Agent.Manager.Get())
+	{
+		Manager->FillInterruptPriorityGapTable(InterruptGapTables.GetData() + GapTableOffset);
+	}
+	else
+	{
+		for (int32 TypeIndex = 0; TypeIndex < FRAIConsiderationKernels::NumInterruptionTypes; ++TypeIndex)
+		{
+			InterruptGapTables[GapTableOffset + TypeIndex] = TNumericLimits<float>::Max();
+		}
+	}
+}
+
+void FRAIPriorityBatch::EvaluateInterrupts()
+{
+	InterruptDecisions.SetNumUninitialized(InterruptTypes.Num());
+	FRAIConsiderationKernels::ShouldInterruptBatch(InterruptCandidatePriorities.GetData(), InterruptActivePriorities.GetData(),
+	                                               InterruptTypes.GetData(), InterruptGapTables.GetData(),
+	                                               InterruptGapTableOffsets.GetData(), InterruptDecisions.GetData(), InterruptTypes.Num());
+}
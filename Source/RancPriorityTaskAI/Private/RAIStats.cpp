@@ -0,0 +1,20 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAIStats.h"
+
+UE_TRACE_CHANNEL_DEFINE(RAIChannel);
+
+DEFINE_STAT(STAT_RAI_UpdateActiveTasks);
+DEFINE_STAT(STAT_RAI_AgentsUpdated);
+DEFINE_STAT(STAT_RAI_PrioritiesEvaluated);
+DEFINE_STAT(STAT_RAI_Interrupts);
+DEFINE_STAT(STAT_RAI_Invokes);
+DEFINE_STAT(STAT_RAI_LoopPenalties);
+DEFINE_STAT(STAT_RAI_SmoothPathSegments);
+DEFINE_STAT(STAT_RAI_SmoothPathCacheHits);
+DEFINE_STAT(STAT_RAI_SmoothPathCacheMisses);
+DEFINE_STAT(STAT_RAI_StimuliDelivered);
+DEFINE_STAT(STAT_RAI_StimuliCoalesced);
+DEFINE_STAT(STAT_RAI_FactsExpired);
+
+CSV_DEFINE_CATEGORY(RAI, true);
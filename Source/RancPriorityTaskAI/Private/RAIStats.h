@@ -0,0 +1,42 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+#include "Trace/Trace.h"
+
+/* Trace with -trace=cpu,RAI to see the RAI_TASK_SCOPE timings in Unreal Insights */
+UE_TRACE_CHANNEL_EXTERN(RAIChannel);
+
+DECLARE_STATS_GROUP(TEXT("RAI"), STATGROUP_RAI, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Active Tasks"), STAT_RAI_UpdateActiveTasks, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Agents Updated"), STAT_RAI_AgentsUpdated, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Priorities Evaluated"), STAT_RAI_PrioritiesEvaluated, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Interrupts"), STAT_RAI_Interrupts, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Invokes"), STAT_RAI_Invokes, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Loop Penalties"), STAT_RAI_LoopPenalties, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Smooth Path Segments"), STAT_RAI_SmoothPathSegments, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Smooth Path Cache Hits"), STAT_RAI_SmoothPathCacheHits, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Smooth Path Cache Misses"), STAT_RAI_SmoothPathCacheMisses, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Stimuli Delivered"), STAT_RAI_StimuliDelivered, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Stimuli Coalesced"), STAT_RAI_StimuliCoalesced, STATGROUP_RAI, );
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Facts Expired"), STAT_RAI_FactsExpired, STATGROUP_RAI, );
+
+CSV_DECLARE_CATEGORY_EXTERN(RAI);
+
+/* Adds to one of the counters above, both to stat RAI and to the RAI csv profiler category */
+#define RAI_COUNT(Name, Amount) \
+	do \
+	{ \
+		INC_DWORD_STAT_BY(STAT_RAI_##Name, Amount); \
+		CSV_CUSTOM_STAT(RAI, Name, Amount, ECsvCustomStatOp::Accumulate); \
+	} while (0)
+
+/* CPU scope on the RAI channel named after the class of a task, e.g. "BP_Hunt_C BeginTask". The name is only built while the channel is traced */
+#define RAI_TASK_SCOPE(Task, Event) \
+	TRACE_CPUPROFILER_EVENT_SCOPE_TEXT_ON_CHANNEL( \
+		UE_TRACE_CHANNELEXPR_IS_ENABLED(RAIChannel) ? *WriteToString<128>((Task)->GetClass()->GetFName(), TEXT(" "), Event) : TEXT(""), \
+		RAIChannel)
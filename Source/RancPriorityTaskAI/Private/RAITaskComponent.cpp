@@ -4,11 +4,19 @@
 
 #include "GameplayTagContainer.h"
 #include "RAIManagerComponent.h"
+#include "RAITaskStateArrays.h"
+#include "RAIDecisionRecorder.h"
 #include "RAIController.h"
 #include "RAILogCategory.h"
+#include "RAIStats.h"
+#include "RAICostTracker.h"
 #include "TimerManager.h"
 #include "Math/UnrealMathUtility.h"
 #include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "NavigationSystem.h"
+#include "NavigationPath.h"
 
 // Sets default values for this component's properties
 URAITaskComponent::URAITaskComponent()
@@ -16,31 +24,43 @@ URAITaskComponent::URAITaskComponent()
 	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = false;
+
+	PerceptionAffiliations.bDetectEnemies = true;
+	PerceptionAffiliations.bDetectNeutrals = true;
+	PerceptionAffiliations.bDetectFriendlies = true;
 }
 
 void URAITaskComponent::Initialize_Implementation(ACharacter* _Character, ARAIController* _OwnerController)
 {
-	InterruptType = DefaultInterruptType;
+	SetInterruptType(DefaultInterruptType);
 	Character = _Character;
 
 	// Validate configuration values.
-	if (Cooldown < 0.0f)
+	if (GetCooldown() < 0.0f)
 	{
-		Cooldown = 0.0f;
+		SetCooldown(0.0f);
 	}
 }
 
 void URAITaskComponent::BeginTask_Implementation(const FRAITaskInvokeArguments& InvokeArguments)
 {
-	OwnerController->TraceThought(FString("Beginning: ") + GetFName().ToString());
-	WorldTimeBegun = GetWorld()->GetTimeSeconds();
-	IsTaskActive = true;
-	IsWaiting = false;
-	NextBeginCooldown = 0.0f;
+	RAI_TRACE_THOUGHT(OwnerController, ERAIThoughtType::BeginTask, GetFName(), 0);
+	SetWorldTimeBegun(GetWorld()->GetTimeSeconds());
+	SetIsTaskActive(true);
+	SetIsWaiting(false);
+	SetNextBeginCooldown(0.0f);
 	
 	CheckForInfLoop();
 }
 
+void URAITaskComponent::EndTaskCore(bool Success, float BeginAgainCooldown, bool WasInterrupted)
+{
+	// Measured here rather than in EndTask_Implementation, so blueprint overrides are covered even if they skip the parent call
+	RAI_TASK_SCOPE(this, TEXT("EndTask"));
+	FRAICostScope CostScope(CostClassSlot, ERAICostPhase::End);
+	EndTask(Success, BeginAgainCooldown, WasInterrupted);
+}
+
 void URAITaskComponent::EndTask_Implementation(bool Success, float BeginAgainCooldown, bool WasInterrupted)
 {
 	if (DebugLoggingEnabled)
@@ -48,17 +68,19 @@ void URAITaskComponent::EndTask_Implementation(bool Success, float BeginAgainCoo
 		UE_LOG(LogRAI, Display, TEXT("Task %s ended with success %d"), *GetClass()->GetName(), Success);
 	}
 	
+	RAI_RECORD_DECISION(ERAIDecisionEventType::TaskExit, OwnerController, GetClass()->GetFName(), NAME_None, Success ? 1.f : 0.f);
 	ManagerComponent->TaskEnded(this);
 	WorldTimeEnd = GetWorld()->GetTimeSeconds();
-	IsTaskActive = false;
-	IsWaiting = false;
+	SetIsTaskActive(false);
+	SetIsWaiting(false);
+	IsSimulatingDistant = false;
 	InvokeArgs = FRAITaskInvokeArguments();
-	InterruptType = DefaultInterruptType;
-	NextBeginCooldown = BeginAgainCooldown;
+	SetInterruptType(DefaultInterruptType);
+	SetNextBeginCooldown(BeginAgainCooldown);
 
 	if (ParentInvokingTask != nullptr)
 	{
-		ParentInvokingTask->IsWaiting = false;
+		ParentInvokingTask->SetIsWaiting(false);
 		auto* CurrentParentInvokingTask = ParentInvokingTask;
 		ParentInvokingTask = nullptr;
 
@@ -72,20 +94,24 @@ void URAITaskComponent::EndTask_Implementation(bool Success, float BeginAgainCoo
 
 	if (ChildInvokedTask != nullptr)
 	{
-		ChildInvokedTask->EndTask(false, 0, WasInterrupted);
+		ChildInvokedTask->EndTaskCore(false, 0, WasInterrupted);
 		ChildInvokedTask = nullptr;
 	}
 }
 
 bool URAITaskComponent::IsTaskReady()
 {
+	const float CurrentTime = GetWorld()->GetTimeSeconds();
+	if (const FRAITaskStateArrays* State = GetStateArrays())
+	{
+		return State->IsTaskReady(TaskHandle.Index, CurrentTime);
+	}
+
 	if (NextBeginCooldown <= 0 && Cooldown <= 0.0f || WorldTimeBegun <= 0.0f)
 	{
 		return true; //Either Cooldown is none, or we haven't done the task yet.
 	}
 
-	const float CurrentTime = GetWorld()->GetTimeSeconds();
-
 	if (NextBeginCooldown > 0)
 	{
 		return CurrentTime - WorldTimeBegun >= NextBeginCooldown;
@@ -96,9 +122,202 @@ bool URAITaskComponent::IsTaskReady()
 
 void URAITaskComponent::SetPriority(float NewPriority)
 {
-	Priority = NewPriority;
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->Priority[TaskHandle.Index] = NewPriority;
+	}
+	else
+	{
+		Priority = NewPriority;
+	}
+}
+
+void URAITaskComponent::SetIsEnabled(bool NewIsEnabled)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->IsEnabled[TaskHandle.Index] = NewIsEnabled;
+	}
+	else
+	{
+		IsEnabled = NewIsEnabled;
+	}
+}
+
+void URAITaskComponent::SetCooldown(float NewCooldown)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->Cooldown[TaskHandle.Index] = NewCooldown;
+	}
+	else
+	{
+		Cooldown = NewCooldown;
+	}
+}
+
+void URAITaskComponent::SetNextBeginCooldown(float NewNextBeginCooldown)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->NextBeginCooldown[TaskHandle.Index] = NewNextBeginCooldown;
+	}
+	else
+	{
+		NextBeginCooldown = NewNextBeginCooldown;
+	}
+}
+
+void URAITaskComponent::SetInterruptType(ERAIInterruptionType NewInterruptType)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->InterruptType[TaskHandle.Index] = NewInterruptType;
+	}
+	else
+	{
+		InterruptType = NewInterruptType;
+	}
+}
+
+void URAITaskComponent::SetIsTaskActive(bool NewIsTaskActive)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->IsTaskActive[TaskHandle.Index] = NewIsTaskActive;
+	}
+	else
+	{
+		IsTaskActive = NewIsTaskActive;
+	}
+}
+
+void URAITaskComponent::SetIsWaiting(bool NewIsWaiting)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->IsWaiting[TaskHandle.Index] = NewIsWaiting;
+	}
+	else
+	{
+		IsWaiting = NewIsWaiting;
+	}
+}
+
+void URAITaskComponent::SetWorldTimeBegun(float NewWorldTimeBegun)
+{
+	if (FRAITaskStateArrays* State = GetStateArrays())
+	{
+		State->WorldTimeBegun[TaskHandle.Index] = NewWorldTimeBegun;
+	}
+	else
+	{
+		WorldTimeBegun = NewWorldTimeBegun;
+	}
+}
+
+float URAITaskComponent::GetOwnPriority() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->Priority[TaskHandle.Index] : Priority;
+}
+
+bool URAITaskComponent::GetIsEnabled() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->IsEnabled[TaskHandle.Index] : IsEnabled;
 }
 
+float URAITaskComponent::GetCooldown() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->Cooldown[TaskHandle.Index] : Cooldown;
+}
+
+float URAITaskComponent::GetNextBeginCooldown() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->NextBeginCooldown[TaskHandle.Index] : NextBeginCooldown;
+}
+
+ERAIInterruptionType URAITaskComponent::GetInterruptType() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->InterruptType[TaskHandle.Index] : InterruptType;
+}
+
+bool URAITaskComponent::GetIsTaskActive() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->IsTaskActive[TaskHandle.Index] : IsTaskActive;
+}
+
+bool URAITaskComponent::GetIsWaiting() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->IsWaiting[TaskHandle.Index] : IsWaiting;
+}
+
+float URAITaskComponent::GetWorldTimeBegun() const
+{
+	const FRAITaskStateArrays* State = GetStateArrays();
+	return State ? State->WorldTimeBegun[TaskHandle.Index] : WorldTimeBegun;
+}
+
+FRAITaskStateArrays* URAITaskComponent::GetStateArrays() const
+{
+	if (ManagerComponent && ManagerComponent->TaskState.Priority.IsValidIndex(TaskHandle.Index))
+	{
+		return &ManagerComponent->TaskState;
+	}
+
+	return nullptr;
+}
+
+void URAITaskComponent::CopyStateTo(FRAITaskStateArrays& State) const
+{
+	const int32 Index = TaskHandle.Index;
+	State.Priority[Index] = Priority;
+	State.Cooldown[Index] = Cooldown;
+	State.NextBeginCooldown[Index] = NextBeginCooldown;
+	State.WorldTimeBegun[Index] = WorldTimeBegun;
+	State.InterruptType[Index] = InterruptType;
+	State.IsEnabled[Index] = IsEnabled;
+	State.IsTaskActive[Index] = IsTaskActive;
+	State.IsWaiting[Index] = IsWaiting;
+}
+
+#if WITH_EDITOR
+void URAITaskComponent::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+
+	// Edits made in the details panel while simulating bypass the setters. Only the edited field is current, the others
+	// still hold the configured values
+	const FName PropertyName = PropertyChangedEvent.GetMemberPropertyName();
+	if (PropertyName == GET_MEMBER_NAME_CHECKED(URAITaskComponent, IsEnabled))
+	{
+		SetIsEnabled(IsEnabled);
+	}
+	else if (PropertyName == GET_MEMBER_NAME_CHECKED(URAITaskComponent, Cooldown))
+	{
+		SetCooldown(Cooldown);
+	}
+	else if (PropertyName == GET_MEMBER_NAME_CHECKED(URAITaskComponent, NextBeginCooldown))
+	{
+		SetNextBeginCooldown(NextBeginCooldown);
+	}
+	else if (PropertyName == GET_MEMBER_NAME_CHECKED(URAITaskComponent, InterruptType))
+	{
+		SetInterruptType(InterruptType);
+	}
+	else if (PropertyName == GET_MEMBER_NAME_CHECKED(URAITaskComponent, IsWaiting))
+	{
+		SetIsWaiting(IsWaiting);
+	}
+}
+#endif
+
 
 bool URAITaskComponent::CheckForInfLoop()
 {
@@ -115,18 +334,21 @@ bool URAITaskComponent::CheckForInfLoop()
 	CurrentTaskLoopCount++;
 	if (CurrentTaskLoopCount >= MaxTaskLoopCount)
 	{
+		RAI_COUNT(LoopPenalties, 1);
+		RAI_RECORD_DECISION(ERAIDecisionEventType::LoopDetected, OwnerController, GetClass()->GetFName(), NAME_None, static_cast<float>(CurrentTaskLoopCount));
+
 		 if (DebugLoggingEnabled)
 		 {
 			 UE_LOG(LogRAI, Warning, TEXT("Task %s Infinite loop detection"), *GetClass()->GetName());
 		 }
 		
-		if (Cooldown <= 0.f)
+		if (GetCooldown() <= 0.f)
 		{
 			// go through each parent and set cooldown
 			URAITaskComponent* TaskToSetCooldown = this;
 			while (TaskToSetCooldown != nullptr)
 			{
-				TaskToSetCooldown->Cooldown = 1.f;
+				TaskToSetCooldown->SetCooldown(1.f);
 				UE_LOG(LogRAI, Warning, TEXT("Task %s seems to be in an infinite loop, adding a cooldown to it"), *GetClass()->GetName());
 				TaskToSetCooldown = TaskToSetCooldown->ParentInvokingTask;
 			}
@@ -148,24 +370,209 @@ void URAITaskComponent::OnCustomTrigger_Implementation(FGameplayTag Trigger, UOb
 {
 }
 
+void URAITaskComponent::OnSimulationFieldChanged_Implementation(ERAIField NewField)
+{
+}
+
 float URAITaskComponent::GetPriority() const
 {
 	if (!IsPrimaryTask)
 	{
 		if (const URAITaskComponent* AncestorTask = GetOldestInvokingAncestor())
 		{
-			return AncestorTask->Priority;
+			return AncestorTask->GetOwnPriority();
 		}
 	}
 	
-	return Priority;
+	return GetOwnPriority();
 }
 
 void URAITaskComponent::BeginTaskCore(const FRAITaskInvokeArguments& InvokeArguments)
 {
+	if (SupportsDistantSimulation && ManagerComponent && ManagerComponent->GetFieldSettings().SimulationStep > 0.f)
+	{
+		BeginDistantTaskCore(InvokeArguments);
+		return;
+	}
+
+	IsSimulatingDistant = false;
+	RAI_TASK_SCOPE(this, TEXT("BeginTask"));
+	FRAICostScope CostScope(CostClassSlot, ERAICostPhase::Begin);
 	BeginTask(InvokeArguments);
 }
 
+void URAITaskComponent::BeginDistantTaskCore(const FRAITaskInvokeArguments& InvokeArguments)
+{
+	// Same bookkeeping as BeginTask, minus the thought trace nobody is close enough to read
+	SetWorldTimeBegun(GetWorld()->GetTimeSeconds());
+	SetIsTaskActive(true);
+	SetIsWaiting(false);
+	SetNextBeginCooldown(0.0f);
+	IsSimulatingDistant = true;
+	DistantElapsed = 0.f;
+	DistantPathPoints.Reset();
+
+	CheckForInfLoop();
+
+	RAI_TASK_SCOPE(this, TEXT("BeginDistantTask"));
+	FRAICostScope CostScope(CostClassSlot, ERAICostPhase::Begin);
+	BeginDistantTask(InvokeArguments);
+}
+
+void URAITaskComponent::BeginDistantTask_Implementation(const FRAITaskInvokeArguments& InvokeArguments)
+{
+}
+
+void URAITaskComponent::SimulateDistantStepCore(float StepSeconds)
+{
+	DistantElapsed += StepSeconds;
+	SimulateDistantStep(StepSeconds);
+}
+
+void URAITaskComponent::SimulateDistantStep_Implementation(float StepSeconds)
+{
+	if (DistantElapsed >= DistantExpectedDuration)
+	{
+		EndTaskCore(true);
+	}
+}
+
+void URAITaskComponent::OnPromotedToNearField_Implementation()
+{
+}
+
+void URAITaskComponent::ReconcileWithNearField()
+{
+	if (DebugLoggingEnabled)
+	{
+		UE_LOG(LogRAI, Display, TEXT("Task %s promoted to near field after %.1f simulated seconds"), *GetClass()->GetName(), DistantElapsed);
+	}
+
+	IsSimulatingDistant = false;
+	DistantPathPoints.Reset();
+
+	// Distant moves teleport without sweeping, make sure the pawn stands on the navmesh before it can be seen
+	if (Character)
+	{
+		if (const UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+		{
+			FNavLocation NavLocation;
+			if (NavSys->ProjectPointToNavigation(Character->GetActorLocation(), NavLocation))
+			{
+				Character->SetActorLocation(NavLocation.Location + FVector(0.f, 0.f, Character->GetSimpleCollisionHalfHeight()),
+				                            false, nullptr, ETeleportType::TeleportPhysics);
+			}
+		}
+	}
+
+	OnPromotedToNearField();
+
+	// An invoking ancestor is still waiting on its invoked task, beginning it again would invoke a second time
+	if (GetIsTaskActive() && !ChildInvokedTask)
+	{
+		BeginTaskCore(InvokeArgs);
+	}
+}
+
+void URAITaskComponent::DemoteToDistantField()
+{
+	if (DebugLoggingEnabled)
+	{
+		UE_LOG(LogRAI, Display, TEXT("Task %s demoted to the distant field"), *GetClass()->GetName());
+	}
+
+	IsSimulatingDistant = true;
+	DistantElapsed = 0.f;
+	DistantPathPoints.Reset();
+
+	if (ChildInvokedTask)
+	{
+		return;
+	}
+
+	// Only the innermost running task moves, its near field move would fight the distant steps
+	if (OwnerController)
+	{
+		OwnerController->StopMovement();
+	}
+
+	// Whatever the task was waiting for in the near field, e.g. a move, has been stopped
+	GetWorld()->GetTimerManager().ClearTimer(WaitTimerHandle);
+	SetIsWaiting(false);
+	if (IsOverridingInterruptionType)
+	{
+		SetInterruptType(DefaultInterruptType);
+	}
+
+	RAI_TASK_SCOPE(this, TEXT("BeginDistantTask"));
+	FRAICostScope CostScope(CostClassSlot, ERAICostPhase::Begin);
+	BeginDistantTask(InvokeArgs);
+}
+
+bool URAITaskComponent::DistantMoveTo(FVector Destination, float StepSeconds, float AcceptanceRadius)
+{
+	if (!Character)
+	{
+		return false;
+	}
+
+	const float HalfHeight = Character->GetSimpleCollisionHalfHeight();
+	const FVector StartLocation = Character->GetActorLocation();
+	if (FVector::Dist2D(StartLocation, Destination) <= AcceptanceRadius)
+	{
+		return true;
+	}
+
+	if (DistantPathPoints.Num() == 0 || !DistantPathGoal.Equals(Destination, AcceptanceRadius))
+	{
+		DistantPathPoints.Reset();
+		DistantPathGoal = Destination;
+		DistantPathIndex = 1;
+
+		const UNavigationPath* Path = UNavigationSystemV1::FindPathToLocationSynchronously(this, StartLocation, Destination, Character);
+		if (Path && Path->IsValid() && Path->PathPoints.Num() > 1)
+		{
+			DistantPathPoints = Path->PathPoints;
+		}
+		else
+		{
+			// No path, walk straight. Reconciliation puts the pawn back on the navmesh if this cut through anything
+			DistantPathPoints = {StartLocation - FVector(0.f, 0.f, HalfHeight), Destination};
+		}
+
+		DistantPathLocation = DistantPathPoints[0];
+	}
+
+	const UCharacterMovementComponent* Movement = Character->GetCharacterMovement();
+	float RemainingDistance = (Movement ? Movement->GetMaxSpeed() : 600.f) * StepSeconds;
+	FVector Direction = FVector::ZeroVector;
+
+	while (RemainingDistance > 0.f && DistantPathIndex < DistantPathPoints.Num())
+	{
+		const FVector Target = DistantPathPoints[DistantPathIndex];
+		const float DistanceToTarget = FVector::Dist(DistantPathLocation, Target);
+		Direction = (Target - DistantPathLocation).GetSafeNormal2D();
+
+		if (DistanceToTarget <= RemainingDistance)
+		{
+			DistantPathLocation = Target;
+			RemainingDistance -= DistanceToTarget;
+			DistantPathIndex++;
+		}
+		else
+		{
+			DistantPathLocation += (Target - DistantPathLocation) / DistanceToTarget * RemainingDistance;
+			RemainingDistance = 0.f;
+		}
+	}
+
+	const FRotator Rotation = Direction.IsNearlyZero() ? Character->GetActorRotation() : Direction.Rotation();
+	Character->SetActorLocationAndRotation(DistantPathLocation + FVector(0.f, 0.f, HalfHeight), Rotation, false, nullptr,
+	                                       ETeleportType::TeleportPhysics);
+
+	return DistantPathIndex >= DistantPathPoints.Num();
+}
+
 void URAITaskComponent::Restart()
 {
 	if (DebugLoggingEnabled)
@@ -193,7 +600,7 @@ void URAITaskComponent::Restart()
 				UE_LOG(LogRAI, Display, TEXT("Task %s delayed restart ready"), *GetClass()->GetName());
 			}
 			
-			InterruptType = LoopPenaltySavedInterruptType;
+			SetInterruptType(LoopPenaltySavedInterruptType);
 			BeginTaskCore(InvokeArgs);
 		}
 		else
@@ -203,9 +610,9 @@ void URAITaskComponent::Restart()
 				UE_LOG(LogRAI, Display, TEXT("Task %s has penalty so delaying Restart"), *GetClass()->GetName());
 			}
 			
-			LoopPenaltySavedInterruptType = InterruptType;
-			GetWorld()->GetTimerManager().SetTimer(RestartTimerHandle, this, &URAITaskComponent::Restart, Cooldown, false);
-			InterruptType = ERAIInterruptionType::Never;
+			LoopPenaltySavedInterruptType = GetInterruptType();
+			GetWorld()->GetTimerManager().SetTimer(RestartTimerHandle, this, &URAITaskComponent::Restart, GetCooldown(), false);
+			SetInterruptType(ERAIInterruptionType::Never);
 		}
 	}
 	else
@@ -220,15 +627,19 @@ bool URAITaskComponent::InvokeTask(TSubclassOf<URAITaskComponent> TaskClass,
 	return ManagerComponent->InvokeTask(TaskClass, this, InvokeArguments);
 }
 
-void URAITaskComponent::TraceThought(FString Thought)
+bool URAITaskComponent::InvokeTaskByHandle(FRAITaskHandle InvokedTaskHandle, FRAITaskInvokeArguments InvokeArguments)
+{
+	return ManagerComponent->InvokeTaskByHandle(InvokedTaskHandle, this, InvokeArguments);
+}
+
+void URAITaskComponent::TraceThought(const FString& Thought)
 {
 	OwnerController->TraceThought(Thought);
 }
 
-ERAIField URAITaskComponent::GetSimulationField()
+ERAIField URAITaskComponent::GetSimulationField() const
 {
-	// Todo: Implement
-	return ERAIField::NearField;
+	return ManagerComponent ? ManagerComponent->SimulationField : ERAIField::NearField;
 }
 
 URAITaskComponent* URAITaskComponent::GetOldestInvokingAncestor() const
@@ -245,7 +656,8 @@ URAITaskComponent* URAITaskComponent::GetOldestInvokingAncestor() const
 void URAITaskComponent::BeginWaiting(double MaxWaitTime, bool OverrideInterruptionType, ERAIInterruptionType InterruptTypeWhileWaiting)
 {
 	// Set the task to waiting state
-	IsWaiting = true;
+	SetIsWaiting(true);
+	MaxWaitDuration = MaxWaitTime;
 
 	// If a valid wait time is provided, set up a timer to end waiting
 	if (MaxWaitTime > 0.f)
@@ -256,13 +668,13 @@ void URAITaskComponent::BeginWaiting(double MaxWaitTime, bool OverrideInterrupti
 	IsOverridingInterruptionType = OverrideInterruptionType;
 	if (OverrideInterruptionType)
 	{
-		InterruptType = InterruptTypeWhileWaiting;
+		SetInterruptType(InterruptTypeWhileWaiting);
 	}
 }
 
 void URAITaskComponent::DoneWaiting(ERAIInterruptionType InterruptTypeToReturnTo, EDoneWaitingExecutionStates& ReturnBranch)
 {
-	const bool WasInterrupted = !IsTaskActive;
+	const bool WasInterrupted = !GetIsTaskActive();
 	
 	if (DebugLoggingEnabled)
 	{
@@ -284,7 +696,7 @@ void URAITaskComponent::DoneWaiting(ERAIInterruptionType InterruptTypeToReturnTo
 	}
 
 	
-	if (IsWaiting)
+	if (GetIsWaiting())
 	{
 		// Clear the timer if it's active
 		if (WaitTimerHandle.IsValid())
@@ -293,11 +705,11 @@ void URAITaskComponent::DoneWaiting(ERAIInterruptionType InterruptTypeToReturnTo
 		}
 
 		// Set the task to not waiting state
-		IsWaiting = false;
+		SetIsWaiting(false);
 
 		if (!WasInterrupted && IsOverridingInterruptionType)
 		{
-			InterruptType = InterruptTypeToReturnTo;
+			SetInterruptType(InterruptTypeToReturnTo);
 		}
 	}
 }
@@ -307,9 +719,11 @@ void URAITaskComponent::OnWaitTimeout()
 	// This function is called when the wait time exceeds MaxWaitTime
 
 	// Set the task to not waiting state
-	IsWaiting = false;
+	SetIsWaiting(false);
+
+	RAI_RECORD_DECISION(ERAIDecisionEventType::WaitTimeout, OwnerController, GetClass()->GetFName(), NAME_None, static_cast<float>(MaxWaitDuration));
 	
-	OwnerController->TraceThought(FString::Printf(TEXT("Task %s timed out!"), *GetClass()->GetName()));
+	RAI_TRACE_THOUGHT(OwnerController, ERAIThoughtType::TaskTimedOut, GetClass()->GetFName(), 0);
 
 	ManagerComponent->ForceInterruptActiveTask(this);
 }
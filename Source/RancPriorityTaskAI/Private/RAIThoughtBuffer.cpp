@@ -0,0 +1,84 @@
+// Copyright Rancorous Games, 2024
+
+#include "RAIThoughtBuffer.h"
+
+void FRAIThoughtBuffer::SetCapacity(int32 NewCapacity)
+{
+	NewCapacity = FMath::Max(NewCapacity, 1);
+	if (NewCapacity == Entries.Num())
+	{
+		return;
+	}
+
+	Entries.Reset();
+	Entries.SetNum(NewCapacity);
+	Head = 0;
+	Count = 0;
+}
+
+FRAIThought& FRAIThoughtBuffer::AddSlot(ERAIThoughtType Type, double WorldTime)
+{
+	if (Entries.Num() == 0)
+	{
+		SetCapacity(1);
+	}
+
+	FRAIThought& Thought = Entries[Head];
+	Thought.Type = Type;
+	Thought.WorldTime = WorldTime;
+
+	Head = (Head + 1) % Entries.Num();
+	Count = FMath::Min(Count + 1, Entries.Num());
+	return Thought;
+}
+
+void FRAIThoughtBuffer::Add(ERAIThoughtType Type, FName Subject, int32 Value, double WorldTime)
+{
+	FRAIThought& Thought = AddSlot(Type, WorldTime);
+	Thought.Subject = Subject;
+	Thought.Value = Value;
+}
+
+void FRAIThoughtBuffer::AddText(const FString& Text, double WorldTime)
+{
+	// Assigning into the old string reuses its allocation
+	FRAIThought& Thought = AddSlot(ERAIThoughtType::Text, WorldTime);
+	Thought.Subject = NAME_None;
+	Thought.Value = 0;
+	Thought.Text = Text;
+}
+
+const FRAIThought& FRAIThoughtBuffer::Get(int32 IndexFromOldest) const
+{
+	check(IndexFromOldest >= 0 && IndexFromOldest < Count);
+	const int32 Oldest = (Head - Count + Entries.Num()) % Entries.Num();
+	return Entries[(Oldest + IndexFromOldest) % Entries.Num()];
+}
+
+void FRAIThoughtBuffer::CopyFormatted(TArray<FString>& OutThoughts) const
+{
+	OutThoughts.Reserve(OutThoughts.Num() + Count);
+	for (int32 Index = 0; Index < Count; ++Index)
+	{
+		OutThoughts.Add(Format(Get(Index)));
+	}
+}
+
+FString FRAIThoughtBuffer::Format(const FRAIThought& Thought)
+{
+	switch (Thought.Type)
+	{
+	case ERAIThoughtType::BeginTask:
+		return FString("Beginning: ") + Thought.Subject.ToString();
+
+	case ERAIThoughtType::TaskTimedOut:
+		return FString::Printf(TEXT("Task %s timed out!"), *Thought.Subject.ToString());
+
+	case ERAIThoughtType::RAIActiveChanged:
+		return FString("RAI set to: ") + (Thought.Value ? "Active" : "Inactive");
+
+	case ERAIThoughtType::Text:
+	default:
+		return Thought.Text;
+	}
+}
@@ -1,65 +1,543 @@
 ﻿// Copyright Rancorous Games, 2024
 
 #include "SubSystems/RAIKnowledgeComponent.h"
+#include "SubSystems/RAIKnowledgeSubsystem.h"
+#include "Engine/World.h"
 #include "GameFramework/Actor.h"
+#include "Net/UnrealNetwork.h"
+
+//*************************************************************************
+//* Store
+//*************************************************************************
+
+const FRAIKnowledgeStore::FKnownActor* FRAIKnowledgeStore::Find(const AActor* Actor) const
+{
+    return Actor && !KnownActors.IsEmpty() ? KnownActors.Find(TWeakObjectPtr<AActor>(const_cast<AActor*>(Actor))) : nullptr;
+}
+
+// One bit test unless more than MaxIndexedTags tags are in use
+bool FRAIKnowledgeStore::HasRelation(const FKnownActor& Known, FGameplayTag Relation) const
+{
+    // A tag that was never added cannot be known about anyone
+    const int32* Bit = TagBits.Find(Relation);
+    if (!Bit)
+    {
+        return false;
+    }
+
+    if (*Bit != INDEX_NONE)
+    {
+        return (Known.RelationMask & (uint64(1) << *Bit)) != 0;
+    }
+
+    return Known.Facts.ContainsByPredicate([Relation](const FRelationshipFact& Fact) { return Fact.Relation == Relation; });
+}
+
+bool FRAIKnowledgeStore::HasCategory(const FKnownActor& Known, FGameplayTag Category) const
+{
+    const int32* Bit = TagBits.Find(Category);
+    if (!Bit)
+    {
+        return false;
+    }
+
+    if (*Bit != INDEX_NONE)
+    {
+        return (Known.CategoryMask & (uint64(1) << *Bit)) != 0;
+    }
+
+    return Known.Facts.ContainsByPredicate([Category](const FRelationshipFact& Fact) { return Fact.Category == Category; });
+}
+
+FRelationshipFact& FRAIKnowledgeStore::Add(FKnownActor& Known, const FRelationshipFact& RelationshipFact, uint32 FactId)
+{
+    FRelationshipFact& Fact = Known.Facts.Add_GetRef(RelationshipFact);
+    Fact.FactId = FactId;
+    Fact.ExpireTime = 0.0;
+
+    const int32 RelationBit = FindOrAddTagBit(Fact.Relation);
+    const int32 CategoryBit = FindOrAddTagBit(Fact.Category);
+    Known.RelationMask |= RelationBit != INDEX_NONE ? uint64(1) << RelationBit : 0;
+    Known.CategoryMask |= CategoryBit != INDEX_NONE ? uint64(1) << CategoryBit : 0;
+    return Fact;
+}
+
+void FRAIKnowledgeStore::RebuildMasks(FKnownActor& Known)
+{
+    Known.RelationMask = 0;
+    Known.CategoryMask = 0;
+    for (const FRelationshipFact& Fact : Known.Facts)
+    {
+        const int32 RelationBit = FindOrAddTagBit(Fact.Relation);
+        const int32 CategoryBit = FindOrAddTagBit(Fact.Category);
+        Known.RelationMask |= RelationBit != INDEX_NONE ? uint64(1) << RelationBit : 0;
+        Known.CategoryMask |= CategoryBit != INDEX_NONE ? uint64(1) << CategoryBit : 0;
+    }
+}
+
+// Bits are handed out in order of first use and never reclaimed, so masks stay valid as facts come and go
+int32 FRAIKnowledgeStore::FindOrAddTagBit(FGameplayTag Tag)
+{
+    if (const int32* Bit = TagBits.Find(Tag))
+    {
+        return *Bit;
+    }
+
+    const int32 Bit = NextTagBit < MaxIndexedTags ? NextTagBit++ : INDEX_NONE;
+    TagBits.Add(Tag, Bit);
+    return Bit;
+}
+
+//*************************************************************************
+//* Component
+//*************************************************************************
 
 // Constructor
 URAIKnowledgeComponent::URAIKnowledgeComponent()
 {
     PrimaryComponentTick.bCanEverTick = false;
-    // Initialization code here, if needed
+    SetIsReplicatedByDefault(true);
+    ReplicatedFacts.Owner = this;
 }
 
-// Checks if a specific relation exists for an actor
-bool URAIKnowledgeComponent::HasRelation(AActor* Actor, FGameplayTag Relation)
+URAIKnowledgeSubsystem* URAIKnowledgeComponent::GetKnowledgeSubsystem() const
 {
-    if (!Actor || !RelationshipFacts.Contains(Actor))
+    const UWorld* World = GetWorld();
+    return World ? World->GetSubsystem<URAIKnowledgeSubsystem>() : nullptr;
+}
+
+// Stops holding every known actor so the subsystem never calls back into a dead component
+void URAIKnowledgeComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem();
+    for (const TPair<TWeakObjectPtr<AActor>, FKnownActor>& Pair : Store.KnownActors)
+    {
+        if (AActor* Actor = Pair.Key.Get())
+        {
+            if (KnowledgeSubsystem)
+            {
+                KnowledgeSubsystem->RemoveIndexedActor(Actor, this);
+                for (const FRelationshipFact& Fact : Pair.Value.Facts)
+                {
+                    KnowledgeSubsystem->RemoveRegard(this, Actor, Fact.Relation);
+                }
+            }
+        }
+    }
+    Store.KnownActors.Empty();
+
+    if (SharedKnowledge)
+    {
+        if (KnowledgeSubsystem)
+        {
+            KnowledgeSubsystem->LeaveKnowledgeGroup(this, KnowledgeGroup);
+        }
+        SharedKnowledge.Reset();
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+const FRAIKnowledgeStore* URAIKnowledgeComponent::ResolveStore(const AActor* Actor, const FKnownActor*& OutKnown) const
+{
+    if ((OutKnown = Store.Find(Actor)))
+    {
+        return &Store;
+    }
+
+    if (SharedKnowledge && (OutKnown = SharedKnowledge->Store.Find(Actor)))
+    {
+        return &SharedKnowledge->Store;
+    }
+
+    return nullptr;
+}
+
+const URAIKnowledgeComponent::FKnownActor* URAIKnowledgeComponent::FindKnownActor(const AActor* Actor) const
+{
+    const FKnownActor* Known = nullptr;
+    ResolveStore(Actor, Known);
+    return Known;
+}
+
+URAIKnowledgeComponent::FKnownActor* URAIKnowledgeComponent::FindOwnKnownActor(AActor* Actor, bool Create)
+{
+    if (FKnownActor* Known = Store.Find(Actor))
+    {
+        return Known;
+    }
+
+    const FKnownActor* GroupKnown = SharedKnowledge ? SharedKnowledge->Store.Find(Actor) : nullptr;
+    if (!GroupKnown && !Create)
+    {
+        return nullptr;
+    }
+
+    FKnownActor& Known = Store.KnownActors.Add(Actor);
+    if (URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+    {
+        KnowledgeSubsystem->AddIndexedActor(Actor, this);
+    }
+
+    // Copy on write, the group's facts about the actor become own facts and keep their expiry time
+    if (GroupKnown)
+    {
+        for (const FRelationshipFact& GroupFact : GroupKnown->Facts)
+        {
+            FRelationshipFact& Fact = Store.Add(Known, GroupFact, NextFactId++);
+            Fact.ExpireTime = GroupFact.ExpireTime;
+            AddRegard(Actor, Fact);
+            ScheduleExpiry(Actor, Fact);
+            AddReplicatedFact(Actor, Fact);
+        }
+    }
+    return &Known;
+}
+
+void URAIKnowledgeComponent::ForgetActor(AActor* Actor)
+{
+    const FKnownActor* Known = Store.Find(Actor);
+    if (!Known)
+    {
+        return;
+    }
+
+    if (URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+    {
+        KnowledgeSubsystem->RemoveIndexedActor(Actor, this);
+        for (const FRelationshipFact& Fact : Known->Facts)
+        {
+            KnowledgeSubsystem->RemoveRegard(this, Actor, Fact.Relation);
+        }
+    }
+
+    Store.KnownActors.Remove(Actor);
+}
+
+void URAIKnowledgeComponent::AddRegard(AActor* Actor, const FRelationshipFact& Fact)
+{
+    if (URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+    {
+        KnowledgeSubsystem->AddRegard(this, Actor, Fact.Relation);
+    }
+}
+
+void URAIKnowledgeComponent::RemoveRegard(AActor* Actor, const FRelationshipFact& Fact)
+{
+    if (URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+    {
+        KnowledgeSubsystem->RemoveRegard(this, Actor, Fact.Relation);
+    }
+}
+
+void URAIKnowledgeComponent::OnFactsRemoved(AActor* Actor, FKnownActor& Known)
+{
+    // An empty entry still hides the group's facts about the actor
+    if (Known.Facts.IsEmpty() && !(SharedKnowledge && SharedKnowledge->Store.Find(Actor)))
+    {
+        ForgetActor(Actor);
+    }
+    else
+    {
+        Store.RebuildMasks(Known);
+    }
+}
+
+void URAIKnowledgeComponent::ScheduleExpiry(AActor* Actor, FRelationshipFact& Fact)
+{
+    if (Fact.ExpireTime > 0.0)
+    {
+        if (URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+        {
+            KnowledgeSubsystem->ScheduleExpiry(this, Actor, Fact.FactId, Fact.ExpireTime);
+        }
+    }
+}
+
+bool URAIKnowledgeComponent::ExpireFact(AActor* Actor, uint32 FactId)
+{
+    FKnownActor* Known = Store.Find(Actor);
+    if (!Known)
+    {
+        return false;
+    }
+
+    const int32 Index = Known->Facts.IndexOfByPredicate([FactId](const FRelationshipFact& Fact) { return Fact.FactId == FactId; });
+    if (Index == INDEX_NONE)
     {
         return false;
     }
 
-    for (const FRelationshipFact& Fact : RelationshipFacts[Actor])
+    RemoveReplicatedFact(FactId);
+    RemoveRegard(Actor, Known->Facts[Index]);
+
+    // Only copy the fact when someone listens
+    if (OnFactExpired.IsBound())
+    {
+        FRelationshipFact ExpiredFact = Known->Facts[Index];
+        ExpiredFact.RemainingDuration = 0.f;
+        Known->Facts.RemoveAt(Index);
+        OnFactsRemoved(Actor, *Known);
+        OnFactExpired.Broadcast(Actor, ExpiredFact);
+    }
+    else
+    {
+        Known->Facts.RemoveAt(Index);
+        OnFactsRemoved(Actor, *Known);
+    }
+    return true;
+}
+
+void URAIKnowledgeComponent::OnKnownActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+    if (GetOwner()->HasAuthority())
+    {
+        if (const FKnownActor* Known = Store.Find(Actor); Known && !ReplicatedFactIndices.IsEmpty())
+        {
+            for (const FRelationshipFact& Fact : Known->Facts)
+            {
+                RemoveReplicatedFact(Fact.FactId);
+            }
+        }
+    }
+    else
+    {
+        // On clients the actor may only have left relevancy, its facts are indexed again once the reference resolves
+        for (FRAIReplicatedFact& Item : ReplicatedFacts.Items)
+        {
+            Item.Indexed &= Item.Actor != Actor;
+        }
+    }
+
+    if (Store.Find(Actor))
     {
-        if (Fact.Relation == Relation)
+        ForgetActor(Actor);
+        OnKnowledgeChanged.Broadcast();
+    }
+}
+
+//*************************************************************************
+//* Groups
+//*************************************************************************
+
+void URAIKnowledgeComponent::SetKnowledgeGroup(FGameplayTag NewGroup)
+{
+    if (NewGroup == KnowledgeGroup || !GetOwner() || !GetOwner()->HasAuthority())
+    {
+        return;
+    }
+
+    if (!HasBegunPlay())
+    {
+        KnowledgeGroup = NewGroup;
+        return;
+    }
+
+    URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem();
+    if (KnowledgeSubsystem && SharedKnowledge)
+    {
+        KnowledgeSubsystem->LeaveKnowledgeGroup(this, KnowledgeGroup);
+    }
+    SharedKnowledge.Reset();
+
+    // Empty entries only existed to hide facts of the previous group
+    for (auto It = Store.KnownActors.CreateIterator(); It; ++It)
+    {
+        if (It->Value.Facts.IsEmpty())
         {
-            return true;
+            AActor* Actor = It->Key.Get();
+            if (Actor && KnowledgeSubsystem)
+            {
+                KnowledgeSubsystem->RemoveIndexedActor(Actor, this);
+            }
+            It.RemoveCurrent();
         }
     }
 
-    return false;
+    KnowledgeGroup = NewGroup;
+    if (KnowledgeSubsystem && KnowledgeGroup.IsValid())
+    {
+        SharedKnowledge = KnowledgeSubsystem->JoinKnowledgeGroup(this, KnowledgeGroup);
+    }
+    OnKnowledgeChanged.Broadcast();
 }
 
-// Retrieves all relations for a given actor
-TArray<FRelationshipFact> URAIKnowledgeComponent::GetAllRelations(AActor* Actor)
+void URAIKnowledgeComponent::RevertToGroupKnowledge(AActor* Actor)
 {
-    TArray<FRelationshipFact> Result;
-    if (Actor && RelationshipFacts.Contains(Actor))
+    if (!GetOwner() || !GetOwner()->HasAuthority())
     {
-        Result = RelationshipFacts[Actor];
+        return;
     }
-    return Result;
+
+    const FKnownActor* Known = Store.Find(Actor);
+    if (!Known)
+    {
+        return;
+    }
+
+    for (const FRelationshipFact& Fact : Known->Facts)
+    {
+        RemoveReplicatedFact(Fact.FactId);
+    }
+    ForgetActor(Actor);
+    OnKnowledgeChanged.Broadcast();
 }
 
-// Retrieves all relations of a specific category for a given actor
-TArray<FRelationshipFact> URAIKnowledgeComponent::GetAllRelationsOfCategory(AActor* Actor, FGameplayTag Category)
+//*************************************************************************
+//* Queries
+//*************************************************************************
+
+// Checks if a specific relation exists for an actor
+bool URAIKnowledgeComponent::HasRelation(const AActor* Actor, FGameplayTag Relation) const
 {
-    TArray<FRelationshipFact> Result;
-    if (!Actor || !RelationshipFacts.Contains(Actor))
+    const FKnownActor* Known = nullptr;
+    const FRAIKnowledgeStore* KnownIn = ResolveStore(Actor, Known);
+    return KnownIn && KnownIn->HasRelation(*Known, Relation);
+}
+
+bool URAIKnowledgeComponent::HasRelationOfCategory(const AActor* Actor, FGameplayTag Category) const
+{
+    const FKnownActor* Known = nullptr;
+    const FRAIKnowledgeStore* KnownIn = ResolveStore(Actor, Known);
+    return KnownIn && KnownIn->HasCategory(*Known, Category);
+}
+
+TArrayView<const FRelationshipFact> URAIKnowledgeComponent::GetRelationsView(const AActor* Actor) const
+{
+    const FKnownActor* Known = FindKnownActor(Actor);
+    return Known ? TArrayView<const FRelationshipFact>(Known->Facts) : TArrayView<const FRelationshipFact>();
+}
+
+void URAIKnowledgeComponent::GetRelationsOfCategory(const AActor* Actor, FGameplayTag Category, TArray<FRelationshipFact>& OutFacts) const
+{
+    OutFacts.Reset();
+
+    const FKnownActor* Known = nullptr;
+    const FRAIKnowledgeStore* KnownIn = ResolveStore(Actor, Known);
+    if (!KnownIn || !KnownIn->HasCategory(*Known, Category))
     {
-        return Result;
+        return;
     }
 
-    for (const FRelationshipFact& Fact : RelationshipFacts[Actor])
+    for (const FRelationshipFact& Fact : Known->Facts)
     {
         if (Fact.Category == Category)
         {
-            Result.Add(Fact);
+            OutFacts.Add(Fact);
         }
     }
+}
+
+void URAIKnowledgeComponent::GetKnownActors(TArray<AActor*>& OutActors) const
+{
+    OutActors.Reset(Store.KnownActors.Num());
+    for (const TPair<TWeakObjectPtr<AActor>, FKnownActor>& Pair : Store.KnownActors)
+    {
+        AActor* Actor = Pair.Key.Get();
+        if (Actor && !Pair.Value.Facts.IsEmpty())
+        {
+            OutActors.Add(Actor);
+        }
+    }
+
+    if (SharedKnowledge)
+    {
+        for (const TPair<TWeakObjectPtr<AActor>, FKnownActor>& Pair : SharedKnowledge->Store.KnownActors)
+        {
+            AActor* Actor = Pair.Key.Get();
+            if (Actor && !Store.KnownActors.Contains(Pair.Key))
+            {
+                OutActors.Add(Actor);
+            }
+        }
+    }
+}
+
+float URAIKnowledgeComponent::GetRemainingDuration(const FRelationshipFact& Fact) const
+{
+    if (Fact.ExpireTime <= 0.0)
+    {
+        return Fact.RemainingDuration;
+    }
+
+    const UWorld* World = GetWorld();
+    return World ? FMath::Max(static_cast<float>(Fact.ExpireTime - World->GetTimeSeconds()), 0.f) : Fact.RemainingDuration;
+}
 
+bool URAIKnowledgeComponent::MatchesQuery(const AActor* Actor, FGameplayTag Relation, FGameplayTag Category) const
+{
+    const FKnownActor* Known = nullptr;
+    const FRAIKnowledgeStore* KnownIn = ResolveStore(Actor, Known);
+    return KnownIn && !Known->Facts.IsEmpty()
+        && (!Relation.IsValid() || KnownIn->HasRelation(*Known, Relation))
+        && (!Category.IsValid() || KnownIn->HasCategory(*Known, Category));
+}
+
+void URAIKnowledgeComponent::QueryKnownActorsInRadius(const FVector& Origin, float Radius, FGameplayTag Relation, FGameplayTag Category, TArray<AActor*>& OutActors) const
+{
+    OutActors.Reset();
+    if (const URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+    {
+        KnowledgeSubsystem->GatherActorsInRadius(Origin, Radius, [this, Relation, Category](const AActor* Actor)
+        {
+            return MatchesQuery(Actor, Relation, Category);
+        }, OutActors);
+    }
+}
+
+void URAIKnowledgeComponent::QueryNearestKnownActors(const FVector& Origin, int32 Count, float MaxRadius, FGameplayTag Relation, FGameplayTag Category, TArray<AActor*>& OutActors) const
+{
+    OutActors.Reset();
+    if (const URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem())
+    {
+        KnowledgeSubsystem->GatherNearestActors(Origin, Count, MaxRadius, [this, Relation, Category](const AActor* Actor)
+        {
+            return MatchesQuery(Actor, Relation, Category);
+        }, OutActors);
+    }
+}
+
+TArray<AActor*> URAIKnowledgeComponent::FindKnownActorsInRadius(FVector Origin, float Radius, FGameplayTag Relation, FGameplayTag Category) const
+{
+    TArray<AActor*> Result;
+    QueryKnownActorsInRadius(Origin, Radius, Relation, Category, Result);
     return Result;
 }
 
+AActor* URAIKnowledgeComponent::FindNearestKnownActor(FVector Origin, FGameplayTag Relation, FGameplayTag Category, float MaxRadius) const
+{
+    TArray<AActor*> Nearest;
+    QueryNearestKnownActors(Origin, 1, MaxRadius, Relation, Category, Nearest);
+    return Nearest.Num() > 0 ? Nearest[0] : nullptr;
+}
+
+// Retrieves all relations for a given actor
+TArray<FRelationshipFact> URAIKnowledgeComponent::GetAllRelations(AActor* Actor)
+{
+    TArray<FRelationshipFact> Result(GetRelationsView(Actor));
+    for (FRelationshipFact& Fact : Result)
+    {
+        Fact.RemainingDuration = GetRemainingDuration(Fact);
+    }
+    return Result;
+}
+
+// Retrieves all relations of a specific category for a given actor
+TArray<FRelationshipFact> URAIKnowledgeComponent::GetAllRelationsOfCategory(AActor* Actor, FGameplayTag Category)
+{
+    TArray<FRelationshipFact> Result;
+    GetRelationsOfCategory(Actor, Category, Result);
+    for (FRelationshipFact& Fact : Result)
+    {
+        Fact.RemainingDuration = GetRemainingDuration(Fact);
+    }
+    return Result;
+}
+
+//*************************************************************************
+//* Changes
+//*************************************************************************
+
 // Adds a new relation for an actor
 void URAIKnowledgeComponent::AddRelation(AActor* Actor, const FRelationshipFact& RelationshipFact)
 {
@@ -68,7 +546,7 @@ void URAIKnowledgeComponent::AddRelation(AActor* Actor, const FRelationshipFact&
         if (GetOwner()->HasAuthority())
         {
             // Directly update on the server
-            AddRelationMulticast(Actor, RelationshipFact);
+            AddRelationAuthority(Actor, RelationshipFact);
         }
         else
         {
@@ -78,19 +556,53 @@ void URAIKnowledgeComponent::AddRelation(AActor* Actor, const FRelationshipFact&
     }
 }
 
-// Replicates the addition of a new relation to all clients
-void URAIKnowledgeComponent::AddRelationMulticast_Implementation(AActor* Actor, const FRelationshipFact& RelationshipFact)
+bool URAIKnowledgeComponent::UnindexFact(AActor* Actor, uint32 FactId)
 {
-    if (Actor)
+    FKnownActor* Known = Store.Find(Actor);
+    if (!Known)
     {
-        RelationshipFacts.FindOrAdd(Actor).Add(RelationshipFact);
+        return false;
     }
+
+    const int32 Index = Known->Facts.IndexOfByPredicate([FactId](const FRelationshipFact& Fact) { return Fact.FactId == FactId; });
+    if (Index == INDEX_NONE)
+    {
+        return false;
+    }
+
+    RemoveRegard(Actor, Known->Facts[Index]);
+    Known->Facts.RemoveAt(Index);
+    OnFactsRemoved(Actor, *Known);
+    return true;
+}
+
+void URAIKnowledgeComponent::AddRelationAuthority(AActor* Actor, const FRelationshipFact& RelationshipFact)
+{
+    if (!IsValid(Actor))
+    {
+        return;
+    }
+
+    FRelationshipFact& Fact = Store.Add(*FindOwnKnownActor(Actor, true), RelationshipFact, NextFactId++);
+    AddRegard(Actor, Fact);
+
+    // A positive RemainingDuration resumes a fact that was already partially used up
+    const float Duration = Fact.RemainingDuration > 0.f ? Fact.RemainingDuration : Fact.TotalDuration;
+    if (Duration > 0.f)
+    {
+        Fact.RemainingDuration = Duration;
+        Fact.ExpireTime = GetWorld()->GetTimeSeconds() + Duration;
+        ScheduleExpiry(Actor, Fact);
+    }
+
+    AddReplicatedFact(Actor, Fact);
+    OnKnowledgeChanged.Broadcast();
 }
 
 // Server RPC to add a new relation
 void URAIKnowledgeComponent::ServerAddRelation_Implementation(AActor* Actor, const FRelationshipFact& RelationshipFact)
 {
-    AddRelationMulticast(Actor, RelationshipFact);
+    AddRelationAuthority(Actor, RelationshipFact);
 }
 
 // Removes a specific relation for an actor
@@ -100,7 +612,7 @@ void URAIKnowledgeComponent::RemoveRelation(AActor* Actor, FGameplayTag Relation
     {
         if (GetOwner()->HasAuthority())
         {
-            RemoveRelationMulticast(Actor, Relation);
+            RemoveRelationAuthority(Actor, Relation);
         }
         else
         {
@@ -109,27 +621,26 @@ void URAIKnowledgeComponent::RemoveRelation(AActor* Actor, FGameplayTag Relation
     }
 }
 
-// Replicates the removal of a relation to all clients
-void URAIKnowledgeComponent::RemoveRelationMulticast_Implementation(AActor* Actor, FGameplayTag Relation)
+void URAIKnowledgeComponent::RemoveRelationAuthority(AActor* Actor, FGameplayTag Relation)
 {
-    if (Actor && RelationshipFacts.Contains(Actor))
+    if (!HasRelation(Actor, Relation))
     {
-        TArray<FRelationshipFact>& Facts = RelationshipFacts[Actor];
-        for (int32 Index = 0; Index < Facts.Num(); ++Index)
-        {
-            if (Facts[Index].Relation == Relation)
-            {
-                Facts.RemoveAt(Index);
-                break;
-            }
-        }
+        return;
     }
+
+    FKnownActor* Known = FindOwnKnownActor(Actor, false);
+    const int32 Index = Known->Facts.IndexOfByPredicate([Relation](const FRelationshipFact& Fact) { return Fact.Relation == Relation; });
+    RemoveReplicatedFact(Known->Facts[Index].FactId);
+    RemoveRegard(Actor, Known->Facts[Index]);
+    Known->Facts.RemoveAt(Index);
+    OnFactsRemoved(Actor, *Known);
+    OnKnowledgeChanged.Broadcast();
 }
 
 // Server RPC to remove a relation
 void URAIKnowledgeComponent::ServerRemoveRelation_Implementation(AActor* Actor, FGameplayTag Relation)
 {
-    RemoveRelationMulticast(Actor, Relation);
+    RemoveRelationAuthority(Actor, Relation);
 }
 
 // Removes all relations of a specific category for an actor
@@ -139,7 +650,7 @@ void URAIKnowledgeComponent::RemoveAllRelationsOfCategory(AActor* Actor, FGamepl
     {
         if (GetOwner()->HasAuthority())
         {
-            RemoveAllRelationsOfCategoryMulticast(Actor, Category);
+            RemoveAllRelationsOfCategoryAuthority(Actor, Category);
         }
         else
         {
@@ -148,24 +659,214 @@ void URAIKnowledgeComponent::RemoveAllRelationsOfCategory(AActor* Actor, FGamepl
     }
 }
 
-// Replicates the removal of all relations of a category to all clients
-void URAIKnowledgeComponent::RemoveAllRelationsOfCategoryMulticast_Implementation(AActor* Actor, FGameplayTag Category)
+void URAIKnowledgeComponent::RemoveAllRelationsOfCategoryAuthority(AActor* Actor, FGameplayTag Category)
 {
-    if (Actor && RelationshipFacts.Contains(Actor))
+    if (!HasRelationOfCategory(Actor, Category))
+    {
+        return;
+    }
+
+    FKnownActor* Known = FindOwnKnownActor(Actor, false);
+    Known->Facts.RemoveAll([this, Actor, Category](const FRelationshipFact& Fact)
     {
-        TArray<FRelationshipFact>& Facts = RelationshipFacts[Actor];
-        for (int32 Index = Facts.Num() - 1; Index >= 0; --Index)
+        if (Fact.Category != Category)
         {
-            if (Facts[Index].Category == Category)
+            return false;
+        }
+        RemoveReplicatedFact(Fact.FactId);
+        RemoveRegard(Actor, Fact);
+        return true;
+    });
+
+    OnFactsRemoved(Actor, *Known);
+    OnKnowledgeChanged.Broadcast();
+}
+
+// Server RPC to remove all relations of a category
+void URAIKnowledgeComponent::ServerRemoveAllRelationsOfCategory_Implementation(AActor* Actor, FGameplayTag Category)
+{
+    RemoveAllRelationsOfCategoryAuthority(Actor, Category);
+}
+
+//*************************************************************************
+//* Replication
+//*************************************************************************
+
+void URAIKnowledgeComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    FDoRepLifetimeParams Params;
+    Params.Condition = COND_Dynamic;
+    Params.bIsPushBased = false;
+    DOREPLIFETIME_WITH_PARAMS_FAST(URAIKnowledgeComponent, ReplicatedFacts, Params);
+}
+
+void URAIKnowledgeComponent::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (GetOwner()->HasAuthority())
+    {
+        DOREPDYNAMICCONDITION_SETCONDITION_FAST(URAIKnowledgeComponent, ReplicatedFacts, GetReplicationCondition());
+
+        URAIKnowledgeSubsystem* KnowledgeSubsystem = GetKnowledgeSubsystem();
+        if (KnowledgeSubsystem && KnowledgeGroup.IsValid())
+        {
+            SharedKnowledge = KnowledgeSubsystem->JoinKnowledgeGroup(this, KnowledgeGroup);
+        }
+    }
+}
+
+ELifetimeCondition URAIKnowledgeComponent::GetReplicationCondition() const
+{
+    switch (Replication)
+    {
+    case ERAIKnowledgeReplication::OwnerOnly:
+        return COND_OwnerOnly;
+    case ERAIKnowledgeReplication::Relevancy:
+        return COND_None;
+    default:
+        return COND_Never;
+    }
+}
+
+void URAIKnowledgeComponent::SetKnowledgeReplication(ERAIKnowledgeReplication NewReplication)
+{
+    if (NewReplication == Replication || !GetOwner() || !GetOwner()->HasAuthority())
+    {
+        return;
+    }
+
+    const bool WasReplicating = Replication != ERAIKnowledgeReplication::Disabled;
+    Replication = NewReplication;
+    if (HasBegunPlay())
+    {
+        DOREPDYNAMICCONDITION_SETCONDITION_FAST(URAIKnowledgeComponent, ReplicatedFacts, GetReplicationCondition());
+    }
+
+    // The replicated array is only maintained while replicating, so it is rebuilt from the index when turned back on
+    if (Replication == ERAIKnowledgeReplication::Disabled)
+    {
+        ReplicatedFacts.Items.Reset();
+        ReplicatedFactIndices.Reset();
+        ReplicatedFacts.MarkArrayDirty();
+    }
+    else if (!WasReplicating)
+    {
+        for (const TPair<TWeakObjectPtr<AActor>, FKnownActor>& Pair : Store.KnownActors)
+        {
+            if (AActor* Actor = Pair.Key.Get())
             {
-                Facts.RemoveAt(Index);
+                for (const FRelationshipFact& Fact : Pair.Value.Facts)
+                {
+                    AddReplicatedFact(Actor, Fact);
+                }
             }
         }
     }
 }
 
-// Server RPC to remove all relations of a category
-void URAIKnowledgeComponent::ServerRemoveAllRelationsOfCategory_Implementation(AActor* Actor, FGameplayTag Category)
+void URAIKnowledgeComponent::AddReplicatedFact(AActor* Actor, const FRelationshipFact& Fact)
+{
+    if (Replication == ERAIKnowledgeReplication::Disabled)
+    {
+        return;
+    }
+
+    FRAIReplicatedFact& Item = ReplicatedFacts.Items.AddDefaulted_GetRef();
+    Item.Actor = Actor;
+    Item.Fact = Fact;
+    Item.FactId = Fact.FactId;
+    ReplicatedFactIndices.Add(Fact.FactId, ReplicatedFacts.Items.Num() - 1);
+    ReplicatedFacts.MarkItemDirty(Item);
+}
+
+void URAIKnowledgeComponent::RemoveReplicatedFact(uint32 FactId)
+{
+    int32 Index = INDEX_NONE;
+    if (!ReplicatedFactIndices.RemoveAndCopyValue(FactId, Index))
+    {
+        return;
+    }
+
+    // Items are identified by their replication id, so their order does not matter to clients
+    TArray<FRAIReplicatedFact>& Items = ReplicatedFacts.Items;
+    Items.RemoveAtSwap(Index, EAllowShrinking::No);
+    if (Items.IsValidIndex(Index))
+    {
+        ReplicatedFactIndices.Add(Items[Index].FactId, Index);
+    }
+    ReplicatedFacts.MarkArrayDirty();
+}
+
+void URAIKnowledgeComponent::OnReplicatedFactAdded(FRAIReplicatedFact& Item)
+{
+    // Facts about actors not relevant to this client are indexed once the reference resolves, see OnReplicatedFactChanged
+    AActor* Actor = Item.Actor;
+    if (Item.Indexed || !IsValid(Actor))
+    {
+        return;
+    }
+
+    FRelationshipFact& Fact = Store.Add(*FindOwnKnownActor(Actor, true), Item.Fact, Item.FactId);
+    AddRegard(Actor, Fact);
+    if (const UWorld* World = GetWorld(); World && Fact.RemainingDuration > 0.f)
+    {
+        // Expiry is driven by the server, this only serves GetRemainingDuration
+        Fact.ExpireTime = World->GetTimeSeconds() + Fact.RemainingDuration;
+    }
+    Item.Indexed = true;
+    ReplicatedKnowledgeChanged = true;
+}
+
+void URAIKnowledgeComponent::OnReplicatedFactRemoved(const FRAIReplicatedFact& Item)
+{
+    if (Item.Indexed && UnindexFact(Item.Actor, Item.FactId))
+    {
+        ReplicatedKnowledgeChanged = true;
+    }
+}
+
+void URAIKnowledgeComponent::OnReplicatedFactsReceived()
 {
-    RemoveAllRelationsOfCategoryMulticast(Actor, Category);
+    // One broadcast per received batch rather than per fact
+    if (ReplicatedKnowledgeChanged)
+    {
+        ReplicatedKnowledgeChanged = false;
+        OnKnowledgeChanged.Broadcast();
+    }
+}
+
+void FRAIReplicatedFact::PostReplicatedAdd(const FRAIReplicatedFacts& InArraySerializer)
+{
+    if (InArraySerializer.Owner)
+    {
+        InArraySerializer.Owner->OnReplicatedFactAdded(*this);
+    }
+}
+
+void FRAIReplicatedFact::PostReplicatedChange(const FRAIReplicatedFacts& InArraySerializer)
+{
+    // Facts never change in place, this is called when the actor reference of an added fact was resolved late
+    if (InArraySerializer.Owner)
+    {
+        InArraySerializer.Owner->OnReplicatedFactAdded(*this);
+    }
+}
+
+void FRAIReplicatedFact::PreReplicatedRemove(const FRAIReplicatedFacts& InArraySerializer)
+{
+    if (InArraySerializer.Owner)
+    {
+        InArraySerializer.Owner->OnReplicatedFactRemoved(*this);
+    }
+}
+
+void FRAIReplicatedFacts::PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters)
+{
+    if (Owner)
+    {
+        Owner->OnReplicatedFactsReceived();
+    }
 }
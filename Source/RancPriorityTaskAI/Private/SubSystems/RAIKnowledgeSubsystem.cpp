@@ -0,0 +1,781 @@
+// Copyright Rancorous Games, 2024
+
+#include "SubSystems/RAIKnowledgeSubsystem.h"
+
+#include "RAIStats.h"
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "UObject/UObjectGlobals.h"
+
+void URAIKnowledgeSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	StepSeconds = FMath::Max(ExpiryResolution, 0.01f);
+	CurrentStep = 0;
+	CellSize = FMath::Max(SpatialCellSize, 100.f);
+	PostGarbageCollectHandle = FCoreUObjectDelegates::GetPostGarbageCollect().AddUObject(this, &URAIKnowledgeSubsystem::RemoveCollectedActors);
+}
+
+void URAIKnowledgeSubsystem::Deinitialize()
+{
+	FCoreUObjectDelegates::GetPostGarbageCollect().Remove(PostGarbageCollectHandle);
+	for (const TPair<TWeakObjectPtr<AActor>, FIndexedActor>& Pair : IndexedActors)
+	{
+		if (USceneComponent* Root = Pair.Value.Root.Get())
+		{
+			Root->TransformUpdated.Remove(Pair.Value.MovedHandle);
+		}
+	}
+	IndexedActors.Empty();
+	Cells.Empty();
+
+	Super::Deinitialize();
+}
+
+void URAIKnowledgeSubsystem::ScheduleExpiry(URAIKnowledgeComponent* Knowledge, AActor* Actor, uint32 FactId, double ExpireTime)
+{
+	if (!Knowledge || !Actor)
+	{
+		return;
+	}
+
+	FExpiryEntry Entry;
+	Entry.Knowledge = Knowledge;
+	Entry.Actor = Actor;
+	Entry.FactId = FactId;
+	ScheduleEntry(MoveTemp(Entry), ExpireTime);
+}
+
+void URAIKnowledgeSubsystem::ScheduleEntry(FExpiryEntry&& Entry, double ExpireTime)
+{
+	// Round up so a fact never expires before its duration has passed
+	Entry.DueStep = static_cast<uint64>(FMath::Max(FMath::CeilToDouble(ExpireTime / StepSeconds), 0.0));
+	InsertEntry(MoveTemp(Entry));
+	ScheduledExpiryCount++;
+}
+
+void URAIKnowledgeSubsystem::InsertEntry(FExpiryEntry&& Entry)
+{
+	// The slot of the current step has already been processed
+	const uint64 Step = FMath::Max(Entry.DueStep, CurrentStep + 1);
+	const uint64 Delta = Step - CurrentStep;
+
+	int32 Level = 0;
+	while (Level < WheelLevels - 1 && Delta >= (uint64(1) << (SlotBits * (Level + 1))))
+	{
+		Level++;
+	}
+
+	// Beyond the range of the wheel the entry is parked in the furthest top level slot and inserted again when that slot cascades
+	const uint64 SlotStep = FMath::Min(Step, CurrentStep + (uint64(1) << (SlotBits * WheelLevels)) - 1);
+	const int32 Slot = static_cast<int32>((SlotStep >> (SlotBits * Level)) & (SlotsPerLevel - 1));
+	Slots[Level * SlotsPerLevel + Slot].Add(MoveTemp(Entry));
+}
+
+void URAIKnowledgeSubsystem::AdvanceStep()
+{
+	CurrentStep++;
+
+	// Cascade from the highest level whose slot boundary was crossed, so entries moved down can cascade again in the same step
+	for (int32 Level = WheelLevels - 1; Level > 0; --Level)
+	{
+		if ((CurrentStep & ((uint64(1) << (SlotBits * Level)) - 1)) != 0)
+		{
+			continue;
+		}
+
+		const int32 Slot = static_cast<int32>((CurrentStep >> (SlotBits * Level)) & (SlotsPerLevel - 1));
+		Swap(CascadeScratch, Slots[Level * SlotsPerLevel + Slot]);
+		for (FExpiryEntry& Entry : CascadeScratch)
+		{
+			if (Entry.DueStep <= CurrentStep)
+			{
+				DueEntries.Add(MoveTemp(Entry));
+			}
+			else
+			{
+				InsertEntry(MoveTemp(Entry));
+			}
+		}
+		CascadeScratch.Reset();
+	}
+
+	TArray<FExpiryEntry>& Slot = Slots[CurrentStep & (SlotsPerLevel - 1)];
+	DueEntries.Append(MoveTemp(Slot));
+	Slot.Reset();
+}
+
+void URAIKnowledgeSubsystem::ExpireDueEntries()
+{
+	ScheduledExpiryCount -= DueEntries.Num();
+
+	for (const FExpiryEntry& Entry : DueEntries)
+	{
+		if (const TSharedPtr<FRAISharedKnowledge> SharedKnowledge = Entry.SharedKnowledge.Pin())
+		{
+			if (ExpireGroupFact(*SharedKnowledge, Entry.Actor.Get(), Entry.FactId))
+			{
+				FactsExpiredLastFrame++;
+				if (!SharedKnowledge->ExpiryBroadcastPending)
+				{
+					SharedKnowledge->ExpiryBroadcastPending = true;
+					ChangedGroups.Add(SharedKnowledge.Get());
+				}
+			}
+			continue;
+		}
+
+		URAIKnowledgeComponent* Knowledge = Entry.Knowledge.Get();
+		if (!Knowledge || !Knowledge->ExpireFact(Entry.Actor.Get(), Entry.FactId))
+		{
+			continue;
+		}
+
+		FactsExpiredLastFrame++;
+		if (!Knowledge->ExpiryBroadcastPending)
+		{
+			Knowledge->ExpiryBroadcastPending = true;
+			ChangedKnowledge.Add(Knowledge);
+		}
+	}
+	DueEntries.Reset();
+
+	for (URAIKnowledgeComponent* Knowledge : ChangedKnowledge)
+	{
+		Knowledge->ExpiryBroadcastPending = false;
+		Knowledge->OnKnowledgeChanged.Broadcast();
+	}
+	ChangedKnowledge.Reset();
+
+	// Groups are still referenced by KnowledgeGroups, expiry never removes a group
+	for (FRAISharedKnowledge* SharedKnowledge : ChangedGroups)
+	{
+		SharedKnowledge->ExpiryBroadcastPending = false;
+		BroadcastGroupChanged(*SharedKnowledge);
+	}
+	ChangedGroups.Reset();
+}
+
+void URAIKnowledgeSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	ActorsMovedLastFrame = ActorsMovedThisFrame;
+	ActorsMovedThisFrame = 0;
+
+	FactsExpiredLastFrame = 0;
+	const uint64 TargetStep = static_cast<uint64>(FMath::Max(GetWorld()->GetTimeSeconds() / StepSeconds, 0.0));
+	if (ScheduledExpiryCount == 0)
+	{
+		CurrentStep = FMath::Max(CurrentStep, TargetStep);
+		return;
+	}
+
+	while (CurrentStep < TargetStep)
+	{
+		AdvanceStep();
+	}
+
+	if (DueEntries.Num() > 0)
+	{
+		ExpireDueEntries();
+		RAI_COUNT(FactsExpired, FactsExpiredLastFrame);
+	}
+}
+
+//*************************************************************************
+//* Knowledge groups
+//*************************************************************************
+
+FRAISharedKnowledge& URAIKnowledgeSubsystem::FindOrAddGroup(FGameplayTag Group)
+{
+	TSharedPtr<FRAISharedKnowledge>& SharedKnowledge = KnowledgeGroups.FindOrAdd(Group);
+	if (!SharedKnowledge)
+	{
+		SharedKnowledge = MakeShared<FRAISharedKnowledge>();
+		SharedKnowledge->Group = Group;
+	}
+	return *SharedKnowledge;
+}
+
+TSharedPtr<FRAISharedKnowledge> URAIKnowledgeSubsystem::JoinKnowledgeGroup(URAIKnowledgeComponent* Knowledge, FGameplayTag Group)
+{
+	if (!Knowledge || !Group.IsValid())
+	{
+		return nullptr;
+	}
+
+	FindOrAddGroup(Group).Members.AddUnique(Knowledge);
+	return KnowledgeGroups[Group];
+}
+
+void URAIKnowledgeSubsystem::LeaveKnowledgeGroup(URAIKnowledgeComponent* Knowledge, FGameplayTag Group)
+{
+	if (const TSharedPtr<FRAISharedKnowledge>* SharedKnowledge = KnowledgeGroups.Find(Group))
+	{
+		(*SharedKnowledge)->Members.RemoveSwap(Knowledge);
+	}
+}
+
+const FRAIKnowledgeStore* URAIKnowledgeSubsystem::GetGroupKnowledge(FGameplayTag Group) const
+{
+	const TSharedPtr<FRAISharedKnowledge>* SharedKnowledge = KnowledgeGroups.Find(Group);
+	return SharedKnowledge ? &(*SharedKnowledge)->Store : nullptr;
+}
+
+bool URAIKnowledgeSubsystem::HasGroupRelation(FGameplayTag Group, const AActor* Actor, FGameplayTag Relation) const
+{
+	const FRAIKnowledgeStore* Store = GetGroupKnowledge(Group);
+	const FRAIKnowledgeStore::FKnownActor* Known = Store ? Store->Find(Actor) : nullptr;
+	return Known && Store->HasRelation(*Known, Relation);
+}
+
+void URAIKnowledgeSubsystem::AddGroupRelation(FGameplayTag Group, AActor* Actor, const FRelationshipFact& RelationshipFact)
+{
+	if (!IsValid(Actor) || !Group.IsValid())
+	{
+		return;
+	}
+
+	FRAISharedKnowledge& SharedKnowledge = FindOrAddGroup(Group);
+	FRAIKnowledgeStore::FKnownActor* Known = SharedKnowledge.Store.Find(Actor);
+	if (!Known)
+	{
+		Known = &SharedKnowledge.Store.KnownActors.Add(Actor);
+		AddIndexedActor(Actor);
+	}
+
+	FRelationshipFact& Fact = SharedKnowledge.Store.Add(*Known, RelationshipFact, SharedKnowledge.NextFactId++);
+	AddGroupRegard(SharedKnowledge, Actor, Fact.Relation);
+	const float Duration = Fact.RemainingDuration > 0.f ? Fact.RemainingDuration : Fact.TotalDuration;
+	if (Duration > 0.f)
+	{
+		Fact.RemainingDuration = Duration;
+		Fact.ExpireTime = GetWorld()->GetTimeSeconds() + Duration;
+
+		FExpiryEntry Entry;
+		Entry.SharedKnowledge = KnowledgeGroups[Group];
+		Entry.Actor = Actor;
+		Entry.FactId = Fact.FactId;
+		ScheduleEntry(MoveTemp(Entry), Fact.ExpireTime);
+	}
+
+	BroadcastGroupChanged(SharedKnowledge);
+}
+
+void URAIKnowledgeSubsystem::RemoveGroupRelation(FGameplayTag Group, AActor* Actor, FGameplayTag Relation)
+{
+	const TSharedPtr<FRAISharedKnowledge>* SharedKnowledge = KnowledgeGroups.Find(Group);
+	FRAIKnowledgeStore::FKnownActor* Known = SharedKnowledge ? (*SharedKnowledge)->Store.Find(Actor) : nullptr;
+	if (!Known)
+	{
+		return;
+	}
+
+	const int32 Index = Known->Facts.IndexOfByPredicate([Relation](const FRelationshipFact& Fact) { return Fact.Relation == Relation; });
+	if (Index != INDEX_NONE)
+	{
+		RemoveGroupRegard(**SharedKnowledge, Actor, Relation);
+		Known->Facts.RemoveAt(Index);
+		OnGroupFactsRemoved(**SharedKnowledge, Actor, *Known);
+		BroadcastGroupChanged(**SharedKnowledge);
+	}
+}
+
+void URAIKnowledgeSubsystem::RemoveAllGroupRelationsOfCategory(FGameplayTag Group, AActor* Actor, FGameplayTag Category)
+{
+	const TSharedPtr<FRAISharedKnowledge>* SharedKnowledge = KnowledgeGroups.Find(Group);
+	FRAIKnowledgeStore::FKnownActor* Known = SharedKnowledge ? (*SharedKnowledge)->Store.Find(Actor) : nullptr;
+	if (!Known)
+	{
+		return;
+	}
+
+	FRAISharedKnowledge& Shared = **SharedKnowledge;
+	const int32 NumRemoved = Known->Facts.RemoveAll([this, &Shared, Actor, Category](const FRelationshipFact& Fact)
+	{
+		if (Fact.Category != Category)
+		{
+			return false;
+		}
+		RemoveGroupRegard(Shared, Actor, Fact.Relation);
+		return true;
+	});
+	if (NumRemoved > 0)
+	{
+		OnGroupFactsRemoved(**SharedKnowledge, Actor, *Known);
+		BroadcastGroupChanged(**SharedKnowledge);
+	}
+}
+
+bool URAIKnowledgeSubsystem::ExpireGroupFact(FRAISharedKnowledge& SharedKnowledge, AActor* Actor, uint32 FactId)
+{
+	FRAIKnowledgeStore::FKnownActor* Known = SharedKnowledge.Store.Find(Actor);
+	const int32 Index = Known ? Known->Facts.IndexOfByPredicate([FactId](const FRelationshipFact& Fact) { return Fact.FactId == FactId; }) : INDEX_NONE;
+	if (Index == INDEX_NONE)
+	{
+		return false;
+	}
+
+	RemoveGroupRegard(SharedKnowledge, Actor, Known->Facts[Index].Relation);
+	Known->Facts.RemoveAt(Index);
+	OnGroupFactsRemoved(SharedKnowledge, Actor, *Known);
+	return true;
+}
+
+void URAIKnowledgeSubsystem::OnGroupFactsRemoved(FRAISharedKnowledge& SharedKnowledge, AActor* Actor, FRAIKnowledgeStore::FKnownActor& Known)
+{
+	if (Known.Facts.IsEmpty())
+	{
+		SharedKnowledge.Store.KnownActors.Remove(Actor);
+		RemoveIndexedActor(Actor);
+
+		// Empty own entries of the members only hid the facts just removed
+		for (const TWeakObjectPtr<URAIKnowledgeComponent>& Member : SharedKnowledge.Members)
+		{
+			if (URAIKnowledgeComponent* Knowledge = Member.Get())
+			{
+				if (const FRAIKnowledgeStore::FKnownActor* MemberKnown = Knowledge->Store.Find(Actor); MemberKnown && MemberKnown->Facts.IsEmpty())
+				{
+					Knowledge->ForgetActor(Actor);
+				}
+			}
+		}
+	}
+	else
+	{
+		SharedKnowledge.Store.RebuildMasks(Known);
+	}
+}
+
+void URAIKnowledgeSubsystem::BroadcastGroupChanged(FRAISharedKnowledge& SharedKnowledge)
+{
+	SharedKnowledge.Members.RemoveAllSwap([](const TWeakObjectPtr<URAIKnowledgeComponent>& Member) { return !Member.IsValid(); });
+	for (const TWeakObjectPtr<URAIKnowledgeComponent>& Member : SharedKnowledge.Members)
+	{
+		Member->OnKnowledgeChanged.Broadcast();
+	}
+}
+
+void URAIKnowledgeSubsystem::RemoveActorFromGroups(AActor* Actor)
+{
+	for (const TPair<FGameplayTag, TSharedPtr<FRAISharedKnowledge>>& Pair : KnowledgeGroups)
+	{
+		if (const FRAIKnowledgeStore::FKnownActor* Known = Pair.Value->Store.Find(Actor))
+		{
+			for (const FRelationshipFact& Fact : Known->Facts)
+			{
+				RemoveGroupRegard(*Pair.Value, Actor, Fact.Relation);
+			}
+			Pair.Value->Store.KnownActors.Remove(Actor);
+			RemoveIndexedActor(Actor);
+			BroadcastGroupChanged(*Pair.Value);
+		}
+	}
+}
+
+//*************************************************************************
+//* Spatial index
+//*************************************************************************
+
+FIntPoint URAIKnowledgeSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize));
+}
+
+void URAIKnowledgeSubsystem::AddIndexedActor(AActor* Actor, URAIKnowledgeComponent* Holder)
+{
+	FIndexedActor& Indexed = IndexedActors.FindOrAdd(Actor);
+	if (Indexed.References++ == 0)
+	{
+		Indexed.Cell = GetCell(Actor->GetActorLocation());
+		Cells.FindOrAdd(Indexed.Cell).Add(Actor);
+
+		// Actors without a root component have no location to move
+		if (USceneComponent* Root = Actor->GetRootComponent())
+		{
+			Indexed.Root = Root;
+			Indexed.MovedHandle = Root->TransformUpdated.AddUObject(this, &URAIKnowledgeSubsystem::OnIndexedComponentMoved);
+		}
+
+		// One binding per actor however many components know it, binding each of them made learning about a popular actor quadratic
+		Actor->OnEndPlay.AddDynamic(this, &URAIKnowledgeSubsystem::OnIndexedActorEndPlay);
+	}
+
+	if (Holder)
+	{
+		Indexed.Holders.Add(Holder);
+	}
+}
+
+void URAIKnowledgeSubsystem::RemoveIndexedActor(AActor* Actor, URAIKnowledgeComponent* Holder)
+{
+	FIndexedActor* Indexed = IndexedActors.Find(Actor);
+	if (!Indexed)
+	{
+		return;
+	}
+
+	if (Holder)
+	{
+		Indexed->Holders.Remove(Holder);
+	}
+
+	if (--Indexed->References > 0)
+	{
+		return;
+	}
+
+	if (TArray<TWeakObjectPtr<AActor>>* CellActors = Cells.Find(Indexed->Cell))
+	{
+		CellActors->RemoveSingleSwap(Actor, EAllowShrinking::No);
+	}
+	if (USceneComponent* Root = Indexed->Root.Get())
+	{
+		Root->TransformUpdated.Remove(Indexed->MovedHandle);
+	}
+	Actor->OnEndPlay.RemoveDynamic(this, &URAIKnowledgeSubsystem::OnIndexedActorEndPlay);
+	IndexedActors.Remove(Actor);
+}
+
+// Covers destruction as well as streaming out, the weak keys would otherwise linger until the next removal
+void URAIKnowledgeSubsystem::OnIndexedActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason)
+{
+	const FIndexedActor* Indexed = IndexedActors.Find(Actor);
+	if (!Indexed)
+	{
+		return;
+	}
+
+	// Each holder forgetting the actor removes itself from Holders
+	const TArray<TWeakObjectPtr<URAIKnowledgeComponent>> Holders = Indexed->Holders.Array();
+
+	RemoveActorFromGroups(Actor);
+	for (const TWeakObjectPtr<URAIKnowledgeComponent>& Holder : Holders)
+	{
+		if (URAIKnowledgeComponent* Knowledge = Holder.Get())
+		{
+			Knowledge->OnKnownActorEndPlay(Actor, EndPlayReason);
+		}
+	}
+}
+
+// Moves the actor if it crossed a cell border. Empty cells are kept, actors tend to come back to the same places
+void URAIKnowledgeSubsystem::OnIndexedComponentMoved(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	AActor* Actor = Component->GetOwner();
+	FIndexedActor* Indexed = IndexedActors.Find(Actor);
+	if (!Indexed)
+	{
+		return;
+	}
+
+	const FIntPoint Cell = GetCell(Component->GetComponentLocation());
+	if (Cell == Indexed->Cell)
+	{
+		return;
+	}
+
+	Cells.FindChecked(Indexed->Cell).RemoveSingleSwap(Actor, EAllowShrinking::No);
+	Cells.FindOrAdd(Cell).Add(Actor);
+	Indexed->Cell = Cell;
+	ActorsMovedThisFrame++;
+}
+
+// Actors normally leave the index when they end play, this only catches actors collected without doing so
+void URAIKnowledgeSubsystem::RemoveCollectedActors()
+{
+	TSet<URAIKnowledgeComponent*> Holders;
+	bool RemovedAny = false;
+	for (auto It = IndexedActors.CreateIterator(); It; ++It)
+	{
+		if (!It->Key.IsValid())
+		{
+			Cells.FindChecked(It->Value.Cell).RemoveSingleSwap(It->Key, EAllowShrinking::No);
+			for (const TWeakObjectPtr<URAIKnowledgeComponent>& Holder : It->Value.Holders)
+			{
+				if (URAIKnowledgeComponent* Knowledge = Holder.Get())
+				{
+					Holders.Add(Knowledge);
+				}
+			}
+			It.RemoveCurrent();
+			RemovedAny = true;
+		}
+	}
+
+	if (!RemovedAny)
+	{
+		return;
+	}
+
+	// The collected actors can no longer be looked up by pointer, so sweep every entry whose actor is gone
+	auto RemoveCollectedEntries = [](FRAIKnowledgeStore& Store)
+	{
+		for (auto It = Store.KnownActors.CreateIterator(); It; ++It)
+		{
+			if (!It->Key.IsValid())
+			{
+				It.RemoveCurrent();
+			}
+		}
+	};
+
+	for (URAIKnowledgeComponent* Knowledge : Holders)
+	{
+		RemoveCollectedEntries(Knowledge->Store);
+	}
+	for (const TPair<FGameplayTag, TSharedPtr<FRAISharedKnowledge>>& Pair : KnowledgeGroups)
+	{
+		RemoveCollectedEntries(Pair.Value->Store);
+	}
+	for (auto It = Regards.CreateIterator(); It; ++It)
+	{
+		if (!It->Key.Target.ResolveObjectPtr())
+		{
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void URAIKnowledgeSubsystem::GatherActorsInRadius(const FVector& Origin, float Radius, TFunctionRef<bool(const AActor*)> Filter, TArray<AActor*>& OutActors) const
+{
+	const double RadiusSquared = FMath::Square(Radius);
+	const FIntPoint Min = GetCell(Origin - FVector(Radius));
+	const FIntPoint Max = GetCell(Origin + FVector(Radius));
+
+	auto GatherCell = [&](const TArray<TWeakObjectPtr<AActor>>& CellActors)
+	{
+		for (const TWeakObjectPtr<AActor>& WeakActor : CellActors)
+		{
+			AActor* Actor = WeakActor.Get();
+			if (Actor && FVector::DistSquared(Actor->GetActorLocation(), Origin) <= RadiusSquared && Filter(Actor))
+			{
+				OutActors.Add(Actor);
+			}
+		}
+	};
+
+	// A radius spanning more cells than exist is cheaper to answer by walking the existing cells
+	const int64 CellSpan = int64(Max.X - Min.X + 1) * int64(Max.Y - Min.Y + 1);
+	if (CellSpan > Cells.Num())
+	{
+		for (const TPair<FIntPoint, TArray<TWeakObjectPtr<AActor>>>& Pair : Cells)
+		{
+			if (Pair.Key.X >= Min.X && Pair.Key.X <= Max.X && Pair.Key.Y >= Min.Y && Pair.Key.Y <= Max.Y)
+			{
+				GatherCell(Pair.Value);
+			}
+		}
+		return;
+	}
+
+	for (int32 X = Min.X; X <= Max.X; ++X)
+	{
+		for (int32 Y = Min.Y; Y <= Max.Y; ++Y)
+		{
+			if (const TArray<TWeakObjectPtr<AActor>>* CellActors = Cells.Find(FIntPoint(X, Y)))
+			{
+				GatherCell(*CellActors);
+			}
+		}
+	}
+}
+
+// Searches rings of cells around the origin until no closer actor can exist
+void URAIKnowledgeSubsystem::GatherNearestActors(const FVector& Origin, int32 Count, float MaxRadius, TFunctionRef<bool(const AActor*)> Filter, TArray<AActor*>& OutActors) const
+{
+	OutActors.Reset();
+	if (Count <= 0 || IndexedActors.IsEmpty())
+	{
+		return;
+	}
+
+	const double MaxDistanceSquared = MaxRadius > 0.f ? FMath::Square(MaxRadius) : TNumericLimits<double>::Max();
+	// Sorted by distance, nearest first
+	TArray<TPair<double, AActor*>, TInlineAllocator<16>> Nearest;
+	int32 ActorsVisited = 0;
+
+	auto VisitCell = [&](const TArray<TWeakObjectPtr<AActor>>& CellActors)
+	{
+		ActorsVisited += CellActors.Num();
+		for (const TWeakObjectPtr<AActor>& WeakActor : CellActors)
+		{
+			AActor* Actor = WeakActor.Get();
+			if (!Actor)
+			{
+				continue;
+			}
+
+			const double DistanceSquared = FVector::DistSquared(Actor->GetActorLocation(), Origin);
+			if (DistanceSquared > MaxDistanceSquared || (Nearest.Num() == Count && DistanceSquared >= Nearest.Last().Key) || !Filter(Actor))
+			{
+				continue;
+			}
+
+			int32 Index = Nearest.Num();
+			while (Index > 0 && Nearest[Index - 1].Key > DistanceSquared)
+			{
+				Index--;
+			}
+			Nearest.Insert(TPair<double, AActor*>(DistanceSquared, Actor), Index);
+			if (Nearest.Num() > Count)
+			{
+				Nearest.Pop(EAllowShrinking::No);
+			}
+		}
+	};
+
+	auto VisitCellAt = [&](int32 X, int32 Y)
+	{
+		if (const TArray<TWeakObjectPtr<AActor>>* CellActors = Cells.Find(FIntPoint(X, Y)))
+		{
+			VisitCell(*CellActors);
+		}
+	};
+
+	const FIntPoint Center = GetCell(Origin);
+	const int32 MaxRing = MaxRadius > 0.f ? FMath::CeilToInt32(MaxRadius / CellSize) : MAX_int32;
+	for (int32 Ring = 0; Ring <= MaxRing; ++Ring)
+	{
+		// Once a ring has more cells than exist, the remaining cells are cheaper to walk directly
+		if (Ring > 0 && 8 * Ring > Cells.Num())
+		{
+			for (const TPair<FIntPoint, TArray<TWeakObjectPtr<AActor>>>& Pair : Cells)
+			{
+				const int32 PairRing = FMath::Max(FMath::Abs(Pair.Key.X - Center.X), FMath::Abs(Pair.Key.Y - Center.Y));
+				if (PairRing >= Ring && PairRing <= MaxRing)
+				{
+					VisitCell(Pair.Value);
+				}
+			}
+			break;
+		}
+
+		if (Ring == 0)
+		{
+			VisitCellAt(Center.X, Center.Y);
+		}
+		else
+		{
+			for (int32 Offset = -Ring; Offset <= Ring; ++Offset)
+			{
+				VisitCellAt(Center.X + Offset, Center.Y - Ring);
+				VisitCellAt(Center.X + Offset, Center.Y + Ring);
+			}
+			for (int32 Offset = -Ring + 1; Offset < Ring; ++Offset)
+			{
+				VisitCellAt(Center.X - Ring, Center.Y + Offset);
+				VisitCellAt(Center.X + Ring, Center.Y + Offset);
+			}
+		}
+
+		// Cells beyond this ring are at least Ring cells away from the origin
+		if (ActorsVisited >= IndexedActors.Num() || (Nearest.Num() == Count && Nearest.Last().Key <= FMath::Square(Ring * double(CellSize))))
+		{
+			break;
+		}
+	}
+
+	for (const TPair<double, AActor*>& Pair : Nearest)
+	{
+		OutActors.Add(Pair.Value);
+	}
+}
+
+//*************************************************************************
+//* Reverse index
+//*************************************************************************
+
+void URAIKnowledgeSubsystem::AddRegard(URAIKnowledgeComponent* Knowledge, const AActor* Target, FGameplayTag Relation)
+{
+	Regards.FindOrAdd(FRegardKey(Target, Relation)).Knowledge.FindOrAdd(Knowledge)++;
+}
+
+void URAIKnowledgeSubsystem::RemoveRegard(URAIKnowledgeComponent* Knowledge, const AActor* Target, FGameplayTag Relation)
+{
+	const FRegardKey Key(Target, Relation);
+	FRegard* Regard = Regards.Find(Key);
+	int32* Count = Regard ? Regard->Knowledge.Find(Knowledge) : nullptr;
+	if (Count && --*Count == 0)
+	{
+		Regard->Knowledge.Remove(Knowledge);
+		if (Regard->Knowledge.IsEmpty() && Regard->Groups.IsEmpty())
+		{
+			Regards.Remove(Key);
+		}
+	}
+}
+
+void URAIKnowledgeSubsystem::AddGroupRegard(FRAISharedKnowledge& SharedKnowledge, const AActor* Target, FGameplayTag Relation)
+{
+	Regards.FindOrAdd(FRegardKey(Target, Relation)).Groups.FindOrAdd(&SharedKnowledge)++;
+}
+
+void URAIKnowledgeSubsystem::RemoveGroupRegard(FRAISharedKnowledge& SharedKnowledge, const AActor* Target, FGameplayTag Relation)
+{
+	const FRegardKey Key(Target, Relation);
+	FRegard* Regard = Regards.Find(Key);
+	int32* Count = Regard ? Regard->Groups.Find(&SharedKnowledge) : nullptr;
+	if (Count && --*Count == 0)
+	{
+		Regard->Groups.Remove(&SharedKnowledge);
+		if (Regard->Knowledge.IsEmpty() && Regard->Groups.IsEmpty())
+		{
+			Regards.Remove(Key);
+		}
+	}
+}
+
+void URAIKnowledgeSubsystem::GetKnowledgeRegarding(const AActor* Target, FGameplayTag Relation, TArray<URAIKnowledgeComponent*>& OutKnowledge) const
+{
+	OutKnowledge.Reset();
+	const FRegard* Regard = Regards.Find(FRegardKey(Target, Relation));
+	if (!Regard)
+	{
+		return;
+	}
+
+	for (const TPair<URAIKnowledgeComponent*, int32>& Pair : Regard->Knowledge)
+	{
+		OutKnowledge.Add(Pair.Key);
+	}
+
+	// Members with their own facts about the target were either listed above or no longer hold the group's view
+	for (const TPair<FRAISharedKnowledge*, int32>& Pair : Regard->Groups)
+	{
+		for (const TWeakObjectPtr<URAIKnowledgeComponent>& Member : Pair.Key->Members)
+		{
+			if (const URAIKnowledgeComponent* Knowledge = Member.Get(); Knowledge && !Knowledge->Store.Find(Target))
+			{
+				OutKnowledge.Add(const_cast<URAIKnowledgeComponent*>(Knowledge));
+			}
+		}
+	}
+}
+
+TArray<AActor*> URAIKnowledgeSubsystem::GetAgentsRegarding(AActor* Target, FGameplayTag Relation) const
+{
+	TArray<URAIKnowledgeComponent*> Knowledge;
+	GetKnowledgeRegarding(Target, Relation, Knowledge);
+
+	TArray<AActor*> Agents;
+	Agents.Reserve(Knowledge.Num());
+	for (const URAIKnowledgeComponent* Component : Knowledge)
+	{
+		Agents.Add(Component->GetOwner());
+	}
+	return Agents;
+}
+
+TStatId URAIKnowledgeSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(URAIKnowledgeSubsystem, STATGROUP_RAI);
+}
+
+bool URAIKnowledgeSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
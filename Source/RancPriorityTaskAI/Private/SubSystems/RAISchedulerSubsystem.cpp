@@ -0,0 +1,422 @@
+// Copyright Rancorous Games, 2024
+
+#include "SubSystems/RAISchedulerSubsystem.h"
+
+#include "RAIController.h"
+#include "RAIManagerComponent.h"
+#include "RAITaskComponent.h"
+#include "RAIStats.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformTime.h"
+
+// Weight of the newest sample in the running average of update waits
+static constexpr float UpdateWaitSmoothing = 0.05f;
+
+URAISchedulerSubsystem::URAISchedulerSubsystem()
+{
+	DistantFieldSettings.UpdateInterval = 1.f;
+	DistantFieldSettings.RescoreBlueprintPriorities = false;
+	DistantFieldSettings.SimulationStep = 2.f;
+}
+
+void URAISchedulerSubsystem::RegisterManager(URAIManagerComponent* Manager)
+{
+	if (Manager && !Manager->RegisteredWithScheduler)
+	{
+		Manager->RegisteredWithScheduler = true;
+		Managers.Add(Manager);
+		Manager->SetSimulationField(Manager->SimulationField, GetFieldSettings(Manager->SimulationField));
+	}
+}
+
+void URAISchedulerSubsystem::UnregisterManager(URAIManagerComponent* Manager)
+{
+	if (!Manager || !Manager->RegisteredWithScheduler)
+	{
+		return;
+	}
+
+	Manager->RegisteredWithScheduler = false;
+	const int32 Index = Managers.IndexOfByKey(Manager);
+	if (Index == INDEX_NONE)
+	{
+		return;
+	}
+
+	if (IsTicking)
+	{
+		// Keep indices stable while iterating, the entry is removed at the end of the tick
+		Managers[Index].Reset();
+		HasStaleEntries = true;
+	}
+	else
+	{
+		Managers.RemoveAt(Index);
+		if (NextManagerIndex > Index)
+		{
+			NextManagerIndex--;
+		}
+	}
+}
+
+void URAISchedulerSubsystem::RequestUrgentUpdate(URAIManagerComponent* Manager)
+{
+	if (Manager && !Manager->UrgentUpdatePending)
+	{
+		Manager->UrgentUpdatePending = true;
+		UrgentManagers.Add(Manager);
+	}
+}
+
+void URAISchedulerSubsystem::ResetWaitStatistics()
+{
+	AverageUpdateWait = 0.f;
+	MaxUpdateWait = 0.f;
+}
+
+void URAISchedulerSubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	const double WorldTime = GetWorld()->GetTimeSeconds();
+	AgentsUpdatedLastFrame = 0;
+	IsTicking = true;
+
+	if (LastFieldAssignmentTime < 0.0 || WorldTime - LastFieldAssignmentTime >= FieldAssignmentInterval)
+	{
+		AssignSimulationFields(WorldTime);
+	}
+
+	if (ParallelScoring)
+	{
+		TickParallel(WorldTime);
+	}
+	else
+	{
+		TickSequential(WorldTime);
+	}
+
+	IsTicking = false;
+
+	if (HasStaleEntries)
+	{
+		RemoveStaleEntries();
+	}
+}
+
+void URAISchedulerSubsystem::TickSequential(double WorldTime)
+{
+	// Priority lane, these agents update this frame regardless of the budget
+	if (UrgentManagers.Num() > 0)
+	{
+		TArray<TWeakObjectPtr<URAIManagerComponent>> UrgentThisFrame = MoveTemp(UrgentManagers);
+		UrgentManagers.Reset();
+
+		for (const TWeakObjectPtr<URAIManagerComponent>& WeakManager : UrgentThisFrame)
+		{
+			URAIManagerComponent* Manager = WeakManager.Get();
+			if (!Manager)
+			{
+				continue;
+			}
+
+			// Cleared first so a request made during the update queues the next frame
+			Manager->UrgentUpdatePending = false;
+			if (IsScheduled(Manager))
+			{
+				UpdateManager(Manager, WorldTime);
+			}
+		}
+	}
+
+	// Round-robin through the rest until the budget is spent
+	const double BudgetSeconds = FrameBudgetMs / 1000.0;
+	const double StartTime = FPlatformTime::Seconds();
+	const int32 ManagerCount = Managers.Num();
+
+	for (int32 Visited = 0; Visited < ManagerCount; ++Visited)
+	{
+		if (NextManagerIndex >= ManagerCount)
+		{
+			NextManagerIndex = 0;
+		}
+
+		URAIManagerComponent* Manager = Managers[NextManagerIndex++].Get();
+		if (!Manager)
+		{
+			HasStaleEntries = true;
+			continue;
+		}
+
+		if (!IsDueForUpdate(Manager, WorldTime))
+		{
+			continue;
+		}
+
+		UpdateManager(Manager, WorldTime);
+
+		if (FPlatformTime::Seconds() - StartTime >= BudgetSeconds)
+		{
+			break;
+		}
+	}
+}
+
+void URAISchedulerSubsystem::TickParallel(double WorldTime)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	ParallelAgents.Reset();
+
+	// Recorded as updated right away so the round-robin below skips them
+	for (const TWeakObjectPtr<URAIManagerComponent>& WeakManager : UrgentManagers)
+	{
+		if (URAIManagerComponent* Manager = WeakManager.Get())
+		{
+			Manager->UrgentUpdatePending = false;
+			if (IsScheduled(Manager))
+			{
+				RecordUpdate(Manager, WorldTime);
+				ParallelAgents.Add(Manager);
+			}
+		}
+	}
+	UrgentManagers.Reset();
+
+	// The batch is scored all at once, so size it up front from the measured cost per agent
+	const double BudgetSeconds = FrameBudgetMs / 1000.0;
+	const int32 ManagerCount = Managers.Num();
+	const int32 MaxBatchSize = ParallelAgents.Num() + FMath::Max(1, FMath::FloorToInt32(BudgetSeconds / EstimatedParallelAgentSeconds));
+
+	for (int32 Visited = 0; Visited < ManagerCount && ParallelAgents.Num() < MaxBatchSize; ++Visited)
+	{
+		if (NextManagerIndex >= ManagerCount)
+		{
+			NextManagerIndex = 0;
+		}
+
+		URAIManagerComponent* Manager = Managers[NextManagerIndex++].Get();
+		if (!Manager)
+		{
+			HasStaleEntries = true;
+			continue;
+		}
+
+		if (IsDueForUpdate(Manager, WorldTime))
+		{
+			RecordUpdate(Manager, WorldTime);
+			ParallelAgents.Add(Manager);
+		}
+	}
+
+	if (ParallelAgents.Num() == 0)
+	{
+		return;
+	}
+
+	// Phase 1, game thread: snapshot the inputs of every agent
+	PriorityBatch.Reset();
+	for (const TWeakObjectPtr<URAIManagerComponent>& WeakManager : ParallelAgents)
+	{
+		// A blueprint priority fallback or reinvoked task may have destroyed agents later in the batch
+		URAIManagerComponent* Manager = WeakManager.Get();
+		if (!Manager)
+		{
+			continue;
+		}
+
+		RAI_COUNT(AgentsUpdated, 1);
+		Manager->AdvanceDistantSimulation(WorldTime);
+		Manager->FlushPerceptionQueue(WorldTime);
+
+		if (!Manager->HandlePendingReinvoke())
+		{
+			Manager->GatherPriorityInputs(PriorityBatch);
+		}
+	}
+
+	// Phase 2, worker threads: score against the snapshot
+	PriorityBatch.ScoreParallel();
+
+	// Phase 3, game thread: apply priorities, batch the interrupt gap comparisons, then start or interrupt tasks
+	for (int32 AgentIndex = 0; AgentIndex < PriorityBatch.Agents.Num(); ++AgentIndex)
+	{
+		FRAIPriorityBatch::FAgent& Agent = PriorityBatch.Agents[AgentIndex];
+		URAIManagerComponent* Manager = Agent.Manager.Get();
+		if (!Manager)
+		{
+			continue;
+		}
+
+		URAITaskComponent* BestTask = Manager->CommitPriorities(PriorityBatch, AgentIndex);
+		Agent.BestTask = BestTask;
+		Agent.ActiveTaskAtCommit = Manager->ActiveTask;
+
+		if (Manager->NeedsInterruptCheck(BestTask))
+		{
+			const URAITaskComponent* ActiveTask = Manager->ActiveTask;
+			PriorityBatch.AddInterruptLane(AgentIndex, BestTask->GetPriority(), ActiveTask->GetPriority(), ActiveTask->GetInterruptType());
+		}
+	}
+
+	PriorityBatch.EvaluateInterrupts();
+
+	for (const FRAIPriorityBatch::FAgent& Agent : PriorityBatch.Agents)
+	{
+		URAIManagerComponent* Manager = Agent.Manager.Get();
+		if (!Manager)
+		{
+			continue;
+		}
+
+		// Starting a task for an earlier agent may have changed this one, only trust the batched decision if nothing moved
+		TOptional<bool> ShouldInterrupt;
+		if (Agent.InterruptLane != INDEX_NONE && Manager->ActiveTask == Agent.ActiveTaskAtCommit.Get())
+		{
+			ShouldInterrupt = PriorityBatch.InterruptDecisions[Agent.InterruptLane];
+		}
+
+		Manager->ApplyBestTask(Agent.BestTask.Get(), ShouldInterrupt);
+	}
+
+	const double AgentSeconds = (FPlatformTime::Seconds() - StartTime) / ParallelAgents.Num();
+	EstimatedParallelAgentSeconds = FMath::Max(FMath::Lerp(EstimatedParallelAgentSeconds, AgentSeconds, 0.25), 1e-7);
+	ParallelAgents.Reset();
+}
+
+bool URAISchedulerSubsystem::IsScheduled(const URAIManagerComponent* Manager) const
+{
+	return Manager->UpdatedByScheduler && Manager->IsActive() && Manager->OwningController && Manager->OwningController->IsRAIActive();
+}
+
+bool URAISchedulerSubsystem::IsDueForUpdate(const URAIManagerComponent* Manager, double WorldTime) const
+{
+	if (!IsScheduled(Manager) || Manager->LastScheduledUpdateFrame == GFrameCounter)
+	{
+		return false;
+	}
+
+	const float Interval = FMath::Max(Manager->ScheduledUpdateInterval, Manager->GetFieldSettings().UpdateInterval);
+	return Manager->LastScheduledUpdateTime < 0.f || WorldTime - Manager->LastScheduledUpdateTime >= Interval;
+}
+
+void URAISchedulerSubsystem::RecordUpdate(URAIManagerComponent* Manager, double WorldTime)
+{
+	if (Manager->LastScheduledUpdateTime >= 0.f)
+	{
+		const float Wait = WorldTime - Manager->LastScheduledUpdateTime;
+		Manager->LastScheduledUpdateWait = Wait;
+		AverageUpdateWait = AverageUpdateWait <= 0.f ? Wait : FMath::Lerp(AverageUpdateWait, Wait, UpdateWaitSmoothing);
+		MaxUpdateWait = FMath::Max(MaxUpdateWait, Wait);
+	}
+
+	Manager->LastScheduledUpdateTime = WorldTime;
+	Manager->LastScheduledUpdateFrame = GFrameCounter;
+	AgentsUpdatedLastFrame++;
+}
+
+void URAISchedulerSubsystem::UpdateManager(URAIManagerComponent* Manager, double WorldTime)
+{
+	RecordUpdate(Manager, WorldTime);
+	Manager->UpdateActiveTasks();
+}
+
+void URAISchedulerSubsystem::RemoveStaleEntries()
+{
+	for (int32 Index = Managers.Num() - 1; Index >= 0; --Index)
+	{
+		if (!Managers[Index].IsValid())
+		{
+			Managers.RemoveAt(Index);
+			if (NextManagerIndex > Index)
+			{
+				NextManagerIndex--;
+			}
+		}
+	}
+
+	HasStaleEntries = false;
+}
+
+const FRAIFieldSettings& URAISchedulerSubsystem::GetFieldSettings(ERAIField Field) const
+{
+	return Field == ERAIField::DistantField ? DistantFieldSettings : NearFieldSettings;
+}
+
+void URAISchedulerSubsystem::AssignSimulationFields(double WorldTime)
+{
+	LastFieldAssignmentTime = WorldTime;
+
+	ViewLocations.Reset();
+	if (UseSimulationFields)
+	{
+		for (FConstPlayerControllerIterator Iterator = GetWorld()->GetPlayerControllerIterator(); Iterator; ++Iterator)
+		{
+			if (const APlayerController* PlayerController = Iterator->Get())
+			{
+				FVector ViewLocation;
+				FRotator ViewRotation;
+				PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+				ViewLocations.Add(ViewLocation);
+			}
+		}
+	}
+
+	// Without anyone to look at them there is nothing to save by demoting, e.g. a server before players join
+	const bool EveryoneNear = ViewLocations.Num() == 0;
+	const float PromoteDistanceSquared = FMath::Square(NearFieldRadius);
+	const float DemoteDistanceSquared = FMath::Square(NearFieldRadius + FieldHysteresis);
+
+	NearFieldAgentCount = 0;
+	DistantFieldAgentCount = 0;
+
+	for (const TWeakObjectPtr<URAIManagerComponent>& WeakManager : Managers)
+	{
+		URAIManagerComponent* Manager = WeakManager.Get();
+		if (!Manager)
+		{
+			continue;
+		}
+
+		ERAIField Field = ERAIField::NearField;
+		if (!EveryoneNear && Manager->Character)
+		{
+			const FVector AgentLocation = Manager->Character->GetActorLocation();
+			float ClosestDistanceSquared = TNumericLimits<float>::Max();
+			for (const FVector& ViewLocation : ViewLocations)
+			{
+				ClosestDistanceSquared = FMath::Min(ClosestDistanceSquared, static_cast<float>(FVector::DistSquared(AgentLocation, ViewLocation)));
+			}
+
+			const bool IsNear = Manager->SimulationField == ERAIField::NearField
+				                    ? ClosestDistanceSquared <= DemoteDistanceSquared
+				                    : ClosestDistanceSquared < PromoteDistanceSquared;
+			Field = IsNear ? ERAIField::NearField : ERAIField::DistantField;
+		}
+
+		if (Field != Manager->SimulationField)
+		{
+			Manager->SetSimulationField(Field, GetFieldSettings(Field));
+		}
+
+		if (Field == ERAIField::NearField)
+		{
+			NearFieldAgentCount++;
+		}
+		else
+		{
+			DistantFieldAgentCount++;
+		}
+	}
+}
+
+TStatId URAISchedulerSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(URAISchedulerSubsystem, STATGROUP_RAI);
+}
+
+bool URAISchedulerSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
@@ -0,0 +1,150 @@
+// Copyright Rancorous Games, 2024
+
+#include "SubSystems/RAISmoothPathCacheSubsystem.h"
+
+#include "RAIStats.h"
+#include "NavigationData.h"
+#include "NavigationSystem.h"
+#include "NavFilters/NavigationQueryFilter.h"
+#include "Engine/World.h"
+
+void URAISmoothPathCacheSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	Paths.Empty(FMath::Max(MaxEntries, 1));
+	MemoryUsed = 0;
+}
+
+void URAISmoothPathCacheSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	// The navigation system reports here whenever a batch of dirty navmesh tiles has been rebuilt
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(&InWorld))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.AddUniqueDynamic(this, &URAISmoothPathCacheSubsystem::OnNavigationGenerationFinished);
+	}
+}
+
+void URAISmoothPathCacheSubsystem::Deinitialize()
+{
+	if (UNavigationSystemV1* NavSys = FNavigationSystem::GetCurrent<UNavigationSystemV1>(GetWorld()))
+	{
+		NavSys->OnNavigationGenerationFinishedDelegate.RemoveDynamic(this, &URAISmoothPathCacheSubsystem::OnNavigationGenerationFinished);
+	}
+
+	Paths.Empty();
+	MemoryUsed = 0;
+
+	Super::Deinitialize();
+}
+
+FRAISmoothPathKey URAISmoothPathCacheSubsystem::MakeKey(const FVector& Start, const FVector& Forward, const FVector& Goal,
+                                                        const ANavigationData& NavData, TSubclassOf<UNavigationQueryFilter> Filter,
+                                                        bool AllowPartialPath, float CurveAngleThreshold, int32 MaxCurveSegments,
+                                                        float MinCurveSegmentLength) const
+{
+	const double Cell = FMath::Max(PositionQuantization, 1.f);
+	const float HeadingStep = FMath::Clamp(HeadingQuantization, 1.f, 90.f);
+	const int32 HeadingSteps = FMath::Max(FMath::RoundToInt(360.f / HeadingStep), 1);
+	const float HeadingDegrees = FRotator::ClampAxis(FMath::RadiansToDegrees(FMath::Atan2(Forward.Y, Forward.X)));
+
+	FRAISmoothPathKey Key;
+	Key.Start = FIntVector(FMath::RoundToInt(Start.X / Cell), FMath::RoundToInt(Start.Y / Cell), FMath::RoundToInt(Start.Z / Cell));
+	Key.Goal = FIntVector(FMath::RoundToInt(Goal.X / Cell), FMath::RoundToInt(Goal.Y / Cell), FMath::RoundToInt(Goal.Z / Cell));
+	// Headings just below 360 degrees round to the same step as 0
+	Key.Heading = FMath::RoundToInt(HeadingDegrees / HeadingStep) % HeadingSteps;
+	Key.NavData = &NavData;
+	Key.Filter = Filter.Get();
+	Key.AllowPartialPath = AllowPartialPath;
+	Key.CurveAngleThreshold = CurveAngleThreshold;
+	Key.MaxCurveSegments = MaxCurveSegments;
+	Key.MinCurveSegmentLength = MinCurveSegmentLength;
+	return Key;
+}
+
+FNavPathSharedPtr URAISmoothPathCacheSubsystem::FindPath(const FRAISmoothPathKey& Key, const ANavigationData& NavData, const FVector& Start,
+                                                        const FVector& Goal)
+{
+	const FCachedPath* Cached = Paths.FindAndTouch(Key);
+	if (!Cached)
+	{
+		CacheMisses++;
+		RAI_COUNT(SmoothPathCacheMisses, 1);
+		return nullptr;
+	}
+
+	CacheHits++;
+	RAI_COUNT(SmoothPathCacheHits, 1);
+
+	// Path following advances the path it is given, so every agent gets its own copy
+	FNavPathSharedPtr Path = MakeShared<FNavigationPath>();
+	// The cached ends are only within PositionQuantization of this request's, arrival is tested against the last point
+	Path->GetPathPoints() = Cached->Points;
+	Path->GetPathPoints()[0].Location = Start;
+	Path->GetPathPoints().Last().Location = Goal;
+	Path->SetNavigationDataUsed(&NavData);
+	Path->SetIsPartial(Cached->IsPartial);
+	Path->SetTimeStamp(NavData.GetWorldTimeStamp());
+	Path->MarkReady();
+	return Path;
+}
+
+void URAISmoothPathCacheSubsystem::AddPath(const FRAISmoothPathKey& Key, const FNavigationPath& Path)
+{
+	if (Path.GetPathPoints().Num() < 2)
+	{
+		return;
+	}
+
+	FCachedPath Cached;
+	Cached.Points = Path.GetPathPoints();
+	Cached.IsPartial = Path.IsPartial();
+	Cached.Bytes = sizeof(FRAISmoothPathKey) + sizeof(FCachedPath) + Cached.Points.GetAllocatedSize();
+
+	const int64 MemoryCap = static_cast<int64>(FMath::Max(MaxMemoryKB, 1)) * 1024;
+	if (Cached.Bytes > MemoryCap)
+	{
+		return;
+	}
+
+	if (const FCachedPath* Existing = Paths.Find(Key))
+	{
+		MemoryUsed -= Existing->Bytes;
+		Paths.Remove(Key);
+	}
+
+	// Evict by hand rather than letting Add drop the least recent entry, so MemoryUsed stays exact
+	while (Paths.Num() > 0 && (Paths.Num() >= Paths.Max() || MemoryUsed + Cached.Bytes > MemoryCap))
+	{
+		MemoryUsed -= Paths.RemoveLeastRecent().Bytes;
+	}
+
+	MemoryUsed += Cached.Bytes;
+	Paths.Add(Key, MoveTemp(Cached));
+}
+
+void URAISmoothPathCacheSubsystem::InvalidateAll()
+{
+	// Counted even when empty, an asynchronous path in flight must still see the change
+	Invalidations++;
+	if (Paths.Num() == 0)
+	{
+		return;
+	}
+
+	Paths.Empty(FMath::Max(MaxEntries, 1));
+	MemoryUsed = 0;
+}
+
+void URAISmoothPathCacheSubsystem::OnNavigationGenerationFinished(ANavigationData* NavData)
+{
+	// A rebuilt tile may lie under any cached path, and tile rebuilds are rare next to path requests
+	InvalidateAll();
+}
+
+bool URAISmoothPathCacheSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
@@ -0,0 +1,59 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RAIConsiderationSet.h"
+#include "RAIDataStructures.h"
+
+/**
+ * Structure-of-arrays batch of (input, response curve) pairs sharing one curve type, e.g. every Logistic
+ * consideration of every task scored in a frame. Kept alive between passes so refilling it does not allocate.
+ */
+struct RANCPRIORITYTASKAI_API FRAICurveLanes
+{
+	TArray<float> RawInputs;
+	TArray<float> InputMin;
+	TArray<float> InvInputRange;
+	TArray<float> Slope;
+	TArray<float> Steepness;
+	TArray<float> XShift;
+	TArray<float> YShift;
+	/* First sample of the sampled curve, only filled for the Curve type */
+	TArray<const float*> Tables;
+	/* Where the response of each lane should be written back to */
+	TArray<int32> OutputIndices;
+
+	int32 Num() const { return RawInputs.Num(); }
+	void Reset();
+	void Add(const FRAIConsiderationProgram& Program, int32 InstructionIndex, float RawInput, int32 OutputIndex);
+};
+
+/**
+ * Batch kernels for the hot inner loops of native scoring. The vector versions process 4 lanes per step using the
+ * engine's portable vector registers, the scalar versions are the reference implementation and handle the tail.
+ */
+struct RANCPRIORITYTASKAI_API FRAIConsiderationKernels
+{
+	static constexpr int32 LaneWidth = 4;
+	static constexpr int32 NumInterruptionTypes = static_cast<int32>(ERAIInterruptionType::Never) + 1;
+
+	/* Single response, shared by FRAIConsiderationProgram and the kernel tails so every path scores identically */
+	static float EvaluateCurve(ERAIResponseCurveType Type, float RawInput, float InputMin, float InvInputRange, float Slope,
+	                           float Steepness, float XShift, float YShift, const float* Table);
+
+	/* Writes the responses of lanes [First, First + Count) of Lanes into OutResponses[0, Count) */
+	static void EvaluateCurves(ERAIResponseCurveType Type, const FRAICurveLanes& Lanes, int32 First, int32 Count, float* OutResponses);
+	static void EvaluateCurvesScalar(ERAIResponseCurveType Type, const FRAICurveLanes& Lanes, int32 First, int32 Count, float* OutResponses);
+
+	/* OutShouldInterrupt[i] = CandidatePriorities[i] - ActivePriorities[i] > Gaps[i] */
+	static void CompareInterruptGaps(const float* CandidatePriorities, const float* ActivePriorities, const float* Gaps,
+	                                 bool* OutShouldInterrupt, int32 Num);
+	static void CompareInterruptGapsScalar(const float* CandidatePriorities, const float* ActivePriorities, const float* Gaps,
+	                                       bool* OutShouldInterrupt, int32 Num);
+
+	/* Batched CheckIfTaskShouldInterrupt. Looks the interruption type of each active task up in its own gap table of
+	 * NumInterruptionTypes entries, which starts at GapTables + GapTableOffsets[i] */
+	static void ShouldInterruptBatch(const float* CandidatePriorities, const float* ActivePriorities, const ERAIInterruptionType* InterruptTypes,
+	                                 const float* GapTables, const int32* GapTableOffsets, bool* OutShouldInterrupt, int32 Num);
+};
@@ -0,0 +1,220 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/DataAsset.h"
+#include "GameplayTagContainer.h"
+#include "RAIDataStructures.h"
+#include "RAIConsiderationSet.generated.h"
+
+class UCurveFloat;
+class APawn;
+class URAIManagerComponent;
+class URAITaskComponent;
+class URAIKnowledgeComponent;
+
+/* Where a consideration reads its raw input value from */
+UENUM(BlueprintType)
+enum class ERAIConsiderationInput : uint8
+{
+	/* Always InputMax, useful as a flat base priority */
+	Constant,
+	/* IRAIManagerToPawnInterface::GetNormalizedStat(StatName) on the controlled pawn */
+	PawnStat,
+	/* IRAIManagerToPawnInterface::IsInMelee on the controlled pawn, 0 or 1 */
+	PawnIsInMelee,
+	/* 1 if the AI has a focus actor, 0 otherwise */
+	HasFocus,
+	/* URAIManagerComponent::DistanceToFocus */
+	DistanceToFocus,
+	/* URAIManagerComponent::DistanceToFocusLastDetectedPoint */
+	DistanceToFocusLastDetectedPoint,
+	/* 1 if the knowledge component knows Tag as a relation to the focus actor, 0 otherwise */
+	FocusRelation,
+	/* 1 while the scored task is active, useful to add momentum to the current task */
+	TaskIsActive,
+	/* Seconds since the scored task last began, InputMax if it never began */
+	TimeSinceTaskBegun
+};
+
+/* Shape of the response curve mapping a normalized input to a 0-1 response */
+UENUM(BlueprintType)
+enum class ERAIResponseCurveType : uint8
+{
+	/* Slope * (X - XShift) + YShift */
+	Linear,
+	/* Slope * (X - XShift)^2 + YShift */
+	Quadratic,
+	/* Slope / (1 + e^(-Steepness * (X - XShift))) + YShift */
+	Logistic,
+	/* Sampled from the Curve asset over X in [0, 1] */
+	Curve
+};
+
+/* How the weighted responses of a consideration set are combined into one score */
+UENUM(BlueprintType)
+enum class ERAIConsiderationCombine : uint8
+{
+	Multiply,
+	Average,
+	Sum,
+	Min,
+	Max
+};
+
+USTRUCT(BlueprintType)
+struct FRAIResponseCurve
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration")
+	ERAIResponseCurveType Type = ERAIResponseCurveType::Linear;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Type != ERAIResponseCurveType::Curve"))
+	float Slope = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Type == ERAIResponseCurveType::Logistic"))
+	float Steepness = 10.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Type != ERAIResponseCurveType::Curve"))
+	float XShift = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Type != ERAIResponseCurveType::Curve"))
+	float YShift = 0.f;
+
+	/* Sampled into a flat table when the consideration set is compiled, the asset is not read while scoring */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Type == ERAIResponseCurveType::Curve"))
+	UCurveFloat* Curve = nullptr;
+};
+
+USTRUCT(BlueprintType)
+struct FRAIConsideration
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration")
+	ERAIConsiderationInput Input = ERAIConsiderationInput::Constant;
+
+	/* Stat queried from the pawn when Input is PawnStat */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Input == ERAIConsiderationInput::PawnStat"))
+	FName StatName;
+
+	/* Relation looked up on the focus actor when Input is FocusRelation */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (EditCondition = "Input == ERAIConsiderationInput::FocusRelation"))
+	FGameplayTag Tag;
+
+	/* The raw input is normalized to 0-1 between InputMin and InputMax before the response curve is applied */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration")
+	float InputMin = 0.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration")
+	float InputMax = 1.f;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration")
+	FRAIResponseCurve ResponseCurve;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Consideration", meta = (ClampMin = "0.0"))
+	float Weight = 1.f;
+};
+
+/* Everything a consideration program may read an input from. Only valid on the game thread */
+struct FRAIConsiderationContext
+{
+	const URAIManagerComponent* Manager = nullptr;
+	const URAITaskComponent* Task = nullptr;
+	APawn* Pawn = nullptr;
+	AActor* Focus = nullptr;
+	URAIKnowledgeComponent* Knowledge = nullptr;
+	float WorldTime = 0.f;
+};
+
+/**
+ * A consideration set compiled into flat native data. Gathering inputs touches the game world,
+ * scoring gathered inputs is pure and may run on any thread.
+ */
+struct RANCPRIORITYTASKAI_API FRAIConsiderationProgram
+{
+	/* Upper bound of considerations in one set, lets scoring use stack buffers */
+	static constexpr int32 MaxInstructions = 16;
+	/* Number of segments a UCurveFloat response curve is sampled into */
+	static constexpr int32 CurveTableSegments = 32;
+
+	struct FInstruction
+	{
+		ERAIConsiderationInput Input = ERAIConsiderationInput::Constant;
+		ERAIResponseCurveType CurveType = ERAIResponseCurveType::Linear;
+		float InputMin = 0.f;
+		float InputMax = 1.f;
+		float InvInputRange = 1.f;
+		float Slope = 1.f;
+		float Steepness = 10.f;
+		float XShift = 0.f;
+		float YShift = 0.f;
+		float Weight = 1.f;
+		/* Index into CurveTables of the first sample, INDEX_NONE unless CurveType is Curve */
+		int32 TableOffset = INDEX_NONE;
+		FName StatName;
+		FGameplayTag Tag;
+	};
+
+	TArray<FInstruction> Instructions;
+	TArray<float> CurveTables;
+	ERAIConsiderationCombine Combine = ERAIConsiderationCombine::Multiply;
+	float WeightSum = 0.f;
+	float PriorityScale = 100.f;
+	/* Union of what the instructions read, used by the manager to skip re-scoring when nothing changed */
+	ERAIPriorityDependency Dependencies = ERAIPriorityDependency::None;
+
+	int32 Num() const { return Instructions.Num(); }
+
+	/* Reads one raw input per instruction into OutRawInputs, which must hold Num() values. Game thread only. */
+	void GatherInputs(const FRAIConsiderationContext& Context, float* OutRawInputs) const;
+
+	/* Scores previously gathered raw inputs. Thread safe. */
+	float Score(const float* RawInputs) const;
+
+	/* Maps a single raw input through the instructions normalization and response curve */
+	float EvaluateResponse(int32 InstructionIndex, float RawInput) const;
+
+	/* Combines one 0-1 response per instruction into the final priority */
+	float CombineResponses(const float* Responses) const;
+
+	/* Gathers and scores in one go. Game thread only. */
+	float Evaluate(const FRAIConsiderationContext& Context) const;
+};
+
+/**
+ * Data asset describing how a task calculates its priority natively, without a Blueprint CalculatePriority.
+ * Each consideration maps an input through a response curve, the weighted responses are combined with CombineOperator.
+ */
+UCLASS(BlueprintType)
+class RANCPRIORITYTASKAI_API URAIConsiderationSet : public UDataAsset
+{
+	GENERATED_BODY()
+
+public:
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Consideration")
+	TArray<FRAIConsideration> Considerations;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Consideration")
+	ERAIConsiderationCombine CombineOperator = ERAIConsiderationCombine::Multiply;
+
+	/* The combined 0-1 score is multiplied by this to get the task priority */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Consideration")
+	float PriorityScale = 100.f;
+
+	/* Returns the compiled program, compiling it on first use. Shared by every task using this set. Game thread only. */
+	TSharedPtr<const FRAIConsiderationProgram> GetProgram() const;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
+private:
+
+	mutable TSharedPtr<const FRAIConsiderationProgram> CompiledProgram;
+
+	TSharedPtr<const FRAIConsiderationProgram> Compile() const;
+};
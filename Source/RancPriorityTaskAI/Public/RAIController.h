@@ -4,6 +4,9 @@
 
 #include "CoreMinimal.h"
 #include "AIController.h"
+#include "RAIDataStructures.h"
+#include "RAIThoughtBuffer.h"
+#include "SubSystems/RAISmoothPathCacheSubsystem.h"
 #include "RAIController.generated.h"
 
 class URAIManagerComponent;
@@ -43,6 +46,11 @@ public:
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Transient,Category = Configuration)
 	int MaxThoughtMemoryCount = 30;
 
+	/* Whether the traced thoughts are also formatted into Thoughts, which the RAI mind view widget reads. Thoughts is rebuilt
+	 * from the thought buffer at most once per frame. Off in Shipping builds, use GetThoughts to read the thoughts on demand instead */
+	UPROPERTY(EditAnywhere,BlueprintReadWrite,Category = Configuration)
+	bool MirrorThoughtsToArray = !UE_BUILD_SHIPPING;
+
 	/* Whether the RAI system should handle forwarding sensory input  to tasks using the built in sensory system.
 	 * Set to false if you dont want input or want to call the manager sensory input methods yourself */
 	UPROPERTY(EditAnywhere,BlueprintReadOnly,Transient,Category = Configuration)
@@ -53,7 +61,7 @@ public:
 //* Status variables
 //*************************************************************************
 	
-	/* An array of traced thoughts used primarily for debugging */
+	/* An array of traced thoughts used primarily for debugging, only filled if MirrorThoughtsToArray */
 	UPROPERTY(VisibleAnywhere,BlueprintReadOnly,Category = Status)
 	TArray<FString> Thoughts;
 	
@@ -68,14 +76,25 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = RAI)
 	FOnThoughtTrace OnThoughtTrace;
 	
-	/*  Add a thought to Thoughts */
+	/*  Add a thought to Thoughts. Does nothing in Shipping and Test builds */
+	UFUNCTION(BlueprintCallable, Category = RAI)
+	void TraceThought(const FString& Thought);
+
+	/*  Formats the traced thoughts, oldest first */
 	UFUNCTION(BlueprintCallable, Category = RAI)
-	void TraceThought(FString Thought);
+	void GetThoughts(TArray<FString>& OutThoughts) const;
+
+	/*  Native tracing without building a string, use through RAI_TRACE_THOUGHT so it compiles out of Shipping and Test builds */
+	void TraceThoughtEvent(ERAIThoughtType Type, FName Subject, int32 Value = 0);
 
 	/* Triggers a custom event on the task of the specified class, react to it by overloading OnCustomTrigger in Task 
 	 * Payload may be any object you want to pass to the task */
 	UFUNCTION(BlueprintCallable, Category = RAI)
 	void TriggerCustom(TSubclassOf<URAITaskComponent> Task, FGameplayTag Trigger, UObject* Payload);
+
+	/* Same as TriggerCustom but with a handle from the managers FindTaskHandle, skipping the class lookup */
+	UFUNCTION(BlueprintCallable, Category = RAI)
+	void TriggerCustomByHandle(FRAITaskHandle TaskHandle, FGameplayTag Trigger, UObject* Payload);
 	
 	/* Triggers a custom event on all tasks, react to it by overloading OnCustomTrigger in Task
 	 * Payload may be any object you want to pass to the task */
@@ -107,6 +126,23 @@ protected:
 	 */
 	FNavPathSharedPtr GenerateSmoothPath(const FAIMoveRequest& MoveRequest) const;
 
+	/**
+	 * Generates the points the curve passes through, from the pawn location towards the goal.
+	 * @param MoveRequest The original request from the behavior tree or game logic.
+	 * @param OutCandidatePoints The pawn location, the intermediate points and the goal location.
+	 * @return False if not enough points were generated to form a path.
+	 */
+	bool BuildSmoothPathCandidates(const FAIMoveRequest& MoveRequest, TArray<FVector>& OutCandidatePoints) const;
+
+	/**
+	 * Asynchronous variant of GenerateSmoothPath. Queries all segments but the first with the asynchronous pathfinding API
+	 * and finds the first one right away, the others are stitched onto it by OnSmoothSegmentFound as they arrive.
+	 * Until the last segment is stitched the path ends in the goal itself, so the move cannot finish at a mid-curve point.
+	 * @param MoveRequest The original request from the behavior tree or game logic.
+	 * @return The first segment to start moving along, or a null pointer if it fails.
+	 */
+	FNavPathSharedPtr BeginAsyncSmoothPath(const FAIMoveRequest& MoveRequest);
+
 private:
 	/**
 	 * A helper function to append a new path segment to an existing composite path.
@@ -115,6 +151,36 @@ private:
 	 */
 	void StitchPathSegments(FNavPathSharedPtr& InOutBasePath, const FNavPathSharedPtr& PathToAdd) const;
 
+	/** Receives an asynchronous segment query, stitches every segment that is now in order and updates the active move. */
+	void OnSmoothSegmentFound(uint32 QueryId, ENavigationQueryResult::Type Result, FNavPathSharedPtr SegmentPath);
+
+	/** Builds the key of the smooth path MoveRequest would generate from the current pawn location and heading. */
+	bool MakeSmoothPathKey(const FAIMoveRequest& MoveRequest, const URAISmoothPathCacheSubsystem& PathCache,
+	                       FRAISmoothPathKey& OutKey, const ANavigationData*& OutNavData) const;
+
+	/** Aborts the outstanding segment queries and forgets the asynchronous smooth path. */
+	void AbortAsyncSmoothPath();
+
+	/** Replaces the path of the asynchronous smooth path move with the default path to its goal, after a segment failed. */
+	void FallBackFromAsyncSmoothPath();
+
+	/** The move the asynchronous smooth path is being stitched for, and the path the PathFollowingComponent follows.
+	 *  The last point of AsyncSmoothPath is the provisional goal until all segments are stitched */
+	FAIMoveRequest AsyncSmoothMoveRequest;
+	FAIRequestID AsyncSmoothMoveId;
+	FNavPathSharedPtr AsyncSmoothPath;
+
+	/** Key the asynchronous smooth path is cached under once all its segments are stitched, unset if it is not cached */
+	TOptional<FRAISmoothPathKey> AsyncSmoothCacheKey;
+
+	/** URAISmoothPathCacheSubsystem::Invalidations when the asynchronous smooth path was started, it is not cached if that changed */
+	int32 AsyncSmoothCacheInvalidations = 0;
+
+	/** Query id of segment i, INVALID_NAVQUERYID once it arrived. Segments that arrive out of order wait in AsyncSegments */
+	TArray<uint32> AsyncSegmentQueryIds;
+	TArray<FNavPathSharedPtr> AsyncSegments;
+	int32 NextSegmentToStitch = 0;
+
 public:
 	//~ Smooth Path Configuration Parameters
 	//----------------------------------------------------------------------//
@@ -137,6 +203,16 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Smooth Path", meta = (ClampMin = "50.0"))
 	float MinCurveSegmentLength = 100.0f;
 
+	/** Whether the segments are found with the asynchronous pathfinding API. The pawn starts along the first segment right away
+	 * and the remaining segments are stitched in as they arrive, instead of all being found on the game thread in MoveTo. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Smooth Path")
+	bool AsyncSmoothPaths = false;
+
+	/** Whether smooth paths are shared through the URAISmoothPathCacheSubsystem, so agents asking for the same curve from about
+	 * the same place and heading skip generating it. Cached paths are dropped whenever the navmesh is rebuilt. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "AI|Smooth Path")
+	bool UseSmoothPathCache = false;
+
 private:
 	
 	UPROPERTY()
@@ -146,4 +222,17 @@ private:
 	void OnPerceptionUpdated(AActor* Actor, FAIStimulus Stimulus);
 
 	bool bRAIActive = true;
+
+#if RAI_THOUGHT_TRACE_ENABLED
+	FRAIThoughtBuffer ThoughtBuffer;
+
+	/* Whether Thoughts is due to be rebuilt next tick */
+	bool ThoughtsMirrorDirty = false;
+
+	/* Formats the newest thought for OnThoughtTrace and marks Thoughts for a rebuild, if anyone reads them */
+	void PublishLatestThought();
+
+	/* Rebuilds Thoughts from the thought buffer */
+	void RefreshThoughtsMirror();
+#endif
 };
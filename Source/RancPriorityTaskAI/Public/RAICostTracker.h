@@ -0,0 +1,128 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/PlatformTime.h"
+#include "UObject/ObjectKey.h"
+
+/* What a measured task call was doing */
+enum class ERAICostPhase : uint8
+{
+	/* CalculatePriority or the native considerations */
+	Score,
+	/* BeginTask, including the blueprint graph */
+	Begin,
+	/* EndTask when ended by the manager or an ancestor, including the blueprint override */
+	End,
+
+	Num
+};
+
+/* Cost distribution of one phase of one task class. Samples are bucketed in half octaves from 0.25 us to about 260 ms */
+struct FRAICostStats
+{
+	static constexpr int32 BucketCount = 40;
+
+	uint64 Count = 0;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+	uint32 Buckets[BucketCount] = {};
+
+	void Add(double Seconds);
+
+	double GetMeanSeconds() const { return Count > 0 ? TotalSeconds / Count : 0.0; }
+
+	/* Upper bound of the bucket holding the given percentile, 0-1 */
+	double GetPercentileSeconds(double Percentile) const;
+};
+
+/**
+ * Attributes the game thread cost of scoring, beginning and ending tasks to their task class, across every AI in the process.
+ * Print the most expensive classes with rai.Cost.Top. A class over its URAITaskComponent::CostBudgetMs, or over rai.Cost.DefaultBudgetMs,
+ * logs a warning once per phase.
+ */
+class RANCPRIORITYTASKAI_API FRAICostTracker
+{
+public:
+
+	static FRAICostTracker& Get();
+
+	/* Whether costs are recorded, see rai.Cost.Enabled */
+	static bool IsEnabled();
+
+	/* Slot to record the costs of a task class into, stable for the lifetime of the process. Game thread only */
+	int32 RegisterClass(const UClass* TaskClass);
+
+	/* Game thread only */
+	void Record(int32 ClassSlot, ERAICostPhase Phase, uint64 Cycles);
+
+	/* Logs the Count most expensive task classes by total time in Phase, or in all phases if Phase is Num */
+	void LogTop(int32 Count, ERAICostPhase Phase) const;
+
+	void Reset();
+
+private:
+
+	struct FClassEntry
+	{
+		FString ClassName;
+		float BudgetMs = 0.f;
+		FRAICostStats Phases[static_cast<int32>(ERAICostPhase::Num)];
+		bool AnnouncedOverBudget[static_cast<int32>(ERAICostPhase::Num)] = {};
+	};
+
+	TArray<FClassEntry> Entries;
+	TMap<TObjectKey<UClass>, int32> SlotByClass;
+};
+
+/**
+ * Records the time until the end of the scope into a task class. Does nothing for INDEX_NONE or while recording is disabled.
+ * The time is exclusive, scopes nested inside it, e.g. an invoked task beginning from BeginTask, are charged to their own class only.
+ */
+class FRAICostScope
+{
+public:
+
+	FRAICostScope(int32 InClassSlot, ERAICostPhase InPhase)
+		: ClassSlot(InClassSlot), Phase(InPhase)
+	{
+		if (ClassSlot != INDEX_NONE && FRAICostTracker::IsEnabled())
+		{
+			FRAICostScope*& Current = GetCurrent();
+			Parent = Current;
+			Current = this;
+			StartCycles = FPlatformTime::Cycles64();
+		}
+	}
+
+	~FRAICostScope()
+	{
+		if (StartCycles != 0)
+		{
+			const uint64 Cycles = FPlatformTime::Cycles64() - StartCycles;
+			FRAICostTracker::Get().Record(ClassSlot, Phase, Cycles - FMath::Min(ChildCycles, Cycles));
+
+			if (Parent)
+			{
+				Parent->ChildCycles += Cycles;
+			}
+			GetCurrent() = Parent;
+		}
+	}
+
+	FRAICostScope(const FRAICostScope&) = delete;
+	FRAICostScope& operator=(const FRAICostScope&) = delete;
+
+private:
+
+	int32 ClassSlot;
+	ERAICostPhase Phase;
+	uint64 StartCycles = 0;
+	/* Time spent in nested scopes, subtracted from this one */
+	uint64 ChildCycles = 0;
+	FRAICostScope* Parent = nullptr;
+
+	/* Innermost open scope of the calling thread */
+	static FRAICostScope*& GetCurrent();
+};
@@ -32,9 +32,72 @@ enum class ERAIField : uint8
 	// ProbabilisticField
 };
 
+/* How agents in one ERAIField are simulated, see URAISchedulerSubsystem */
+USTRUCT(BlueprintType)
+struct FRAIFieldSettings
+{
+	GENERATED_BODY()
+
+	/* Minimum time in seconds between two scheduled updates of an agent in this field, on top of its ScheduledUpdateInterval */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Field", meta = (ClampMin = "0.0"))
+	float UpdateInterval = 0.f;
+
+	/* Whether CalculatePriority blueprint events are run. If not, blueprint scored tasks keep their last priority
+	 * and only native considerations are re-scored */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Field")
+	bool RescoreBlueprintPriorities = true;
+
+	/* Whether perception stimuli are forwarded to the tasks. If not they are held, one per actor and sense,
+	 * and delivered once the AI is in a field that forwards them again */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Field")
+	bool ForwardPerception = true;
+
+	/* Tasks with SupportsDistantSimulation run their coarse mode, advanced in steps of this many seconds, instead of their full lifecycle.
+	 * 0 runs the full lifecycle */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Field", meta = (ClampMin = "0.0"))
+	float SimulationStep = 0.f;
+};
+
 UENUM(BlueprintType)
 enum class EDoneWaitingExecutionStates : uint8
 {
 	Continue,
 	TaskEnded
 };
+
+/* Compact reference to a task of one manager, resolved in constant time. Get one from URAIManagerComponent::FindTaskHandle */
+USTRUCT(BlueprintType)
+struct FRAITaskHandle
+{
+	GENERATED_BODY()
+
+	/* Index into the AllTasks of the manager that issued the handle */
+	UPROPERTY()
+	int32 Index = INDEX_NONE;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+
+	bool operator==(const FRAITaskHandle& Other) const { return Index == Other.Index; }
+	bool operator!=(const FRAITaskHandle& Other) const { return Index != Other.Index; }
+	friend uint32 GetTypeHash(const FRAITaskHandle& Handle) { return ::GetTypeHash(Handle.Index); }
+};
+
+/* What a tasks priority reads, so the manager only re-scores tasks whose inputs changed */
+UENUM(BlueprintType, meta = (Bitflags, UseEnumValuesAsMaskValuesInEditor = "true"))
+enum class ERAIPriorityDependency : uint8
+{
+	None = 0 UMETA(Hidden),
+	/* Stats read from the pawn, invalidate with InvalidatePriorityInputs when they change */
+	PawnStats = 1 << 0,
+	/* Relationship facts in the knowledge component, invalidated automatically */
+	Knowledge = 1 << 1,
+	/* Perception stimuli, invalidated automatically */
+	Perception = 1 << 2,
+	/* Focus actor and focus distances, invalidated automatically */
+	Focus = 1 << 3,
+	/* Any of the tags in PriorityDependencyTags, invalidate with InvalidatePriorityTag */
+	CustomTags = 1 << 4,
+	/* Re-score every update */
+	Always = 1 << 5
+};
+ENUM_CLASS_FLAGS(ERAIPriorityDependency);
@@ -0,0 +1,108 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Misc/Paths.h"
+
+/* Define as 0 in the project to compile every recording call out. Never compiled into Shipping */
+#ifndef RAI_DECISION_RECORDER_ENABLED
+#define RAI_DECISION_RECORDER_ENABLED !UE_BUILD_SHIPPING
+#endif
+
+#if RAI_DECISION_RECORDER_ENABLED
+#define RAI_RECORD_DECISION(Type, Agent, Task, Other, Value) FRAIDecisionRecorder::Record(Type, Agent, Task, Other, Value)
+#else
+#define RAI_RECORD_DECISION(Type, Agent, Task, Other, Value)
+#endif
+
+enum class ERAIDecisionEventType : uint8
+{
+	/* Task began, Value is its priority */
+	TaskEnter,
+	/* Task ended, Value is 1 on success */
+	TaskExit,
+	/* Task interrupted Other, Value is the priority difference */
+	TaskInterrupt,
+	/* Other invoked Task */
+	TaskInvoke,
+	/* Task completed and returned to its invoking Other, Value is 1 on success */
+	TaskReturn,
+	/* Task was scored to a new priority, or rescored to the same one a keyframe interval after its last snapshot. Value is the priority */
+	PrioritySnapshot,
+	/* Task hit the infinite loop detection */
+	LoopDetected,
+	/* Task timed out while waiting */
+	WaitTimeout,
+	/* Task returned without ending or waiting and was started again */
+	ReinvokeFallback,
+	/* Task is about to start on a priority kept from an earlier update, by dependency tracking or the field. Value is its age */
+	PriorityCacheHit
+};
+
+/**
+ * Fixed size event as stored in the ring file. Names are stored as FName display ids and resolved through the names sidecar
+ * file written next to the ring file, so recording never touches strings.
+ */
+struct FRAIDecisionEvent
+{
+	double WorldTime = 0.0;
+	uint32 Frame = 0;
+	uint32 AgentId = 0;
+	uint32 TaskNameId = 0;
+	uint32 OtherNameId = 0;
+	float Value = 0.f;
+	ERAIDecisionEventType Type = ERAIDecisionEventType::TaskEnter;
+	uint8 Padding[3] = {};
+};
+static_assert(sizeof(FRAIDecisionEvent) == 32, "The ring file format relies on 32 byte events");
+
+/* Start of a ring file, followed by Capacity events. Event i of the session lives in slot i % Capacity */
+struct FRAIDecisionFileHeader
+{
+	static constexpr uint32 ExpectedMagic = 0x52494152; // "RAIR"
+	static constexpr uint32 CurrentVersion = 1;
+
+	uint32 Magic = ExpectedMagic;
+	uint32 Version = CurrentVersion;
+	uint32 EventSize = sizeof(FRAIDecisionEvent);
+	uint32 Capacity = 0;
+	/* Total events written this session, the newest Min(TotalEvents, Capacity) are in the file */
+	uint64 TotalEvents = 0;
+	/* Events lost because a thread produced them faster than they were flushed */
+	uint64 DroppedEvents = 0;
+	int64 SessionStartTicks = 0;
+	uint8 Reserved[24] = {};
+};
+static_assert(sizeof(FRAIDecisionFileHeader) == 64, "The ring file header is 64 bytes");
+
+/**
+ * Opt-in recorder of AI decisions into a per session ring file under Saved/RAITrace, for debugging AI without verbose logs.
+ * Every thread records into its own single producer buffer without locks, a ticker on the game thread periodically hands the
+ * buffers to a background task that writes them to the file. Only the newest rai.Recorder.MaxFiles sessions are kept.
+ * Enabled with -RAIRecord on the command line or rai.Recorder.Enabled, read the files with the RAITraceAnalyzer commandlet.
+ */
+class RANCPRIORITYTASKAI_API FRAIDecisionRecorder
+{
+public:
+
+	/* Thread safe. Agent is typically the AI controller, its unique id identifies the agent in the file */
+	static void Record(ERAIDecisionEventType Type, const UObject* Agent, FName Task, FName Other = NAME_None, float Value = 0.f);
+
+	/* Hands everything recorded so far to the background writer. Game thread only */
+	static void Flush();
+
+	/* Enables recording if the command line has -RAIRecord, called on module startup */
+	static void Startup();
+
+	/* Writes everything still pending and closes the file, called on module shutdown */
+	static void Shutdown();
+
+	/* Seconds after which an unchanged priority is snapshot again, see rai.Recorder.SnapshotKeyframe */
+	static float GetSnapshotKeyframeInterval();
+
+	/* Path of the current ring file, empty if nothing has been recorded this session. Game thread only */
+	static FString GetCurrentFilePath();
+
+	static FString GetNamesFilePath(const FString& RingFilePath) { return FPaths::ChangeExtension(RingFilePath, TEXT("names")); }
+};
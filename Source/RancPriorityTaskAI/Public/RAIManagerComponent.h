@@ -4,11 +4,18 @@
 
 #include "CoreMinimal.h"
 #include "RAITaskinvokeArguments.h"
+#include "RAIDataStructures.h"
+#include "RAITaskStateArrays.h"
 #include "Components/ActorComponent.h"
 #include "Perception/AIPerceptionTypes.h"
+#include "GameplayTagContainer.h"
 #include "RAIManagerComponent.generated.h"
 
 class URAITaskComponent;
+class URAIKnowledgeComponent;
+struct FRAIConsiderationProgram;
+struct FRAIConsiderationContext;
+struct FRAIPriorityBatch;
 class APawn;
 class ACharacter;
 class ARAIController;
@@ -32,6 +39,8 @@ public:
 protected:
 
 	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 public:
 
@@ -57,6 +66,10 @@ public:
 	
 	UPROPERTY(VisibleAnywhere, Transient, Category = Focus)
 	AActor* ControllerFocus = nullptr;
+
+	/*  Knowledge component found on the controller or pawn, read by native considerations */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Manager")
+	URAIKnowledgeComponent* KnowledgeComponent = nullptr;
 	
 	/*  All the possible tasks. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Manager")
@@ -93,6 +106,38 @@ public:
 	/* Minimum priority difference that must be overcome to interrupt a task with interruption type IfLifeOrDeathInterrupt */
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Manager")
 	float IfLifeOrDeathInterruptPriorityGap = 250.f;
+
+	/* Whether the RAI scheduler subsystem calls UpdateActiveTasks for this AI, under its frame budget.
+	 * Enable this instead of calling UpdateActiveTasks yourself, e.g. from tick or a timer, never both */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Scheduling")
+	bool UpdatedByScheduler = false;
+
+	/* Minimum time in seconds between two scheduler driven updates of this AI */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Scheduling", meta = (ClampMin = "0.0"))
+	float ScheduledUpdateInterval = 0.1f;
+
+	/* Tasks with TrackPriorityDependencies are re-scored after this many seconds even if none of their inputs were invalidated.
+	 * Guards against inputs that changed without anyone invalidating them. 0 disables the safety net */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Priority", meta = (ClampMin = "0.0"))
+	float MaxCachedPriorityAge = 1.0f;
+
+	/* How far the focus distances must move before tasks depending on Focus are re-scored */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Priority", meta = (ClampMin = "0.0"))
+	float FocusDistanceInvalidationThreshold = 50.f;
+
+	/* Whether stimuli reported by the controller are queued and delivered to the tasks at the start of the next update, keeping only
+	 * one stimulus per actor and sense. Otherwise every stimulus reaches the tasks the moment the perception system reports it.
+	 * Meant for frequent updates, e.g. UpdatedByScheduler, a stimulus waiting longer than MaxQueuedStimulusAge is lost */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Perception")
+	bool CoalescePerceptionStimuli = false;
+
+	/* Queued stimuli that waited longer than this many seconds for an update are dropped, except for lost sense stimuli */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Perception", meta = (ClampMin = "0.0", EditCondition = "CoalescePerceptionStimuli"))
+	float MaxQueuedStimulusAge = 2.f;
+
+	/* Most stimuli queued at once, the oldest sensed one is dropped to make room */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Perception", meta = (ClampMin = "1", EditCondition = "CoalescePerceptionStimuli"))
+	int32 MaxQueuedStimuli = 64;
 	
 //*************************************************************************
 //* Status
@@ -114,6 +159,18 @@ public:
 	/*  PrimaryTasks is a subset of AllTasks that are primary and need priority updates */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Manager")
 	TArray<URAITaskComponent*> PrimaryTasks = {};
+
+	/*  Simulation field the scheduler assigned this AI to, see URAISchedulerSubsystem::NearFieldRadius */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Scheduling")
+	ERAIField SimulationField = ERAIField::NearField;
+
+	/*  World time of the last update done by the scheduler subsystem */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Scheduling")
+	float LastScheduledUpdateTime = -1.0f;
+
+	/*  Time in seconds this AI waited between its last two scheduler driven updates */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Scheduling")
+	float LastScheduledUpdateWait = 0.0f;
 	
 //*************************************************************************
 //* Methods
@@ -123,7 +180,20 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "RAI|Manager")
 	URAITaskComponent* GetTaskByClass(TSubclassOf<URAITaskComponent> TaskClass) const;
 
-	/* Call this to update the AIs priorities and update active task if needed, typicall on tick or slow tick */
+	/* Handle of the first task that is a TaskClass, invalid if there is none. Cache it to skip the lookup in later calls */
+	UFUNCTION(BlueprintPure, Category = "RAI|Manager")
+	FRAITaskHandle FindTaskHandle(TSubclassOf<URAITaskComponent> TaskClass) const;
+
+	/* Handle of the task with the given TaskTag, invalid if there is none */
+	UFUNCTION(BlueprintPure, Category = "RAI|Manager")
+	FRAITaskHandle FindTaskHandleByTag(FGameplayTag TaskTag) const;
+
+	/* Task referenced by a handle from this manager, null if the handle is invalid */
+	UFUNCTION(BlueprintPure, Category = "RAI|Manager")
+	URAITaskComponent* GetTaskByHandle(FRAITaskHandle TaskHandle) const;
+
+	/* Updates the AIs priorities and the active task if needed. Call it yourself, typically on tick or slow tick,
+	 * unless UpdatedByScheduler is enabled, in which case the RAI scheduler subsystem calls it */
 	UFUNCTION(BlueprintCallable, Category = "RAI|Manager")
 	void UpdateActiveTasks();
 
@@ -131,6 +201,26 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "RAI|Manager")
 	void ForceInterruptActiveTask(URAITaskComponent* AssumedActiveTask);
 
+	/* Ask the scheduler to update this AI this frame regardless of its frame budget, e.g. when taking damage */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Scheduling")
+	void RequestUrgentUpdate();
+
+	/* Re-score every task depending on any of the given inputs on the next update, e.g. after changing a pawn stat */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Priority")
+	void InvalidatePriorityInputs(UPARAM(meta = (Bitmask, BitmaskEnum = "/Script/RancPriorityTaskAI.ERAIPriorityDependency")) int32 Dependencies);
+
+	/* Re-score every task that lists Tag in its PriorityDependencyTags on the next update */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Priority")
+	void InvalidatePriorityTag(FGameplayTag Tag);
+
+	/* Re-score a single task on the next update */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Priority")
+	void InvalidateTaskPriority(URAITaskComponent* Task);
+
+	/* Call after changing the PerceptionSenses or ReceivesPerception of a task at runtime */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Perception")
+	void RefreshPerceptionSubscriptions();
+
 	
 //*************************************************************************
 //* Only called from RAIManagerComponent or self
@@ -138,10 +228,60 @@ public:
 	
 	void Initialize(ARAIController* Controller, APawn* Pawn);
 	void OnPerceptionStimulus(AActor* Actor, FAIStimulus Stimulus);
+	/* Queues the stimulus if CoalescePerceptionStimuli, forwards it right away otherwise */
+	void QueuePerceptionStimulus(AActor* Actor, const FAIStimulus& Stimulus);
+	/* Delivers the queued stimuli, called at the start of every update. Keeps them queued while the field does not forward perception */
+	void FlushPerceptionQueue(float WorldTime);
 	bool InvokeTask(TSubclassOf<URAITaskComponent> TaskClass, URAITaskComponent*  ParentInvokingTask, FRAITaskInvokeArguments& InvokeArguments);
+	bool InvokeTaskByHandle(FRAITaskHandle TaskHandle, URAITaskComponent* ParentInvokingTask, FRAITaskInvokeArguments& InvokeArguments);
 	void TaskEnded(URAITaskComponent* Task);
 	void ReturnToInvokingTask(URAITaskComponent* CompletedTask, URAITaskComponent* ParentTask, bool Success);
 
+	/* Called by the scheduler when this AI moves to another field, or registers. If the field changed, running tasks are moved
+	 * in or out of their coarse mode and every task is notified */
+	void SetSimulationField(ERAIField NewField, const FRAIFieldSettings& NewFieldSettings);
+	const FRAIFieldSettings& GetFieldSettings() const { return FieldSettings; }
+
+	/* Runs the coarse distant steps that are due for the running tasks, called at the start of every update */
+	void AdvanceDistantSimulation(float WorldTime);
+
+	/* Set while this AI is queued on the priority lane of the scheduler, so it is queued at most once */
+	bool UrgentUpdatePending = false;
+
+	/* GFrameCounter of the last update done by the scheduler, so the round-robin skips AIs the priority lane already updated */
+	uint64 LastScheduledUpdateFrame = MAX_uint64;
+
+	/* Set while this AI is in the managers list of the scheduler */
+	bool RegisteredWithScheduler = false;
+
+	/* Hot state of every task in AllTasks, indexed by task handle. Written through by the task components setters */
+	FRAITaskStateArrays TaskState;
+
+//*************************************************************************
+//* Two-phase updates, only called from URAISchedulerSubsystem
+//*************************************************************************
+
+	/* Restarts an active task that returned without ending or waiting. Returns true if the update is done for this pass */
+	bool HandlePendingReinvoke();
+
+	/* Game thread. Appends one job per primary task to Batch, snapshotting native consideration inputs */
+	void GatherPriorityInputs(FRAIPriorityBatch& Batch);
+
+	/* Game thread. Applies the scores of a batch produced by GatherPriorityInputs and returns the best ready task */
+	URAITaskComponent* CommitPriorities(const FRAIPriorityBatch& Batch, int32 AgentIndex);
+
+	/* Whether switching to BestTask would have to interrupt the active task, i.e. the gap comparison is needed */
+	bool NeedsInterruptCheck(const URAITaskComponent* BestTask) const;
+
+	/* Starts, wakes or interrupts tasks for the chosen best task. The interrupt gap comparison can be passed in when it was batched */
+	void ApplyBestTask(URAITaskComponent* BestTask, TOptional<bool> PrecomputedShouldInterrupt = TOptional<bool>());
+
+	/* Minimum priority difference needed to interrupt a task of the given interruption type */
+	float GetInterruptPriorityGap(ERAIInterruptionType InterruptionType) const;
+
+	/* Writes the gap of every ERAIInterruptionType, indexed by type, into OutGapTable */
+	void FillInterruptPriorityGapTable(float* OutGapTable) const;
+
 	//*************************************************************************
 //* Private
 //*************************************************************************
@@ -149,9 +289,72 @@ private:
 
 	bool AnnouncedBadTaskReturnWarning = false;
 	bool ReinvokeActiveTask = false;
+
+	/* Task registry built in Initialize. Every class in a tasks hierarchy maps to the first task of that class in AllTasks */
+	TMap<const UClass*, int32> TaskIndexByClass;
+	TMap<FGameplayTag, int32> TaskIndexByTag;
+
+	/* Classes a lookup already failed for, so a miss is only reported once */
+	mutable TSet<const UClass*> ReportedMissingTaskClasses;
+
+	/* Compiled consideration programs, parallel to PrimaryTasks. Null for tasks scored by the CalculatePriority blueprint event */
+	TArray<TSharedPtr<const FRAIConsiderationProgram>> PrimaryTaskPrograms;
+
+	/* Settings of SimulationField */
+	FRAIFieldSettings FieldSettings;
+
+	/* World time the distant simulation has been advanced to, negative while not simulating distantly */
+	float DistantSimulatedUntil = -1.0f;
+
+	/* Index of each primary task into TaskState, parallel to PrimaryTasks */
+	TArray<int32> PrimaryTaskStateIndices;
+
+	/* Dependency tracking, parallel to PrimaryTasks. Untracked tasks depend on Always */
+	TArray<ERAIPriorityDependency> PrimaryTaskDependencies;
+	TArray<float> PrimaryTaskScoreTimes;
+	/* World time of the last PrioritySnapshot recorded for each primary task, negative if none */
+	TArray<float> PrimaryTaskSnapshotTimes;
+	TBitArray<> DirtyPrimaryTasks;
+
+	struct FQueuedStimulus
+	{
+		TWeakObjectPtr<AActor> Actor;
+		FAIStimulus Stimulus;
+		float QueuedTime = 0.f;
+	};
+
+	/* Stimuli waiting for the next update, at most one per actor and sense */
+	TArray<FQueuedStimulus> QueuedStimuli;
+
+	/* Adds the stimulus to QueuedStimuli, replacing the one queued for the same actor and sense */
+	void CoalesceStimulus(AActor* Actor, const FAIStimulus& Stimulus);
+
+	/* Tasks a stimulus is forwarded to, indexed by sense id and built on first use. Only filtered by ReceivesPerception and PerceptionSenses,
+	 * the cheaper per stimulus checks are done while dispatching */
+	TArray<TArray<int32>> PerceptionSubscribersBySense;
+	TBitArray<> PerceptionSubscribersBuilt;
+	/* Subscribers to stimuli without a valid sense, the tasks accepting every sense */
+	TArray<int32> PerceptionSubscribersAnySense;
+
+	/* Focus as seen by the last priority pass, to detect focus changes without hooking every focus setter */
+	TWeakObjectPtr<AActor> LastScoredFocus;
+	float LastScoredDistanceToFocus = -1.0f;
+	float LastScoredDistanceToFocusLastDetectedPoint = -1.0f;
 	
+	void BuildTaskRegistry();
+	void ReportMissingTask(const UClass* TaskClass) const;
 	void StartTask(URAITaskComponent* Task, FRAITaskInvokeArguments InvokeArgument = FRAITaskInvokeArguments());
 	URAITaskComponent* UpdateTaskPriorities();
+	FRAIConsiderationContext MakeConsiderationContext() const;
+	void DetectFocusChange(const AActor* Focus);
+	bool NeedsRescore(int32 TaskIndex, float WorldTime) const;
+	void MarkRescored(int32 TaskIndex, float WorldTime);
+	/* Records a PrioritySnapshot if the priority changed or the snapshot keyframe interval passed */
+	void RecordPrioritySnapshot(int32 TaskIndex, float OldPriority, float NewPriority, float WorldTime);
+	void OnKnowledgeChanged();
+	const TArray<int32>& GetPerceptionSubscribers(FAISenseID Sense);
+	void DispatchStimulus(AActor* Actor, const FAIStimulus& Stimulus);
+	bool AcceptsStimulusSource(const URAITaskComponent* Task, const AActor* Actor, TOptional<ETeamAttitude::Type>& Attitude) const;
 	bool CheckIfTaskShouldInterrupt(const URAITaskComponent* ActiveTask, const URAITaskComponent* InterruptingTask) const;
 };
 
@@ -0,0 +1,78 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RAIConsiderationKernels.h"
+
+class URAIManagerComponent;
+class URAITaskComponent;
+struct FRAIConsiderationProgram;
+
+/**
+ * Priority scoring for many agents at once, in three phases:
+ * inputs are gathered on the game thread, scored on worker threads, then committed on the game thread.
+ * Kept alive between passes so steady state scoring does not allocate.
+ */
+struct RANCPRIORITYTASKAI_API FRAIPriorityBatch
+{
+	/* One primary task of one agent */
+	struct FJob
+	{
+		/* Null if the score was already produced during the gather, e.g. by a blueprint CalculatePriority */
+		const FRAIConsiderationProgram* Program = nullptr;
+		int32 InputOffset = INDEX_NONE;
+		float Score = 0.f;
+		/* Disabled or missing task, not scored and not committed */
+		bool Skip = false;
+		/* Scored this pass rather than reusing the cached priority */
+		bool Rescored = false;
+	};
+
+	/* The jobs of one agent, in the order of its PrimaryTasks */
+	struct FAgent
+	{
+		TWeakObjectPtr<URAIManagerComponent> Manager;
+		int32 FirstJob = 0;
+		int32 NumJobs = 0;
+		/* Filled during the commit */
+		TWeakObjectPtr<URAITaskComponent> BestTask;
+		TWeakObjectPtr<URAITaskComponent> ActiveTaskAtCommit;
+		int32 InterruptLane = INDEX_NONE;
+	};
+
+	TArray<FAgent> Agents;
+	TArray<FJob> Jobs;
+	TArray<float> Inputs;
+
+	/* Response of every gathered input, parallel to Inputs */
+	TArray<float> Responses;
+
+	/* The inputs of the jobs of one worker chunk grouped by response curve type, indexed by ERAIResponseCurveType */
+	struct FChunkLanes
+	{
+		FRAICurveLanes CurveLanes[static_cast<int32>(ERAIResponseCurveType::Curve) + 1];
+	};
+
+	/* One per worker chunk, each filled by the worker scoring that chunk */
+	TArray<FChunkLanes> ChunkLanes;
+
+	/* One lane per agent whose best task would have to interrupt its active task */
+	TArray<float> InterruptCandidatePriorities;
+	TArray<float> InterruptActivePriorities;
+	TArray<ERAIInterruptionType> InterruptTypes;
+	/* Start of the gap table of each lane in InterruptGapTables, the gaps differ per manager */
+	TArray<int32> InterruptGapTableOffsets;
+	TArray<float> InterruptGapTables;
+	TArray<bool> InterruptDecisions;
+
+	void Reset();
+
+	/* Scores every job, evaluating the response curves of each worker chunk with the vector kernels */
+	void ScoreParallel();
+
+	/* Adds an interrupt check for an agent against the gap table of its manager, decided for all agents at once by EvaluateInterrupts */
+	void AddInterruptLane(int32 AgentIndex, float CandidatePriority, float ActivePriority, ERAIInterruptionType InterruptType);
+
+	void EvaluateInterrupts();
+};
@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "GameplayTagContainer.h"
 #include "RAIDataStructures.h"
 #include "RAITaskinvokeArguments.h"
 #include "Perception/AIPerceptionTypes.h"
@@ -11,6 +12,9 @@
 
 class URAIManagerComponent;
 class ARAIController;
+class URAIConsiderationSet;
+class UAISense;
+struct FRAITaskStateArrays;
 
 
 /*  The Purpose of this component is to encapsulate a specific task that an AI can do. */
@@ -42,7 +46,7 @@ public:
 
 	/* Used to dynamically enable/disable the prioritization of this task.
 	 * A disabled task can still be invoked by other tasks.*/
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Status")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetIsEnabled, BlueprintGetter = GetIsEnabled, Category = "RAI|Status")
 	bool IsEnabled = true;
 	
 	/*  Whether a task is currently active/running */
@@ -50,18 +54,18 @@ public:
 	bool IsPrimaryTask = true;
 
 	/*  Time in seconds that must pass until the task can fire again. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Configuration")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetCooldown, BlueprintGetter = GetCooldown, Category = "RAI|Configuration")
 	float Cooldown = 0.0f;
 	
 	/* Single use cooldown. Time in seconds that must pass until the task can fire again, reset to 0 next time BeginTask is called. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Configuration")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetNextBeginCooldown, BlueprintGetter = GetNextBeginCooldown, Category = "RAI|Configuration")
 	float NextBeginCooldown = 0.0f;
 
 	/*  A task reaching a higher priority of another task may interrupt the other task depending on the InterruptType */
 	/*  Always will always let a higher priority task interrupt, Never will never let a higher priority task interrupt. */
 	/*  In between options require a certain amount of exceeding priority. See ERAIInterruptionType for options. */
 	/*  A task may switch InterruptType dynamically while active, but it will be reset to default InterruptType when ended. */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Status")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetInterruptType, BlueprintGetter = GetInterruptType, Category = "RAI|Status")
 	ERAIInterruptionType InterruptType = ERAIInterruptionType::Always;
 
 	/*  The default starting InterruptType, also used after a task has ended. */
@@ -72,16 +76,72 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Configuration")
 	bool InterruptIfReachesZero = true;
 
+	/*  Whether this task has a coarse mode for the distant field. If the AIs field has a SimulationStep the task then skips
+	 *  BeginTask, timers and movement, and is advanced with SimulateDistantStep instead */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|DistantSimulation")
+	bool SupportsDistantSimulation = false;
+
+	/*  Seconds of simulated time after which the default SimulateDistantStep ends the task successfully */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|DistantSimulation", meta = (ClampMin = "0.0", EditCondition = "SupportsDistantSimulation"))
+	float DistantExpectedDuration = 0.f;
+
+	/*  Optional tag to look this task up by, see URAIManagerComponent::FindTaskHandleByTag. Should be unique per AI */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Configuration")
+	FGameplayTag TaskTag;
+
+	/*  Native priority calculation. When set the manager scores this task from these considerations instead of calling CalculatePriority */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Priority")
+	URAIConsiderationSet* Considerations = nullptr;
+
+	/*  Opt-in fallback, call the CalculatePriority blueprint event even if Considerations is set */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Priority")
+	bool UseBlueprintCalculatePriority = false;
+
+	/*  Only re-score this task when one of its PriorityDependencies was invalidated, reusing the last priority otherwise.
+	 *  Leave disabled if the priority reads anything not covered by PriorityDependencies */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Priority")
+	bool TrackPriorityDependencies = false;
+
+	/*  What the priority of this task reads. Dependencies of Considerations are added automatically */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Priority",
+		meta = (Bitmask, BitmaskEnum = "/Script/RancPriorityTaskAI.ERAIPriorityDependency", EditCondition = "TrackPriorityDependencies"))
+	int32 PriorityDependencies = 0;
+
+	/*  Custom invalidation tags, see URAIManagerComponent::InvalidatePriorityTag */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Priority", meta = (EditCondition = "TrackPriorityDependencies"))
+	FGameplayTagContainer PriorityDependencyTags;
+
+	/*  Whether OnPerceptionStimulus is called at all. Disable for tasks that ignore perception */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Perception")
+	bool ReceivesPerception = true;
+
+	/*  Senses OnPerceptionStimulus is called for, empty for every sense */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Perception", meta = (EditCondition = "ReceivesPerception"))
+	TArray<TSubclassOf<UAISense>> PerceptionSenses;
+
+	/*  Attitudes towards the sensed actor OnPerceptionStimulus is called for */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Perception", meta = (EditCondition = "ReceivesPerception"))
+	FAISenseAffiliationFilter PerceptionAffiliations;
+
+	/*  If set, OnPerceptionStimulus is only called for actors with at least one of these tags */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Perception", meta = (EditCondition = "ReceivesPerception"))
+	TArray<FName> PerceptionActorTags;
+
+	/*  Milliseconds a single CalculatePriority, BeginTask or EndTask of this class may take before a warning is logged, once per class.
+	 *  0 uses rai.Cost.DefaultBudgetMs. Read from the class defaults */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "RAI|Configuration", meta = (ClampMin = "0.0"))
+	float CostBudgetMs = 0.f;
+
 	//*************************************************************************
 	//* Status variables
 	//*************************************************************************
 
 	/*  Whether a task is currently active/running */
-	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, Transient, Category = "RAI|Status")
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, BlueprintSetter = SetIsTaskActive, BlueprintGetter = GetIsTaskActive, Transient, Category = "RAI|Status")
 	bool IsTaskActive = false;
 
 	/*  A task may be waiting for something to finish, e.g: An invoked task, a timer, a movement command to finish */
-	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "RAI|Status")
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, BlueprintSetter = SetIsWaiting, BlueprintGetter = GetIsWaiting, Category = "RAI|Status")
 	bool IsWaiting = false;
 
 	/* Sometimes a Primary Task may invoke another task to perform something, e.g. a GetFood task might invoke a Hunt task
@@ -97,11 +157,22 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "RAI|Status")
 	FRAITaskInvokeArguments InvokeArgs;
 
+	/*  Whether the task is running its coarse distant field mode instead of the full lifecycle */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Status")
+	bool IsSimulatingDistant = false;
+
+	/* Handle of this task in its manager, valid once the manager is initialized */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Status")
+	FRAITaskHandle TaskHandle;
+
+	/* Index of this task into the primary task arrays of its manager, INDEX_NONE for invoked tasks */
+	int32 PrimaryTaskIndex = INDEX_NONE;
+
 	//*************************************************************************
 	//* Methods
 	//*************************************************************************
 
-	/* Called by ManagerComponent only for Primary tasks, no need to implement for invoked tasks */
+	/* Called by ManagerComponent only for Primary tasks without Considerations, no need to implement for invoked tasks */
 	UFUNCTION(BlueprintImplementableEvent, Category = RAI)
 	float CalculatePriority();
 
@@ -121,6 +192,9 @@ public:
 	void BeginTask(const FRAITaskInvokeArguments& InvokeArguments = FRAITaskInvokeArguments());
 
 	
+	/*  This is called by the manager component or an ancestor whenever it ends this task, it will then call EndTask */
+	virtual void EndTaskCore(bool Success = true, float BeginAgainCooldown = 0, bool WasInterrupted = false);
+
 	/*  This is called by the manager component whenever we begin this task ends */
 	UFUNCTION(BlueprintCallable, BlueprintNativeEvent, Category = RAI,
 		Meta = (SuccessToolTip = "Whether the task succeeded.", AdvancedDisplay = "WasInterrupted, BeginAgainCooldown",
@@ -141,9 +215,13 @@ public:
 	UFUNCTION(BlueprintCallable, Category = RAI)
 	bool InvokeTask(TSubclassOf<URAITaskComponent> TaskClass, FRAITaskInvokeArguments InvokeArguments);
 
+	/*  Same as InvokeTask but with a handle from FindTaskHandle, skipping the class lookup */
+	UFUNCTION(BlueprintCallable, Category = RAI)
+	bool InvokeTaskByHandle(FRAITaskHandle InvokedTaskHandle, FRAITaskInvokeArguments InvokeArguments);
+
 	/*  Add a thought to RAIControllers thoughts for debugging */
 	UFUNCTION(BlueprintCallable, Category = RAI)
-	void TraceThought(FString Thought);
+	void TraceThought(const FString& Thought);
 
 	/*  Call this to indicate the task is waiting for something else, e.g. an AIMoveTo command */
 	UFUNCTION(BlueprintCallable, Category = RAI,
@@ -159,9 +237,73 @@ public:
 			"InterruptTypeToReturnTo is only used if OverrideInterruptionType was set to true when starting the wait.", AdvancedDisplay = "InterruptTypeToReturnTo"))
 	void DoneWaiting(ERAIInterruptionType InterruptTypeToReturnTo, EDoneWaitingExecutionStates& ReturnBranch);
 
-	/* Not yet implemented - Whether the task should fully simulate near player or simple simulate far from player */
+	/* Whether the task should fully simulate near player or simple simulate far from player, assigned by the scheduler subsystem */
 	UFUNCTION(BlueprintCallable, Category = RAI)
-	ERAIField GetSimulationField();
+	ERAIField GetSimulationField() const;
+
+	/*  Distant field replacement for BeginTask, e.g. to pick a destination. Only called if SupportsDistantSimulation */
+	UFUNCTION(BlueprintNativeEvent, Category = "RAI|DistantSimulation")
+	void BeginDistantTask(const FRAITaskInvokeArguments& InvokeArguments);
+
+	/*  Advances the task by StepSeconds of simulated time in the distant field, call EndTask when done.
+	 *  The default implementation ends the task once DistantExpectedDuration has been simulated */
+	UFUNCTION(BlueprintNativeEvent, Category = "RAI|DistantSimulation")
+	void SimulateDistantStep(float StepSeconds);
+
+	/*  Called when the AI is promoted to the near field while this task simulates distantly, right before BeginTask is called
+	 *  to resume the full lifecycle. The pawn has already been put back on the navmesh. Use GetDistantElapsed to skip work already done */
+	UFUNCTION(BlueprintNativeEvent, Category = "RAI|DistantSimulation")
+	void OnPromotedToNearField();
+
+	/*  Teleports the pawn along a navmesh path towards Destination by the distance it walks in StepSeconds. Returns true once arrived */
+	UFUNCTION(BlueprintCallable, Category = "RAI|DistantSimulation")
+	bool DistantMoveTo(FVector Destination, float StepSeconds, float AcceptanceRadius = 50.f);
+
+	/*  Seconds of simulated time since the task began in the distant field */
+	UFUNCTION(BlueprintPure, Category = "RAI|DistantSimulation")
+	float GetDistantElapsed() const { return DistantElapsed; }
+
+	/* World time this task last began, negative if it never began */
+	float GetWorldTimeBegun() const;
+
+	/*  Accessors for the state the manager reads every update. Once the manager has registered the task this state lives
+	 *  only in the managers task state arrays, the fields hold the configured values it was seeded from. Native code must use
+	 *  these instead of the fields, which are not updated at runtime */
+	UFUNCTION(BlueprintGetter)
+	bool GetIsEnabled() const;
+
+	UFUNCTION(BlueprintGetter)
+	float GetCooldown() const;
+
+	UFUNCTION(BlueprintGetter)
+	float GetNextBeginCooldown() const;
+
+	UFUNCTION(BlueprintGetter)
+	ERAIInterruptionType GetInterruptType() const;
+
+	UFUNCTION(BlueprintGetter)
+	bool GetIsTaskActive() const;
+
+	UFUNCTION(BlueprintGetter)
+	bool GetIsWaiting() const;
+
+	UFUNCTION(BlueprintSetter)
+	void SetIsEnabled(bool NewIsEnabled);
+
+	UFUNCTION(BlueprintSetter)
+	void SetCooldown(float NewCooldown);
+
+	UFUNCTION(BlueprintSetter)
+	void SetNextBeginCooldown(float NewNextBeginCooldown);
+
+	UFUNCTION(BlueprintSetter)
+	void SetInterruptType(ERAIInterruptionType NewInterruptType);
+
+	UFUNCTION(BlueprintSetter)
+	void SetIsTaskActive(bool NewIsTaskActive);
+
+	UFUNCTION(BlueprintSetter)
+	void SetIsWaiting(bool NewIsWaiting);
 
 	/* Get the original invoking task */
 	UFUNCTION(BlueprintPure, Category = RAI)
@@ -195,6 +337,25 @@ private:
 
 	void OnWaitTimeout();
 
+	void SetWorldTimeBegun(float NewWorldTimeBegun);
+
+	float DistantElapsed = 0.f;
+
+	/* Path followed by DistantMoveTo, in navmesh space */
+	TArray<FVector> DistantPathPoints;
+	int32 DistantPathIndex = 0;
+	FVector DistantPathGoal = FVector::ZeroVector;
+	FVector DistantPathLocation = FVector::ZeroVector;
+
+	void BeginDistantTaskCore(const FRAITaskInvokeArguments& InvokeArguments);
+
+	/* The managers state arrays if this task is registered with one, null otherwise */
+	FRAITaskStateArrays* GetStateArrays() const;
+
+#if WITH_EDITOR
+	virtual void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+
 
 	//*************************************************************************
 	//* Used by RAIManagerComponent only
@@ -202,6 +363,8 @@ private:
 public:
 	/*  Whether to write highly detailed debug information to the log */
 	bool DebugLoggingEnabled = false;
+	/*  Slot of this tasks class in FRAICostTracker */
+	int32 CostClassSlot = INDEX_NONE;
 	int MaxTaskLoopCount; // Set on ManagerComponent. Engine will detect after 15 repeats in the same frame, we detect across frames within LoopCountDetectionPeriod seconds
 
 
@@ -212,18 +375,36 @@ public:
 	UFUNCTION(BlueprintNativeEvent, Category = RAI)
 	void OnCustomTrigger(FGameplayTag Trigger, UObject* Payload);
 
+	/* The AI moved to another simulation field, branch on GetSimulationField to simplify what the task does far from players */
+	UFUNCTION(BlueprintNativeEvent, Category = RAI)
+	void OnSimulationFieldChanged(ERAIField NewField);
+
 	/*  False if on Cooldown */
 	UFUNCTION(BlueprintPure, Category = "RAI|ManagerInterface")
 	bool IsTaskReady();
 
 	void SetPriority(float NewPriority);
 
+	/* This tasks own last priority, GetPriority returns that of the oldest invoking ancestor for invoked tasks */
+	float GetOwnPriority() const;
+
+	/* Writes this tasks own state, not that of its invoking ancestor, into State at TaskHandle.Index */
+	void CopyStateTo(FRAITaskStateArrays& State) const;
+
+	void SimulateDistantStepCore(float StepSeconds);
+
+	/* Leaves the distant mode, snapping the pawn to the navmesh and beginning the task again with its full lifecycle */
+	void ReconcileWithNearField();
+
+	/* Switches a task begun in the near field to its distant mode, calling BeginDistantTask unless it waits on an invoked task */
+	void DemoteToDistantField();
+
 protected:
 	//*************************************************************************
 	//* Private
 	//*************************************************************************
 
-	/*  Last value calculated by CalculateUtility(). Use GetPriority() instead. */
+	/*  Last value calculated by CalculateUtility() before the manager registered the task. Use GetPriority() instead. */
 	float Priority = 0.0f;
 
 	int CurrentTaskLoopCount = 0;
@@ -0,0 +1,65 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "RAIDataStructures.h"
+
+/**
+ * The task state read on every priority pass, stored by the manager as one contiguous array per field and indexed by
+ * FRAITaskHandle::Index. Task components write through to it from their setters, so the selection loop can stream through
+ * these arrays instead of visiting every task component.
+ */
+struct RANCPRIORITYTASKAI_API FRAITaskStateArrays
+{
+	TArray<float> Priority;
+	TArray<float> Cooldown;
+	TArray<float> NextBeginCooldown;
+	TArray<float> WorldTimeBegun;
+	TArray<ERAIInterruptionType> InterruptType;
+	TBitArray<> IsEnabled;
+	TBitArray<> IsTaskActive;
+	TBitArray<> IsWaiting;
+
+	int32 Num() const { return Priority.Num(); }
+
+	void Reset()
+	{
+		Priority.Reset();
+		Cooldown.Reset();
+		NextBeginCooldown.Reset();
+		WorldTimeBegun.Reset();
+		InterruptType.Reset();
+		IsEnabled.Reset();
+		IsTaskActive.Reset();
+		IsWaiting.Reset();
+	}
+
+	/* Appends a task in its default state and returns its index */
+	int32 Add()
+	{
+		Cooldown.Add(0.f);
+		NextBeginCooldown.Add(0.f);
+		WorldTimeBegun.Add(-1.f);
+		InterruptType.Add(ERAIInterruptionType::Always);
+		IsEnabled.Add(true);
+		IsTaskActive.Add(false);
+		IsWaiting.Add(false);
+		return Priority.Add(0.f);
+	}
+
+	/* Same rules as URAITaskComponent::IsTaskReady */
+	bool IsTaskReady(int32 Index, float WorldTime) const
+	{
+		const float TaskNextBeginCooldown = NextBeginCooldown[Index];
+		const float TaskCooldown = Cooldown[Index];
+		const float TaskWorldTimeBegun = WorldTimeBegun[Index];
+
+		if (TaskNextBeginCooldown <= 0 && TaskCooldown <= 0.0f || TaskWorldTimeBegun <= 0.0f)
+		{
+			return true;
+		}
+
+		return WorldTime - TaskWorldTimeBegun >= (TaskNextBeginCooldown > 0 ? TaskNextBeginCooldown : TaskCooldown);
+	}
+};
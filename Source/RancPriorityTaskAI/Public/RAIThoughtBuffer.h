@@ -0,0 +1,74 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/* Thought tracing is a debugging aid, it compiles out of Shipping and Test builds */
+#define RAI_THOUGHT_TRACE_ENABLED !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+#if RAI_THOUGHT_TRACE_ENABLED
+#define RAI_TRACE_THOUGHT(Controller, Type, Subject, Value) \
+	do { if (Controller) { (Controller)->TraceThoughtEvent(Type, Subject, Value); } } while (0)
+#else
+#define RAI_TRACE_THOUGHT(Controller, Type, Subject, Value)
+#endif
+
+/* Selects how a thought is formatted when it is read */
+enum class ERAIThoughtType : uint8
+{
+	/* Free text traced from blueprint */
+	Text,
+	/* "Beginning: Subject" */
+	BeginTask,
+	/* "Task Subject timed out!" */
+	TaskTimedOut,
+	/* "RAI set to: Active" if Value is non zero, "RAI set to: Inactive" otherwise */
+	RAIActiveChanged
+};
+
+/* One traced thought. Only Text thoughts carry a string, the rest are formatted from Subject and Value on demand */
+struct FRAIThought
+{
+	double WorldTime = 0.0;
+	FName Subject;
+	int32 Value = 0;
+	ERAIThoughtType Type = ERAIThoughtType::Text;
+	FString Text;
+};
+
+/**
+ * Fixed capacity ring of thoughts. Adding overwrites the oldest entry in place, so once the ring is full tracing does not
+ * allocate, except for text thoughts longer than any text previously stored in the reused slot.
+ */
+class RANCPRIORITYTASKAI_API FRAIThoughtBuffer
+{
+public:
+
+	/* Clears the buffer if the capacity changes */
+	void SetCapacity(int32 NewCapacity);
+	int32 GetCapacity() const { return Entries.Num(); }
+
+	void Add(ERAIThoughtType Type, FName Subject, int32 Value, double WorldTime);
+	void AddText(const FString& Text, double WorldTime);
+
+	int32 Num() const { return Count; }
+
+	/* 0 is the oldest thought still in the buffer */
+	const FRAIThought& Get(int32 IndexFromOldest) const;
+	const FRAIThought& Last() const { return Get(Count - 1); }
+
+	/* Appends every thought from oldest to newest, formatted */
+	void CopyFormatted(TArray<FString>& OutThoughts) const;
+
+	static FString Format(const FRAIThought& Thought);
+
+private:
+
+	TArray<FRAIThought> Entries;
+	/* Index of the slot the next thought is written to */
+	int32 Head = 0;
+	int32 Count = 0;
+
+	FRAIThought& AddSlot(ERAIThoughtType Type, double WorldTime);
+};
@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "GameplayTagContainer.h"
+#include "Net/Serialization/FastArraySerializer.h"
 
 #include "RAIKnowledgeComponent.generated.h"
 
@@ -27,10 +28,137 @@ struct FRelationshipFact
 
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Knowledge|Relationships")
     FGameplayTag Category;
+
+    // Assigned by the knowledge component when the fact is added.
+    uint32 FactId = 0;
+
+    // World time at which the fact expires, 0 for facts without a duration. Set when the fact is added.
+    double ExpireTime = 0.0;
+};
+
+class URAIKnowledgeComponent;
+
+/**
+ * How a knowledge component replicates its facts to clients.
+ */
+UENUM(BlueprintType)
+enum class ERAIKnowledgeReplication : uint8
+{
+    // Facts stay on the server.
+    Disabled,
+    // Facts replicate to the owning connection only, e.g. a player controlled companion.
+    OwnerOnly,
+    // Facts replicate to every connection the owning actor is relevant to.
+    Relevancy
+};
+
+/**
+ * A relationship fact as replicated to clients, identified across the network by FactId.
+ */
+USTRUCT()
+struct FRAIReplicatedFact : public FFastArraySerializerItem
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TObjectPtr<AActor> Actor;
+
+    UPROPERTY()
+    FRelationshipFact Fact;
+
+    UPROPERTY()
+    uint32 FactId = 0;
+
+    // Client only, whether the fact is in the index of the component. False while the actor is not relevant.
+    bool Indexed = false;
+
+    void PostReplicatedAdd(const struct FRAIReplicatedFacts& InArraySerializer);
+    void PostReplicatedChange(const struct FRAIReplicatedFacts& InArraySerializer);
+    void PreReplicatedRemove(const struct FRAIReplicatedFacts& InArraySerializer);
+};
+
+/**
+ * Delta replicated list of every fact of a knowledge component. Only added and removed facts are sent,
+ * batched per net update, and clients mirror them into the indexed storage of the component.
+ */
+USTRUCT()
+struct FRAIReplicatedFacts : public FFastArraySerializer
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+    TArray<FRAIReplicatedFact> Items;
+
+    URAIKnowledgeComponent* Owner = nullptr;
+
+    void PostReplicatedReceive(const FFastArraySerializer::FPostReplicatedReceiveParameters& Parameters);
+
+    bool NetDeltaSerialize(FNetDeltaSerializeInfo& DeltaParams)
+    {
+        return FastArrayDeltaSerialize<FRAIReplicatedFact, FRAIReplicatedFacts>(Items, DeltaParams, *this);
+    }
+};
+
+template<>
+struct TStructOpsTypeTraits<FRAIReplicatedFacts> : public TStructOpsTypeTraitsBase2<FRAIReplicatedFacts>
+{
+    enum
+    {
+        WithNetDeltaSerializer = true,
+    };
+};
+
+/**
+ * Indexed relationship facts about a set of actors. Used by every knowledge component for its own facts and by
+ * URAIKnowledgeSubsystem for the facts shared by a knowledge group.
+ */
+struct RANCPRIORITYTASKAI_API FRAIKnowledgeStore
+{
+    // Relations and categories past this many distinct tags are found by scanning the facts instead of by bit.
+    static constexpr int32 MaxIndexedTags = 64;
+
+    // Facts about one actor, plus a bit per relation and category tag they contain.
+    struct FKnownActor
+    {
+        TArray<FRelationshipFact> Facts;
+        uint64 RelationMask = 0;
+        uint64 CategoryMask = 0;
+    };
+
+    // Facts keyed by the actor they are about.
+    TMap<TWeakObjectPtr<AActor>, FKnownActor> KnownActors;
+
+    // Bit of every relation and category tag seen so far, INDEX_NONE once MaxIndexedTags is reached.
+    TMap<FGameplayTag, int32> TagBits;
+    int32 NextTagBit = 0;
+
+    const FKnownActor* Find(const AActor* Actor) const;
+    FKnownActor* Find(const AActor* Actor) { return const_cast<FKnownActor*>(static_cast<const FRAIKnowledgeStore*>(this)->Find(Actor)); }
+
+    bool HasRelation(const FKnownActor& Known, FGameplayTag Relation) const;
+    bool HasCategory(const FKnownActor& Known, FGameplayTag Category) const;
+
+    // Adds the fact under FactId and returns it, ExpireTime is left to the caller.
+    FRelationshipFact& Add(FKnownActor& Known, const FRelationshipFact& RelationshipFact, uint32 FactId);
+    void RebuildMasks(FKnownActor& Known);
+
+private:
+    int32 FindOrAddTagBit(FGameplayTag Tag);
 };
 
+struct FRAISharedKnowledge;
+class URAIKnowledgeSubsystem;
+
+DECLARE_MULTICAST_DELEGATE(FRAIKnowledgeChangedEvent);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FRAIFactExpiredEvent, AActor*, Actor, const FRelationshipFact&, Fact);
+
 /**
  * Actor Component for handling AI knowledge, focusing on relationships.
+ * Facts with a TotalDuration or RemainingDuration expire on their own, see URAIKnowledgeSubsystem.
+ * Facts are changed on the server and delta replicated to clients according to Replication.
+ * A component in a KnowledgeGroup reads through to the facts shared by the group. Changing the facts about an actor copies the
+ * group's facts about that actor first, from then on the component keeps its own view of that actor until RevertToGroupKnowledge.
+ * Groups only exist on the server and are not replicated, clients only see the component's own replicated facts.
  */
 UCLASS(Blueprintable, BlueprintType, ClassGroup=(RAI), meta=(BlueprintSpawnableComponent))
 class RANCPRIORITYTASKAI_API URAIKnowledgeComponent : public UActorComponent
@@ -40,14 +168,113 @@ class RANCPRIORITYTASKAI_API URAIKnowledgeComponent : public UActorComponent
 public:
     URAIKnowledgeComponent();
 
+    // Which clients receive the facts of this component. Change at runtime with SetKnowledgeReplication.
+    // Facts read through from the knowledge group are not replicated.
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Knowledge|Replication")
+    ERAIKnowledgeReplication Replication = ERAIKnowledgeReplication::Relevancy;
+
+    // Group whose shared facts this component reads through to, e.g. a faction. None to only use own facts.
+    // Server only, the group's facts are never replicated so queries on clients ignore it.
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Knowledge|Group")
+    FGameplayTag KnowledgeGroup;
+
+    // Server only.
+    UFUNCTION(BlueprintCallable, Category = "Knowledge|Replication")
+    void SetKnowledgeReplication(ERAIKnowledgeReplication NewReplication);
+
+    // Server only. Facts the component copied from its previous group are kept.
+    UFUNCTION(BlueprintCallable, Category = "Knowledge|Group")
+    void SetKnowledgeGroup(FGameplayTag NewGroup);
+
+    // Drops the own facts about Actor so the group's facts about it are used again. Server only.
+    UFUNCTION(BlueprintCallable, Category = "Knowledge|Group")
+    void RevertToGroupKnowledge(AActor* Actor);
+
+    // Whether queries read through to the facts of KnowledgeGroup. Always false on clients.
+    UFUNCTION(BlueprintPure, Category = "Knowledge|Group")
+    bool IsGroupKnowledgeAvailable() const { return SharedKnowledge.IsValid(); }
+
+    virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 protected:
-    // Map storing relationship facts for each actor.
-    TMap<AActor*, TArray<FRelationshipFact>> RelationshipFacts;
+    virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+    UPROPERTY(Replicated)
+    FRAIReplicatedFacts ReplicatedFacts;
+
+    // Index of each fact in ReplicatedFacts by FactId, server only.
+    TMap<uint32, int32> ReplicatedFactIndices;
+
+    // Set while applying a replicated batch, so OnKnowledgeChanged is broadcast once per batch.
+    bool ReplicatedKnowledgeChanged = false;
+
+    // Own facts. While in a group, an entry here hides the group's facts about that actor even when it has no facts left.
+    FRAIKnowledgeStore Store;
+
+    // Facts of KnowledgeGroup, owned by URAIKnowledgeSubsystem.
+    TSharedPtr<FRAISharedKnowledge> SharedKnowledge;
+
+    uint32 NextFactId = 1;
+
+    // Set by URAIKnowledgeSubsystem while this component is part of the current expiry batch.
+    bool ExpiryBroadcastPending = false;
+
+    friend class URAIKnowledgeSubsystem;
+    friend struct FRAIReplicatedFact;
+    friend struct FRAIReplicatedFacts;
+
+    using FKnownActor = FRAIKnowledgeStore::FKnownActor;
+
+    URAIKnowledgeSubsystem* GetKnowledgeSubsystem() const;
+
+    // The store answering queries about Actor, own facts first, then the group's.
+    const FRAIKnowledgeStore* ResolveStore(const AActor* Actor, const FKnownActor*& OutKnown) const;
+    const FKnownActor* FindKnownActor(const AActor* Actor) const;
+    bool MatchesQuery(const AActor* Actor, FGameplayTag Relation, FGameplayTag Category) const;
+
+    // Own entry of Actor, created on first use from a copy of the group's facts about it. Nullptr without any facts to start from when Create is false.
+    FKnownActor* FindOwnKnownActor(AActor* Actor, bool Create);
+    void ForgetActor(AActor* Actor);
+    void AddRegard(AActor* Actor, const FRelationshipFact& Fact);
+    void RemoveRegard(AActor* Actor, const FRelationshipFact& Fact);
+    void OnFactsRemoved(AActor* Actor, FKnownActor& Known);
+
+    // Removes a timed out fact without broadcasting OnKnowledgeChanged, returns false if it was already removed.
+    bool ExpireFact(AActor* Actor, uint32 FactId);
+
+    bool UnindexFact(AActor* Actor, uint32 FactId);
+    void ScheduleExpiry(AActor* Actor, FRelationshipFact& Fact);
+
+    // Changes made on the server, mirrored to clients through ReplicatedFacts.
+    void AddRelationAuthority(AActor* Actor, const FRelationshipFact& RelationshipFact);
+    void RemoveRelationAuthority(AActor* Actor, FGameplayTag Relation);
+    void RemoveAllRelationsOfCategoryAuthority(AActor* Actor, FGameplayTag Category);
+
+    ELifetimeCondition GetReplicationCondition() const;
+    void AddReplicatedFact(AActor* Actor, const FRelationshipFact& Fact);
+    void RemoveReplicatedFact(uint32 FactId);
+    void OnReplicatedFactAdded(FRAIReplicatedFact& Item);
+    void OnReplicatedFactRemoved(const FRAIReplicatedFact& Item);
+    void OnReplicatedFactsReceived();
+
+    // Forwarded by URAIKnowledgeSubsystem, which binds to the end of play of every known actor once.
+    void OnKnownActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
 
 public:
+    // Broadcast natively whenever a relationship fact is added or removed, including the facts of the knowledge group.
+    FRAIKnowledgeChangedEvent OnKnowledgeChanged;
+
+    // Broadcast when one of the component's own facts is removed because its duration ran out, before OnKnowledgeChanged.
+    UPROPERTY(BlueprintAssignable, Category = "Knowledge|Relationships")
+    FRAIFactExpiredEvent OnFactExpired;
+
     // Blueprint-accessible methods.
-    UFUNCTION(BlueprintCallable, Category = "Knowledge|Relationships")
-    bool HasRelation(AActor* Actor, FGameplayTag Relation);
+    UFUNCTION(BlueprintCallable, BlueprintPure = false, Category = "Knowledge|Relationships")
+    bool HasRelation(const AActor* Actor, FGameplayTag Relation) const;
+
+    UFUNCTION(BlueprintCallable, BlueprintPure = false, Category = "Knowledge|Relationships")
+    bool HasRelationOfCategory(const AActor* Actor, FGameplayTag Category) const;
 
     UFUNCTION(BlueprintCallable, Category = "Knowledge|Relationships")
     TArray<FRelationshipFact> GetAllRelations(AActor* Actor);
@@ -55,31 +282,51 @@ public:
     UFUNCTION(BlueprintCallable, Category = "Knowledge|Relationships")
     TArray<FRelationshipFact> GetAllRelationsOfCategory(AActor* Actor, FGameplayTag Category);
 
+    // Native queries, these never allocate on their own.
+
+    // The facts about Actor, valid until the knowledge changes. RemainingDuration is as of when each fact was added, use GetRemainingDuration.
+    TArrayView<const FRelationshipFact> GetRelationsView(const AActor* Actor) const;
+
+    // Replaces the contents of OutFacts with the facts of a category about Actor, reusing its allocation.
+    void GetRelationsOfCategory(const AActor* Actor, FGameplayTag Category, TArray<FRelationshipFact>& OutFacts) const;
+
+    // Replaces the contents of OutActors with every actor a fact is known about.
+    void GetKnownActors(TArray<AActor*>& OutActors) const;
+
+    // Seconds until the fact expires, or its RemainingDuration if it does not.
+    float GetRemainingDuration(const FRelationshipFact& Fact) const;
+
+    // Spatial queries over the known actors, answered by the grid of URAIKnowledgeSubsystem.
+    // An empty Relation or Category matches any, a MaxRadius of 0 is unlimited.
+
+    // Replaces the contents of OutActors with the known actors within Radius of Origin.
+    void QueryKnownActorsInRadius(const FVector& Origin, float Radius, FGameplayTag Relation, FGameplayTag Category, TArray<AActor*>& OutActors) const;
+
+    // Replaces the contents of OutActors with up to Count known actors, nearest to Origin first.
+    void QueryNearestKnownActors(const FVector& Origin, int32 Count, float MaxRadius, FGameplayTag Relation, FGameplayTag Category, TArray<AActor*>& OutActors) const;
+
+    UFUNCTION(BlueprintCallable, BlueprintPure = false, Category = "Knowledge|Spatial")
+    TArray<AActor*> FindKnownActorsInRadius(FVector Origin, float Radius, FGameplayTag Relation, FGameplayTag Category) const;
+
+    UFUNCTION(BlueprintCallable, BlueprintPure = false, Category = "Knowledge|Spatial")
+    AActor* FindNearestKnownActor(FVector Origin, FGameplayTag Relation, FGameplayTag Category, float MaxRadius = 0.f) const;
+
     UFUNCTION(BlueprintCallable, Category = "Knowledge|Relationships")
     void AddRelation(AActor* Actor, const FRelationshipFact& RelationshipFact);
 
-    UFUNCTION(NetMulticast, Reliable)
-    void AddRelationMulticast(AActor* Actor, const FRelationshipFact& RelationshipFact);
-
     UFUNCTION(Server, Reliable)
     void ServerAddRelation(AActor* Actor, const FRelationshipFact& RelationshipFact);
 
     UFUNCTION(BlueprintCallable, Category = "Knowledge|Relationships")
     void RemoveRelation(AActor* Actor, FGameplayTag Relation);
 
-    UFUNCTION(NetMulticast, Reliable)
-    void RemoveRelationMulticast(AActor* Actor, FGameplayTag Relation);
-
     UFUNCTION(Server, Reliable)
     void ServerRemoveRelation(AActor* Actor, FGameplayTag Relation);
 
     UFUNCTION(BlueprintCallable, Category = "Knowledge|Relationships")
     void RemoveAllRelationsOfCategory(AActor* Actor, FGameplayTag Category);
 
-    UFUNCTION(NetMulticast, Reliable)
-    void RemoveAllRelationsOfCategoryMulticast(AActor* Actor, FGameplayTag Category);
-
     UFUNCTION(Server, Reliable)
     void ServerRemoveAllRelationsOfCategory(AActor* Actor, FGameplayTag Category);
 
-};
\ No newline at end of file
+};
@@ -0,0 +1,230 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "SubSystems/RAIKnowledgeComponent.h"
+#include "RAIKnowledgeSubsystem.generated.h"
+
+/* Facts shared by every knowledge component of a knowledge group */
+struct FRAISharedKnowledge
+{
+	FGameplayTag Group;
+	FRAIKnowledgeStore Store;
+	TArray<TWeakObjectPtr<URAIKnowledgeComponent>> Members;
+	uint32 NextFactId = 1;
+	/* Set while the group is part of the current expiry batch */
+	bool ExpiryBroadcastPending = false;
+};
+
+/**
+ * Expires timed knowledge facts of every URAIKnowledgeComponent in the world.
+ * Facts are kept on a hierarchical timing wheel, so scheduling is constant time and a frame only touches the facts that
+ * are due, no matter how many are waiting. Everything due in a frame is expired in one batch, and each affected component
+ * broadcasts OnKnowledgeChanged once.
+ * Also owns the knowledge groups, facts stored once per group, e.g. a faction, that every member component reads through to.
+ * Groups are server only and not replicated, on clients they are empty.
+ * Keeps a uniform grid over every actor any component or group knows facts about, for radius and nearest queries. An actor
+ * changes cell from the transform update of its root component, so still actors cost nothing.
+ * Each indexed actor is bound to once for its end of play, which is forwarded to the groups and components that know it.
+ * A reverse index from target actor and relation to the components holding that relation answers "who regards X as Y".
+ */
+UCLASS(Config = RancPriorityTaskAI)
+class RANCPRIORITYTASKAI_API URAIKnowledgeSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+//*************************************************************************
+//* Configuration
+//*************************************************************************
+
+	/* Length in seconds of one step of the timing wheel. Facts expire up to this much later than their duration, never earlier */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "RAI|Knowledge", meta = (ClampMin = "0.01"))
+	float ExpiryResolution = 0.1f;
+
+	/* Edge length in cm of a cell of the spatial index over known actors. Roughly the typical query radius works well */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "RAI|Knowledge", meta = (ClampMin = "100.0"))
+	float SpatialCellSize = 1000.f;
+
+//*************************************************************************
+//* Status
+//*************************************************************************
+
+	/* Number of facts that expired during the last frame */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Knowledge")
+	int32 FactsExpiredLastFrame = 0;
+
+	/* Number of expiries on the wheel, including those of facts that were already removed by hand */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Knowledge")
+	int32 ScheduledExpiryCount = 0;
+
+	/* Number of indexed actors that changed cell during the last frame */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Knowledge")
+	int32 ActorsMovedLastFrame = 0;
+
+//*************************************************************************
+//* Methods
+//*************************************************************************
+
+	/* Called by URAIKnowledgeComponent when a fact with a duration is added, no need to call manually */
+	void ScheduleExpiry(URAIKnowledgeComponent* Knowledge, AActor* Actor, uint32 FactId, double ExpireTime);
+
+	/* Called by URAIKnowledgeComponent for its KnowledgeGroup, no need to call manually */
+	TSharedPtr<FRAISharedKnowledge> JoinKnowledgeGroup(URAIKnowledgeComponent* Knowledge, FGameplayTag Group);
+
+	void LeaveKnowledgeGroup(URAIKnowledgeComponent* Knowledge, FGameplayTag Group);
+
+	/* Adds a fact every member of the group knows, unless a member has its own facts about the actor. Server only */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Knowledge")
+	void AddGroupRelation(FGameplayTag Group, AActor* Actor, const FRelationshipFact& RelationshipFact);
+
+	UFUNCTION(BlueprintCallable, Category = "RAI|Knowledge")
+	void RemoveGroupRelation(FGameplayTag Group, AActor* Actor, FGameplayTag Relation);
+
+	UFUNCTION(BlueprintCallable, Category = "RAI|Knowledge")
+	void RemoveAllGroupRelationsOfCategory(FGameplayTag Group, AActor* Actor, FGameplayTag Category);
+
+	/* Always false on clients, groups are not replicated */
+	UFUNCTION(BlueprintPure, Category = "RAI|Knowledge")
+	bool HasGroupRelation(FGameplayTag Group, const AActor* Actor, FGameplayTag Relation) const;
+
+	/* Shared facts of a group, nullptr if nothing was ever added to or joined the group */
+	const FRAIKnowledgeStore* GetGroupKnowledge(FGameplayTag Group) const;
+
+	/* Called by knowledge components and groups for every actor they know facts about, an actor stays indexed while any of them does.
+	 * Holder is the knowledge component, nullptr for a group. Holders are told when the actor ends play */
+	void AddIndexedActor(AActor* Actor, URAIKnowledgeComponent* Holder = nullptr);
+
+	void RemoveIndexedActor(AActor* Actor, URAIKnowledgeComponent* Holder = nullptr);
+
+	UFUNCTION(BlueprintPure, Category = "RAI|Knowledge")
+	int32 GetIndexedActorCount() const { return IndexedActors.Num(); }
+
+	/* Appends every indexed actor within Radius of Origin that passes Filter */
+	void GatherActorsInRadius(const FVector& Origin, float Radius, TFunctionRef<bool(const AActor*)> Filter, TArray<AActor*>& OutActors) const;
+
+	/* Replaces the contents of OutActors with up to Count indexed actors that pass Filter, nearest first. A MaxRadius of 0 is unlimited */
+	void GatherNearestActors(const FVector& Origin, int32 Count, float MaxRadius, TFunctionRef<bool(const AActor*)> Filter, TArray<AActor*>& OutActors) const;
+
+	/* Called by URAIKnowledgeComponent once per fact it holds, no need to call manually */
+	void AddRegard(URAIKnowledgeComponent* Knowledge, const AActor* Target, FGameplayTag Relation);
+
+	void RemoveRegard(URAIKnowledgeComponent* Knowledge, const AActor* Target, FGameplayTag Relation);
+
+	/* Replaces the contents of OutKnowledge with every knowledge component that has Relation with Target, own or through its group.
+	 * Costs one lookup plus the size of the result, and one check per member of each group holding the relation */
+	void GetKnowledgeRegarding(const AActor* Target, FGameplayTag Relation, TArray<URAIKnowledgeComponent*>& OutKnowledge) const;
+
+	/* Owners of the knowledge components that have Relation with Target, e.g. every AI controller that regards the player as hostile */
+	UFUNCTION(BlueprintCallable, BlueprintPure = false, Category = "RAI|Knowledge")
+	TArray<AActor*> GetAgentsRegarding(AActor* Target, FGameplayTag Relation) const;
+
+	//~ UTickableWorldSubsystem
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	//*************************************************************************
+	//* Private
+	//*************************************************************************
+private:
+
+	/* Each level has 64 slots, a slot of level L spans 64^L steps. Four levels cover 64^4 steps, about 19 days at 0.1 seconds */
+	static constexpr int32 SlotBits = 6;
+	static constexpr int32 SlotsPerLevel = 1 << SlotBits;
+	static constexpr int32 WheelLevels = 4;
+
+	/* Expiry of a fact of either a knowledge component or a knowledge group */
+	struct FExpiryEntry
+	{
+		TWeakObjectPtr<URAIKnowledgeComponent> Knowledge;
+		TWeakPtr<FRAISharedKnowledge> SharedKnowledge;
+		TWeakObjectPtr<AActor> Actor;
+		uint32 FactId = 0;
+		uint64 DueStep = 0;
+	};
+
+	TArray<FExpiryEntry> Slots[WheelLevels * SlotsPerLevel];
+
+	/* Entries due this frame, expired in one batch after the wheel has advanced */
+	TArray<FExpiryEntry> DueEntries;
+	/* Swapped with a slot while it cascades, since top level entries beyond the wheel range may land in the same slot again */
+	TArray<FExpiryEntry> CascadeScratch;
+	/* Components and groups that lost facts this frame and still have to broadcast OnKnowledgeChanged */
+	TArray<URAIKnowledgeComponent*> ChangedKnowledge;
+	TArray<FRAISharedKnowledge*> ChangedGroups;
+
+	TMap<FGameplayTag, TSharedPtr<FRAISharedKnowledge>> KnowledgeGroups;
+
+	struct FIndexedActor
+	{
+		FIntPoint Cell = FIntPoint::ZeroValue;
+		int32 References = 0;
+		/* Knowledge components with own facts about the actor, told when it ends play */
+		TSet<TWeakObjectPtr<URAIKnowledgeComponent>> Holders;
+		/* Root component whose TransformUpdated moves the actor between cells */
+		TWeakObjectPtr<USceneComponent> Root;
+		FDelegateHandle MovedHandle;
+	};
+
+	TMap<TWeakObjectPtr<AActor>, FIndexedActor> IndexedActors;
+	/* Actors of each cell on the XY plane. Weak, an actor collected without ending play stays until the next garbage collection */
+	TMap<FIntPoint, TArray<TWeakObjectPtr<AActor>>> Cells;
+	/* SpatialCellSize as read at initialization */
+	float CellSize = 1000.f;
+	int32 ActorsMovedThisFrame = 0;
+	FDelegateHandle PostGarbageCollectHandle;
+
+	struct FRegardKey
+	{
+		TObjectKey<AActor> Target;
+		FGameplayTag Relation;
+
+		FRegardKey(const AActor* InTarget, FGameplayTag InRelation) : Target(InTarget), Relation(InRelation) {}
+
+		bool operator==(const FRegardKey& Other) const { return Target == Other.Target && Relation == Other.Relation; }
+		friend uint32 GetTypeHash(const FRegardKey& Key) { return HashCombineFast(GetTypeHash(Key.Target), GetTypeHash(Key.Relation)); }
+	};
+
+	/* Holders of one relation with one target, counted per fact. Group members are resolved at query time */
+	struct FRegard
+	{
+		TMap<URAIKnowledgeComponent*, int32> Knowledge;
+		TMap<FRAISharedKnowledge*, int32> Groups;
+	};
+
+	TMap<FRegardKey, FRegard> Regards;
+
+	/* ExpiryResolution as read at initialization, changing the step length would invalidate every scheduled slot */
+	double StepSeconds = 0.1;
+	uint64 CurrentStep = 0;
+
+	void ScheduleEntry(FExpiryEntry&& Entry, double ExpireTime);
+	void InsertEntry(FExpiryEntry&& Entry);
+	void AdvanceStep();
+	void ExpireDueEntries();
+
+	FIntPoint GetCell(const FVector& Location) const;
+	void OnIndexedComponentMoved(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+	void RemoveCollectedActors();
+
+	FRAISharedKnowledge& FindOrAddGroup(FGameplayTag Group);
+	bool ExpireGroupFact(FRAISharedKnowledge& SharedKnowledge, AActor* Actor, uint32 FactId);
+	void OnGroupFactsRemoved(FRAISharedKnowledge& SharedKnowledge, AActor* Actor, FRAIKnowledgeStore::FKnownActor& Known);
+	void BroadcastGroupChanged(FRAISharedKnowledge& SharedKnowledge);
+	void AddGroupRegard(FRAISharedKnowledge& SharedKnowledge, const AActor* Target, FGameplayTag Relation);
+	void RemoveGroupRegard(FRAISharedKnowledge& SharedKnowledge, const AActor* Target, FGameplayTag Relation);
+
+	void RemoveActorFromGroups(AActor* Actor);
+
+	UFUNCTION()
+	void OnIndexedActorEndPlay(AActor* Actor, EEndPlayReason::Type EndPlayReason);
+};
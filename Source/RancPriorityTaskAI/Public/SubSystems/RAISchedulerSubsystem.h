@@ -0,0 +1,149 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "RAIPriorityBatch.h"
+#include "RAISchedulerSubsystem.generated.h"
+
+class URAIManagerComponent;
+
+/**
+ * Drives UpdateActiveTasks for every registered RAI manager in the world.
+ * Managers are updated round-robin under a fixed milliseconds-per-frame budget so the AI cost per frame stays flat
+ * regardless of agent count. Managers that must update this frame can be pushed onto the priority lane with RequestUrgentUpdate.
+ * Agents are also sorted into a near and a distant simulation field by distance to the closest player view,
+ * each field with its own update rate, scoring and perception settings.
+ */
+UCLASS(Config = RancPriorityTaskAI)
+class RANCPRIORITYTASKAI_API URAISchedulerSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	URAISchedulerSubsystem();
+
+//*************************************************************************
+//* Configuration
+//*************************************************************************
+
+	/* How many milliseconds per frame the scheduler may spend updating agents. At least one agent is always updated per frame. */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Scheduler", meta = (ClampMin = "0.01"))
+	float FrameBudgetMs = 1.0f;
+
+	/* Score the primary tasks of all agents updated this frame in parallel on worker threads.
+	 * Inputs are snapshot on the game thread first, and starting or interrupting tasks is committed on the game thread afterwards. */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Scheduler")
+	bool ParallelScoring = false;
+
+	/* Assign agents to the near or distant field by distance to the closest player view. When disabled every agent is near field */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Fields")
+	bool UseSimulationFields = false;
+
+	/* Agents closer than this to a player view are promoted to the near field */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Fields", meta = (ClampMin = "0.0"))
+	float NearFieldRadius = 5000.f;
+
+	/* Near field agents are only demoted once they are NearFieldRadius + FieldHysteresis away, so agents on the border do not flip every pass */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Fields", meta = (ClampMin = "0.0"))
+	float FieldHysteresis = 1000.f;
+
+	/* Seconds between two field assignment passes */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Fields", meta = (ClampMin = "0.0"))
+	float FieldAssignmentInterval = 1.f;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Fields")
+	FRAIFieldSettings NearFieldSettings;
+
+	UPROPERTY(Config, EditAnywhere, BlueprintReadWrite, Category = "RAI|Fields")
+	FRAIFieldSettings DistantFieldSettings;
+
+//*************************************************************************
+//* Status
+//*************************************************************************
+
+	/* Running average of the time in seconds agents waited between two scheduled updates */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Scheduler")
+	float AverageUpdateWait = 0.f;
+
+	/* Longest time in seconds an agent waited between two scheduled updates */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Scheduler")
+	float MaxUpdateWait = 0.f;
+
+	/* Number of agents updated during the last frame, including the priority lane */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Scheduler")
+	int32 AgentsUpdatedLastFrame = 0;
+
+	/* Number of agents in each field after the last field assignment pass */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Fields")
+	int32 NearFieldAgentCount = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Fields")
+	int32 DistantFieldAgentCount = 0;
+
+//*************************************************************************
+//* Methods
+//*************************************************************************
+
+	/* Called by URAIManagerComponent::Initialize, no need to call manually */
+	void RegisterManager(URAIManagerComponent* Manager);
+
+	void UnregisterManager(URAIManagerComponent* Manager);
+
+	/* Update the manager this frame regardless of the frame budget. Ignored for managers the scheduler does not update */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Scheduler")
+	void RequestUrgentUpdate(URAIManagerComponent* Manager);
+
+	/* Resets AverageUpdateWait and MaxUpdateWait */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Scheduler")
+	void ResetWaitStatistics();
+
+	UFUNCTION(BlueprintPure, Category = "RAI|Scheduler")
+	int32 GetRegisteredManagerCount() const { return Managers.Num(); }
+
+	const FRAIFieldSettings& GetFieldSettings(ERAIField Field) const;
+
+	/* Run a field assignment pass next tick instead of waiting for FieldAssignmentInterval, e.g. after a player teleported */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Fields")
+	void RequestFieldAssignment() { LastFieldAssignmentTime = -1.0; }
+
+	//~ UTickableWorldSubsystem
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	//*************************************************************************
+	//* Private
+	//*************************************************************************
+private:
+
+	TArray<TWeakObjectPtr<URAIManagerComponent>> Managers;
+	TArray<TWeakObjectPtr<URAIManagerComponent>> UrgentManagers;
+
+	/* Agents collected for a parallel update this frame */
+	TArray<TWeakObjectPtr<URAIManagerComponent>> ParallelAgents;
+	FRAIPriorityBatch PriorityBatch;
+	/* Running estimate of the cost of one agent update in a parallel batch, used to size the batch to the budget */
+	double EstimatedParallelAgentSeconds = 0.00001;
+
+	double LastFieldAssignmentTime = -1.0;
+	/* Scratch list of player view locations, kept to avoid reallocating every assignment pass */
+	TArray<FVector> ViewLocations;
+
+	int32 NextManagerIndex = 0;
+	bool IsTicking = false;
+	bool HasStaleEntries = false;
+
+	bool IsScheduled(const URAIManagerComponent* Manager) const;
+	bool IsDueForUpdate(const URAIManagerComponent* Manager, double WorldTime) const;
+	void RecordUpdate(URAIManagerComponent* Manager, double WorldTime);
+	void UpdateManager(URAIManagerComponent* Manager, double WorldTime);
+	void TickSequential(double WorldTime);
+	void TickParallel(double WorldTime);
+	void RemoveStaleEntries();
+	void AssignSimulationFields(double WorldTime);
+};
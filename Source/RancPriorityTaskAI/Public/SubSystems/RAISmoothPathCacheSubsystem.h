@@ -0,0 +1,142 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/LruCache.h"
+#include "AI/Navigation/NavigationTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "UObject/ObjectKey.h"
+#include "RAISmoothPathCacheSubsystem.generated.h"
+
+class ANavigationData;
+class UNavigationQueryFilter;
+
+/* Identifies a smooth path by where it starts and ends, the navigation it was found on and the parameters that shaped the curve */
+struct FRAISmoothPathKey
+{
+	/* Start and goal snapped to PositionQuantization, heading snapped to HeadingQuantization */
+	FIntVector Start = FIntVector::ZeroValue;
+	FIntVector Goal = FIntVector::ZeroValue;
+	int32 Heading = 0;
+
+	TObjectKey<ANavigationData> NavData;
+	TObjectKey<UClass> Filter;
+	bool AllowPartialPath = false;
+
+	float CurveAngleThreshold = 0.f;
+	int32 MaxCurveSegments = 0;
+	float MinCurveSegmentLength = 0.f;
+
+	bool operator==(const FRAISmoothPathKey& Other) const
+	{
+		return Start == Other.Start && Goal == Other.Goal && Heading == Other.Heading && NavData == Other.NavData
+			&& Filter == Other.Filter && AllowPartialPath == Other.AllowPartialPath && CurveAngleThreshold == Other.CurveAngleThreshold
+			&& MaxCurveSegments == Other.MaxCurveSegments && MinCurveSegmentLength == Other.MinCurveSegmentLength;
+	}
+
+	friend uint32 GetTypeHash(const FRAISmoothPathKey& Key)
+	{
+		uint32 Hash = HashCombineFast(GetTypeHash(Key.Start), GetTypeHash(Key.Goal));
+		Hash = HashCombineFast(Hash, GetTypeHash(Key.Heading));
+		Hash = HashCombineFast(Hash, GetTypeHash(Key.NavData));
+		Hash = HashCombineFast(Hash, GetTypeHash(Key.Filter));
+		Hash = HashCombineFast(Hash, GetTypeHash(Key.CurveAngleThreshold));
+		Hash = HashCombineFast(Hash, GetTypeHash(Key.MaxCurveSegments));
+		return HashCombineFast(Hash, GetTypeHash(Key.MinCurveSegmentLength));
+	}
+};
+
+/**
+ * Caches the smooth paths generated by ARAIController, for agents that keep requesting the same curve, e.g. between patrol
+ * points or out of a spawn area. The least recently used paths are evicted past MaxEntries or MaxMemoryKB.
+ * Everything is dropped whenever the navigation system finishes rebuilding navmesh tiles, so a cached path is never older
+ * than the navmesh it was found on.
+ */
+UCLASS(Config = RancPriorityTaskAI)
+class RANCPRIORITYTASKAI_API URAISmoothPathCacheSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+//*************************************************************************
+//* Configuration
+//*************************************************************************
+
+	/* Grid in cm that start and goal are snapped to. Agents starting and ending within the same cells share a path */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "RAI|Smooth Path", meta = (ClampMin = "1.0"))
+	float PositionQuantization = 50.f;
+
+	/* Step in degrees the start heading is snapped to */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "RAI|Smooth Path", meta = (ClampMin = "1.0", ClampMax = "90.0"))
+	float HeadingQuantization = 15.f;
+
+	/* Maximum number of cached paths */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "RAI|Smooth Path", meta = (ClampMin = "1"))
+	int32 MaxEntries = 1024;
+
+	/* Maximum memory in KB of the cached paths, including their points */
+	UPROPERTY(Config, EditAnywhere, BlueprintReadOnly, Category = "RAI|Smooth Path", meta = (ClampMin = "1"))
+	int32 MaxMemoryKB = 1024;
+
+//*************************************************************************
+//* Status
+//*************************************************************************
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Smooth Path")
+	int32 CacheHits = 0;
+
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Smooth Path")
+	int32 CacheMisses = 0;
+
+	/* Number of times the cache was invalidated, also counted while empty. A path found across a change must not be added */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Transient, Category = "RAI|Smooth Path")
+	int32 Invalidations = 0;
+
+//*************************************************************************
+//* Methods
+//*************************************************************************
+
+	/* Key of the smooth path from Start facing Forward to Goal, on NavData with Filter, curved with the given parameters */
+	FRAISmoothPathKey MakeKey(const FVector& Start, const FVector& Forward, const FVector& Goal, const ANavigationData& NavData,
+	                          TSubclassOf<UNavigationQueryFilter> Filter, bool AllowPartialPath,
+	                          float CurveAngleThreshold, int32 MaxCurveSegments, float MinCurveSegmentLength) const;
+
+	/* A new path with the cached points, its first and last point moved to Start and Goal. Null if nothing is cached for Key */
+	FNavPathSharedPtr FindPath(const FRAISmoothPathKey& Key, const ANavigationData& NavData, const FVector& Start, const FVector& Goal);
+
+	/* Caches a copy of the points of Path, evicting the least recently used paths to stay within MaxEntries and MaxMemoryKB */
+	void AddPath(const FRAISmoothPathKey& Key, const FNavigationPath& Path);
+
+	/* Drops every cached path */
+	UFUNCTION(BlueprintCallable, Category = "RAI|Smooth Path")
+	void InvalidateAll();
+
+	//~ UWorldSubsystem
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+	//*************************************************************************
+	//* Private
+	//*************************************************************************
+private:
+
+	struct FCachedPath
+	{
+		TArray<FNavPathPoint> Points;
+		bool IsPartial = false;
+		/* Memory of the entry, counted against MaxMemoryKB */
+		int64 Bytes = 0;
+	};
+
+	UFUNCTION()
+	void OnNavigationGenerationFinished(ANavigationData* NavData);
+
+	TLruCache<FRAISmoothPathKey, FCachedPath> Paths;
+	int64 MemoryUsed = 0;
+};
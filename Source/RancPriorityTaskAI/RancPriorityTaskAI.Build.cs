@@ -15,7 +15,8 @@ public class RancPriorityTaskAI : ModuleRules
 				"AIModule",
 				"RancUtilities",
 				"AIModule",
-				"NavigationSystem"
+				"NavigationSystem",
+				"NetCore"
 			}
 			);
 			
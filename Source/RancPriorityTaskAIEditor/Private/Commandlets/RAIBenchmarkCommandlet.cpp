@@ -0,0 +1,496 @@
+// Copyright Rancorous Games, 2024
+
+#include "Commandlets/RAIBenchmarkCommandlet.h"
+
+#include "RAIConsiderationSet.h"
+#include "RAIController.h"
+#include "RAIDecisionRecorder.h"
+#include "RAIEditorLogCategory.h"
+#include "RAIManagerComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Character.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/LowLevelMemTracker.h"
+#include "HAL/MemoryBase.h"
+#include "HAL/PlatformTime.h"
+#include "Misc/FileHelper.h"
+#include "Perception/AISense_Sight.h"
+#include "UObject/UObjectGlobals.h"
+
+static int64 GRAIBenchmarkTaskBegins = 0;
+
+void URAIBenchmarkTask::StepBenchmark()
+{
+	if (!GetIsTaskActive() || ChildInvokedTask)
+	{
+		return;
+	}
+
+	// A task whose invoked task returned is done, the last task of the chain runs for ActiveUpdates
+	if (NextInChain.IsValid() || --RemainingUpdates <= 0)
+	{
+		EndTask(true);
+	}
+}
+
+void URAIBenchmarkTask::BeginTask_Implementation(const FRAITaskInvokeArguments& InvokeArguments)
+{
+	Super::BeginTask_Implementation(InvokeArguments);
+	GRAIBenchmarkTaskBegins++;
+	RemainingUpdates = ActiveUpdates;
+
+	if (!NextInChain.IsValid() || !InvokeTaskByHandle(NextInChain, InvokeArguments))
+	{
+		SetIsWaiting(true);
+	}
+}
+
+void URAIBenchmarkTask::OnPerceptionStimulus_Implementation(AActor* Actor, FAIStimulus Stimulus)
+{
+	StimuliReceived++;
+}
+
+/* Allocator calls of the whole process, counted by the allocator itself outside Shipping. Nothing else runs while measuring */
+static uint64 GetAllocationCalls()
+{
+#if !UE_BUILD_SHIPPING
+	return static_cast<uint64>(FMalloc::TotalMallocCalls) + static_cast<uint64>(FMalloc::TotalReallocCalls);
+#else
+	return 0;
+#endif
+}
+
+/* Agents are created and updated under this LLM tag, which keeps the pawns and the rest of the process out of their memory */
+#define RAI_BENCHMARK_LLM_TAG TEXT("RAIBenchmark")
+
+static bool IsMemoryTracked()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	return FLowLevelMemTracker::IsEnabled();
+#else
+	return false;
+#endif
+}
+
+/* Bytes currently allocated under RAI_BENCHMARK_LLM_TAG, 0 unless run with -llm */
+static int64 GetAgentMemory()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	if (IsMemoryTracked())
+	{
+		// Nothing ticks the engine here, the tag amounts are only published by the per frame update
+		FLowLevelMemTracker& Tracker = FLowLevelMemTracker::Get();
+		Tracker.UpdateStatsPerFrame();
+		return Tracker.GetTagAmountForTracker(ELLMTracker::Default, FName(RAI_BENCHMARK_LLM_TAG), ELLMTagSet::None);
+	}
+#endif
+	return 0;
+}
+
+struct FRAIBenchmarkSettings
+{
+	int32 TasksPerAgent = 8;
+	int32 ChainDepth = 2;
+	int32 ActiveUpdates = 5;
+	int32 WarmupUpdates = 20;
+	int32 MeasuredUpdates = 100;
+	int32 PerceptionEvery = 4;
+	float UpdateDelta = 0.1f;
+	bool Record = false;
+};
+
+struct FRAIBenchmarkResult
+{
+	int32 Agents = 0;
+	double NsPerUpdate = 0.0;
+	double AllocsPerUpdate = 0.0;
+	double PeakBytesPerAgent = 0.0;
+	double TaskBeginsPerUpdate = 0.0;
+};
+
+struct FRAIBenchmarkAgent
+{
+	ACharacter* Pawn = nullptr;
+	ARAIController* Controller = nullptr;
+	URAIManagerComponent* Manager = nullptr;
+};
+
+/* One consideration set per task slot, shared by all agents. The priorities differ per slot and grow while a task has not run,
+ * so tasks rotate and interrupt each other like a real AI */
+static TArray<URAIConsiderationSet*> CreateConsiderationSets(int32 TaskCount)
+{
+	TArray<URAIConsiderationSet*> Sets;
+	for (int32 TaskIndex = 0; TaskIndex < TaskCount; ++TaskIndex)
+	{
+		URAIConsiderationSet* Set = NewObject<URAIConsiderationSet>(GetTransientPackage());
+		Set->AddToRoot();
+		Set->CombineOperator = ERAIConsiderationCombine::Sum;
+
+		FRAIConsideration& Base = Set->Considerations.AddDefaulted_GetRef();
+		Base.Input = ERAIConsiderationInput::Constant;
+		Base.ResponseCurve.Slope = 0.f;
+		Base.ResponseCurve.YShift = 0.1f + 0.4f * TaskIndex / FMath::Max(TaskCount, 1);
+
+		FRAIConsideration& Waiting = Set->Considerations.AddDefaulted_GetRef();
+		Waiting.Input = ERAIConsiderationInput::TimeSinceTaskBegun;
+		Waiting.InputMax = 2.f + TaskIndex;
+		Waiting.ResponseCurve.Slope = 0.4f;
+
+		FRAIConsideration& Momentum = Set->Considerations.AddDefaulted_GetRef();
+		Momentum.Input = ERAIConsiderationInput::TaskIsActive;
+		Momentum.ResponseCurve.Slope = 0.1f;
+
+		Sets.Add(Set);
+	}
+
+	return Sets;
+}
+
+static URAIBenchmarkTask* AddBenchmarkTask(ARAIController* Controller, const FRAIBenchmarkSettings& Settings)
+{
+	URAIBenchmarkTask* Task = NewObject<URAIBenchmarkTask>(Controller);
+	Task->ActiveUpdates = Settings.ActiveUpdates;
+	Task->SetCooldown(0.5f);
+	Controller->AddInstanceComponent(Task);
+	Task->RegisterComponent();
+	return Task;
+}
+
+static FRAIBenchmarkAgent SpawnAgent(UWorld* World, ACharacter* Pawn, const TArray<URAIConsiderationSet*>& ConsiderationSets,
+                                     const FRAIBenchmarkSettings& Settings)
+{
+	FRAIBenchmarkAgent Agent;
+	Agent.Pawn = Pawn;
+
+	Agent.Controller = World->SpawnActorDeferred<ARAIController>(ARAIController::StaticClass(), FTransform::Identity);
+	Agent.Controller->AutoHandleSensoryInput = false;
+	Agent.Controller->MirrorThoughtsToArray = false;
+	Agent.Controller->FinishSpawning(FTransform::Identity);
+
+	Agent.Manager = NewObject<URAIManagerComponent>(Agent.Controller);
+	Agent.Manager->UpdatedByScheduler = false;
+	Agent.Controller->AddInstanceComponent(Agent.Manager);
+	Agent.Manager->RegisterComponent();
+
+	TArray<URAIBenchmarkTask*> PrimaryTasks;
+	for (URAIConsiderationSet* Set : ConsiderationSets)
+	{
+		URAIBenchmarkTask* Task = AddBenchmarkTask(Agent.Controller, Settings);
+		Task->Considerations = Set;
+		PrimaryTasks.Add(Task);
+	}
+
+	TArray<URAIBenchmarkTask*> ChainTasks;
+	for (int32 ChainIndex = 0; ChainIndex < Settings.ChainDepth; ++ChainIndex)
+	{
+		URAIBenchmarkTask* Task = AddBenchmarkTask(Agent.Controller, Settings);
+		Task->IsPrimaryTask = false;
+		ChainTasks.Add(Task);
+	}
+
+	Agent.Controller->Possess(Pawn);
+
+	// Handles are assigned by the manager, link the chains once it is initialized
+	if (ChainTasks.Num() > 0)
+	{
+		for (URAIBenchmarkTask* Task : PrimaryTasks)
+		{
+			Task->NextInChain = ChainTasks[0]->TaskHandle;
+		}
+
+		for (int32 ChainIndex = 0; ChainIndex + 1 < ChainTasks.Num(); ++ChainIndex)
+		{
+			ChainTasks[ChainIndex]->NextInChain = ChainTasks[ChainIndex + 1]->TaskHandle;
+		}
+	}
+
+	return Agent;
+}
+
+static FRAIBenchmarkResult RunBenchmark(UWorld* World, int32 AgentCount, const TArray<URAIConsiderationSet*>& ConsiderationSets,
+                                        const FRAIBenchmarkSettings& Settings)
+{
+	FActorSpawnParameters SpawnParameters;
+	SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+	// Pawns are spawned before the baseline is taken, they are not part of the AIs cost
+	TArray<ACharacter*> Pawns;
+	Pawns.Reserve(AgentCount);
+	for (int32 AgentIndex = 0; AgentIndex < AgentCount; ++AgentIndex)
+	{
+		const FVector Location((AgentIndex % 100) * 200.0, (AgentIndex / 100) * 200.0, 0.0);
+		Pawns.Add(World->SpawnActor<ACharacter>(ACharacter::StaticClass(), Location, FRotator::ZeroRotator, SpawnParameters));
+	}
+
+	AActor* StimulusSource = Pawns.Num() > 0 ? Pawns[0] : nullptr;
+
+	LLM_SCOPE_BYNAME(RAI_BENCHMARK_LLM_TAG);
+
+	const int64 BaselineMemory = GetAgentMemory();
+	int64 PeakMemory = BaselineMemory;
+
+	TArray<FRAIBenchmarkAgent> Agents;
+	Agents.Reserve(AgentCount);
+	for (ACharacter* Pawn : Pawns)
+	{
+		Agents.Add(SpawnAgent(World, Pawn, ConsiderationSets, Settings));
+	}
+
+	PeakMemory = FMath::Max(PeakMemory, GetAgentMemory());
+
+	// A sensed sight stimulus, as the controller forwards them from its perception component
+	const FVector StimulusLocation = StimulusSource ? StimulusSource->GetActorLocation() : FVector::ZeroVector;
+	const FAIStimulus Stimulus(*GetDefault<UAISense_Sight>(), 1.f, StimulusLocation, FVector::ZeroVector);
+
+	bool IsCounting = false;
+	uint64 Cycles = 0;
+	uint64 AllocationCallsAtStart = 0;
+	uint64 AllocationCalls = 0;
+	int64 TaskBeginsAtStart = 0;
+
+	const int32 TotalUpdates = Settings.WarmupUpdates + Settings.MeasuredUpdates;
+	for (int32 Update = 0; Update < TotalUpdates; ++Update)
+	{
+		if (Update == Settings.WarmupUpdates)
+		{
+			// Counted after the warmup so one time allocations of the first updates are not
+			IsCounting = true;
+			TaskBeginsAtStart = GRAIBenchmarkTaskBegins;
+		}
+
+		World->TimeSeconds += Settings.UpdateDelta;
+
+		const uint64 StartAllocationCalls = GetAllocationCalls();
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+
+		for (int32 AgentIndex = 0; AgentIndex < Agents.Num(); ++AgentIndex)
+		{
+			URAIManagerComponent* Manager = Agents[AgentIndex].Manager;
+			Manager->UpdateActiveTasks();
+
+			// Through the queue the controller uses, delivered at the start of the next update if the manager coalesces stimuli
+			if (Settings.PerceptionEvery > 0 && (Update + AgentIndex) % Settings.PerceptionEvery == 0)
+			{
+				Manager->QueuePerceptionStimulus(StimulusSource, Stimulus);
+			}
+
+			if (URAIBenchmarkTask* ActiveTask = Cast<URAIBenchmarkTask>(Manager->ActiveTask))
+			{
+				ActiveTask->StepBenchmark();
+			}
+		}
+
+		if (Update >= Settings.WarmupUpdates)
+		{
+			Cycles += FPlatformTime::Cycles64() - StartCycles;
+			AllocationCalls += GetAllocationCalls() - StartAllocationCalls;
+			PeakMemory = FMath::Max(PeakMemory, GetAgentMemory());
+		}
+
+		if (Settings.Record)
+		{
+			FRAIDecisionRecorder::Flush();
+		}
+	}
+
+	FRAIBenchmarkResult Result;
+	Result.Agents = AgentCount;
+
+	if (IsCounting)
+	{
+		const double AgentUpdates = static_cast<double>(AgentCount) * Settings.MeasuredUpdates;
+		Result.NsPerUpdate = FPlatformTime::ToSeconds64(Cycles) * 1e9 / AgentUpdates;
+		Result.AllocsPerUpdate = AllocationCalls / AgentUpdates;
+		Result.TaskBeginsPerUpdate = (GRAIBenchmarkTaskBegins - TaskBeginsAtStart) / AgentUpdates;
+	}
+
+	Result.PeakBytesPerAgent = AgentCount > 0 ? static_cast<double>(PeakMemory - BaselineMemory) / AgentCount : 0.0;
+
+	for (const FRAIBenchmarkAgent& Agent : Agents)
+	{
+		Agent.Controller->Destroy();
+	}
+
+	for (ACharacter* Pawn : Pawns)
+	{
+		Pawn->Destroy();
+	}
+
+	CollectGarbage(GARBAGE_COLLECTION_KEEPFLAGS, true);
+	return Result;
+}
+
+static FString ResultsToCsv(const TArray<FRAIBenchmarkResult>& Results)
+{
+	FString Csv = TEXT("Agents,NsPerUpdate,AllocsPerUpdate,PeakBytesPerAgent,TaskBeginsPerUpdate\n");
+	for (const FRAIBenchmarkResult& Result : Results)
+	{
+		Csv += FString::Printf(TEXT("%d,%.1f,%.3f,%.0f,%.3f\n"), Result.Agents, Result.NsPerUpdate, Result.AllocsPerUpdate,
+		                       Result.PeakBytesPerAgent, Result.TaskBeginsPerUpdate);
+	}
+	return Csv;
+}
+
+/* Returns the number of sizes that regressed compared to a csv written by an earlier run */
+static int32 CompareToBaseline(const FString& BaselinePath, const TArray<FRAIBenchmarkResult>& Results, float Tolerance)
+{
+	TArray<FString> Lines;
+	if (!FFileHelper::LoadFileToStringArray(Lines, *BaselinePath))
+	{
+		UE_LOG(LogRAIEditor, Error, TEXT("Could not read the benchmark baseline %s"), *BaselinePath);
+		return 1;
+	}
+
+	int32 Regressions = 0;
+	for (int32 LineIndex = 1; LineIndex < Lines.Num(); ++LineIndex)
+	{
+		TArray<FString> Columns;
+		if (Lines[LineIndex].ParseIntoArray(Columns, TEXT(",")) < 3)
+		{
+			continue;
+		}
+
+		const int32 Agents = FCString::Atoi(*Columns[0]);
+		const FRAIBenchmarkResult* Result = Results.FindByPredicate([Agents](const FRAIBenchmarkResult& Other) { return Other.Agents == Agents; });
+		if (!Result)
+		{
+			continue;
+		}
+
+		const double BaselineNs = FCString::Atod(*Columns[1]);
+		const double BaselineAllocs = FCString::Atod(*Columns[2]);
+
+		if (BaselineNs > 0.0 && Result->NsPerUpdate > BaselineNs * (1.0 + Tolerance))
+		{
+			UE_LOG(LogRAIEditor, Error, TEXT("%d agents: %.1f ns per update, baseline %.1f"), Agents, Result->NsPerUpdate, BaselineNs);
+			Regressions++;
+		}
+
+		// Allocation counts barely vary between runs, unlike timings, so the same tolerance catches real growth
+		if (Result->AllocsPerUpdate > BaselineAllocs * (1.0 + Tolerance) + 0.01)
+		{
+			UE_LOG(LogRAIEditor, Error, TEXT("%d agents: %.3f allocations per update, baseline %.3f"), Agents, Result->AllocsPerUpdate, BaselineAllocs);
+			Regressions++;
+		}
+	}
+
+	return Regressions;
+}
+
+URAIBenchmarkCommandlet::URAIBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 URAIBenchmarkCommandlet::Main(const FString& Params)
+{
+	FRAIBenchmarkSettings Settings;
+	FParse::Value(*Params, TEXT("Tasks="), Settings.TasksPerAgent);
+	FParse::Value(*Params, TEXT("ChainDepth="), Settings.ChainDepth);
+	FParse::Value(*Params, TEXT("ActiveUpdates="), Settings.ActiveUpdates);
+	FParse::Value(*Params, TEXT("Warmup="), Settings.WarmupUpdates);
+	FParse::Value(*Params, TEXT("Updates="), Settings.MeasuredUpdates);
+	FParse::Value(*Params, TEXT("PerceptionEvery="), Settings.PerceptionEvery);
+	Settings.Record = FParse::Param(*Params, TEXT("Record"));
+
+	Settings.TasksPerAgent = FMath::Clamp(Settings.TasksPerAgent, 1, 256);
+	Settings.ChainDepth = FMath::Clamp(Settings.ChainDepth, 0, 16);
+	Settings.ActiveUpdates = FMath::Max(Settings.ActiveUpdates, 1);
+	Settings.WarmupUpdates = FMath::Max(Settings.WarmupUpdates, 0);
+	Settings.MeasuredUpdates = FMath::Max(Settings.MeasuredUpdates, 1);
+
+	FString SizesParam = TEXT("10,100,1000,10000");
+	FParse::Value(*Params, TEXT("Sizes="), SizesParam, false);
+
+	TArray<FString> SizeStrings;
+	SizesParam.ParseIntoArray(SizeStrings, TEXT(","));
+
+	TArray<int32> Sizes;
+	for (const FString& SizeString : SizeStrings)
+	{
+		const int32 Size = FCString::Atoi(*SizeString);
+		if (Size > 0)
+		{
+			Sizes.Add(Size);
+		}
+	}
+
+	if (Sizes.Num() == 0)
+	{
+		UE_LOG(LogRAIEditor, Error, TEXT("No valid agent counts in -Sizes=%s"), *SizesParam);
+		return 1;
+	}
+
+	IConsoleVariable* RecorderEnabled = IConsoleManager::Get().FindConsoleVariable(TEXT("rai.Recorder.Enabled"));
+	const int32 RecorderWasEnabled = RecorderEnabled ? RecorderEnabled->GetInt() : 0;
+	if (RecorderEnabled)
+	{
+		RecorderEnabled->Set(Settings.Record ? 1 : 0, ECVF_SetByCode);
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("RAIBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	const TArray<URAIConsiderationSet*> ConsiderationSets = CreateConsiderationSets(Settings.TasksPerAgent);
+
+	UE_LOG(LogRAIEditor, Display, TEXT("RAI benchmark: %d tasks per agent, chain depth %d, %d measured updates"),
+	       Settings.TasksPerAgent, Settings.ChainDepth, Settings.MeasuredUpdates);
+	if (!IsMemoryTracked())
+	{
+		UE_LOG(LogRAIEditor, Warning, TEXT("Memory per agent is only measured with -llm, reporting 0"));
+	}
+
+	TArray<FRAIBenchmarkResult> Results;
+	for (const int32 Size : Sizes)
+	{
+		const FRAIBenchmarkResult& Result = Results.Add_GetRef(RunBenchmark(World, Size, ConsiderationSets, Settings));
+		UE_LOG(LogRAIEditor, Display, TEXT("%6d agents: %9.1f ns/update  %7.3f allocs/update  %8.0f bytes/agent  %.3f task begins/update"),
+		       Result.Agents, Result.NsPerUpdate, Result.AllocsPerUpdate, Result.PeakBytesPerAgent, Result.TaskBeginsPerUpdate);
+	}
+
+	for (URAIConsiderationSet* Set : ConsiderationSets)
+	{
+		Set->RemoveFromRoot();
+	}
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	if (RecorderEnabled)
+	{
+		RecorderEnabled->Set(RecorderWasEnabled, ECVF_SetByCode);
+	}
+
+	FString CsvPath;
+	if (FParse::Value(*Params, TEXT("Csv="), CsvPath))
+	{
+		if (!FFileHelper::SaveStringToFile(ResultsToCsv(Results), *CsvPath))
+		{
+			UE_LOG(LogRAIEditor, Error, TEXT("Could not write %s"), *CsvPath);
+			return 1;
+		}
+	}
+
+	FString BaselinePath;
+	if (FParse::Value(*Params, TEXT("Baseline="), BaselinePath))
+	{
+		float Tolerance = 0.25f;
+		FParse::Value(*Params, TEXT("Tolerance="), Tolerance);
+
+		const int32 Regressions = CompareToBaseline(BaselinePath, Results, Tolerance);
+		if (Regressions > 0)
+		{
+			UE_LOG(LogRAIEditor, Error, TEXT("RAI benchmark regressed in %d measurements compared to %s"), Regressions, *BaselinePath);
+			return 1;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,413 @@
+// Copyright Rancorous Games, 2024
+
+#include "Commandlets/RAITraceAnalyzerCommandlet.h"
+
+#include "RAIDecisionRecorder.h"
+#include "RAIEditorLogCategory.h"
+#include "Algo/StableSort.h"
+#include "Dom/JsonObject.h"
+#include "HAL/FileManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonSerializer.h"
+#include "Serialization/JsonWriter.h"
+
+struct FRAITraceAgentStats
+{
+	uint32 AgentId = 0;
+	double FirstTime = TNumericLimits<double>::Max();
+	double LastTime = TNumericLimits<double>::Lowest();
+	int32 Enters = 0;
+	int32 Interrupts = 0;
+	int32 Restarts = 0;
+	int32 LoopPenalties = 0;
+	int32 Reinvokes = 0;
+	int32 WaitTimeouts = 0;
+	int32 StaleEnters = 0;
+	int32 CachedEnters = 0;
+
+	double GetMinutes() const { return FMath::Max((LastTime - FirstTime) / 60.0, 1.0 / 60.0); }
+	double GetThrashPerMinute() const { return (Interrupts + Restarts) / GetMinutes(); }
+};
+
+struct FRAITraceTaskStats
+{
+	FString Name;
+	TArray<float> Durations;
+	int32 Enters = 0;
+	int32 Restarts = 0;
+	int32 TimesInterrupted = 0;
+	int32 LoopPenalties = 0;
+	int32 Reinvokes = 0;
+	int32 WaitTimeouts = 0;
+	int32 StaleEnters = 0;
+	int32 CachedEnters = 0;
+	double TotalSeconds = 0.0;
+};
+
+static float GetPercentile(const TArray<float>& SortedValues, float Percentile)
+{
+	if (SortedValues.Num() == 0)
+	{
+		return 0.f;
+	}
+
+	const int32 Index = FMath::Clamp(FMath::CeilToInt32(Percentile * SortedValues.Num()) - 1, 0, SortedValues.Num() - 1);
+	return SortedValues[Index];
+}
+
+static FString FindNewestTrace()
+{
+	const FString Directory = FPaths::ProjectSavedDir() / TEXT("RAITrace");
+	TArray<FString> Files;
+	IFileManager::Get().FindFiles(Files, *(Directory / TEXT("*.rai")), true, false);
+
+	FString Newest;
+	FDateTime NewestTime = FDateTime::MinValue();
+	for (const FString& File : Files)
+	{
+		const FString Path = Directory / File;
+		const FDateTime TimeStamp = IFileManager::Get().GetTimeStamp(*Path);
+		if (TimeStamp > NewestTime)
+		{
+			NewestTime = TimeStamp;
+			Newest = Path;
+		}
+	}
+
+	return Newest;
+}
+
+static bool LoadTrace(const FString& Path, FRAIDecisionFileHeader& OutHeader, TArray<FRAIDecisionEvent>& OutEvents)
+{
+	// The recording session may still be running, allow it to keep writing
+	TUniquePtr<FArchive> Reader(IFileManager::Get().CreateFileReader(*Path, FILEREAD_AllowWrite));
+	if (!Reader || Reader->TotalSize() < static_cast<int64>(sizeof(FRAIDecisionFileHeader)))
+	{
+		UE_LOG(LogRAIEditor, Error, TEXT("Could not read trace %s"), *Path);
+		return false;
+	}
+
+	Reader->Serialize(&OutHeader, sizeof(FRAIDecisionFileHeader));
+	if (OutHeader.Magic != FRAIDecisionFileHeader::ExpectedMagic || OutHeader.Version != FRAIDecisionFileHeader::CurrentVersion ||
+		OutHeader.EventSize != sizeof(FRAIDecisionEvent) || OutHeader.Capacity == 0)
+	{
+		UE_LOG(LogRAIEditor, Error, TEXT("%s is not a version %u RAI decision trace"), *Path, FRAIDecisionFileHeader::CurrentVersion);
+		return false;
+	}
+
+	// Once the ring wrapped, the oldest event is the one the next write would overwrite
+	const uint64 Capacity = OutHeader.Capacity;
+	const uint64 StoredCount = FMath::Min(OutHeader.TotalEvents, Capacity);
+	const uint64 OldestSlot = OutHeader.TotalEvents > Capacity ? OutHeader.TotalEvents % Capacity : 0;
+	const uint64 FirstCount = FMath::Min(StoredCount, Capacity - OldestSlot);
+
+	OutEvents.SetNumUninitialized(static_cast<int32>(StoredCount));
+	Reader->Seek(sizeof(FRAIDecisionFileHeader) + OldestSlot * sizeof(FRAIDecisionEvent));
+	Reader->Serialize(OutEvents.GetData(), FirstCount * sizeof(FRAIDecisionEvent));
+	if (StoredCount > FirstCount)
+	{
+		Reader->Seek(sizeof(FRAIDecisionFileHeader));
+		Reader->Serialize(OutEvents.GetData() + FirstCount, (StoredCount - FirstCount) * sizeof(FRAIDecisionEvent));
+	}
+
+	// Threads flush in batches, restore the global order
+	Algo::StableSortBy(OutEvents, &FRAIDecisionEvent::WorldTime);
+	return !Reader->IsError();
+}
+
+static void LoadNames(const FString& Path, TMap<uint32, FString>& OutNames)
+{
+	TArray<FString> Lines;
+	FFileHelper::LoadFileToStringArray(Lines, *Path);
+
+	for (const FString& Line : Lines)
+	{
+		FString Id;
+		FString Name;
+		if (Line.Split(TEXT("\t"), &Id, &Name))
+		{
+			OutNames.Add(static_cast<uint32>(FCString::Strtoui64(*Id, nullptr, 10)), Name);
+		}
+	}
+}
+
+URAITraceAnalyzerCommandlet::URAITraceAnalyzerCommandlet()
+{
+	IsClient = false;
+	IsEditor = false;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+int32 URAITraceAnalyzerCommandlet::Main(const FString& Params)
+{
+	FString TracePath;
+	if (!FParse::Value(*Params, TEXT("Trace="), TracePath))
+	{
+		TracePath = FindNewestTrace();
+	}
+
+	if (TracePath.IsEmpty())
+	{
+		UE_LOG(LogRAIEditor, Error, TEXT("No trace given and none found in Saved/RAITrace. Usage: -run=RAITraceAnalyzer -Trace=<file.rai>"));
+		return 1;
+	}
+
+	FString OutputDirectory = FPaths::GetPath(TracePath);
+	FParse::Value(*Params, TEXT("Out="), OutputDirectory);
+
+	float StaleSeconds = 2.f;
+	FParse::Value(*Params, TEXT("StaleSeconds="), StaleSeconds);
+
+	float RestartWindow = 2.f;
+	FParse::Value(*Params, TEXT("RestartWindow="), RestartWindow);
+
+	FRAIDecisionFileHeader Header;
+	TArray<FRAIDecisionEvent> Events;
+	if (!LoadTrace(TracePath, Header, Events))
+	{
+		return 1;
+	}
+
+	TMap<uint32, FString> Names;
+	LoadNames(FRAIDecisionRecorder::GetNamesFilePath(TracePath), Names);
+
+	UE_LOG(LogRAIEditor, Display, TEXT("Analyzing %d events of %s (%llu recorded, %llu dropped)"), Events.Num(), *TracePath,
+	       Header.TotalEvents, Header.DroppedEvents);
+
+	TMap<uint32, FRAITraceAgentStats> Agents;
+	TMap<uint32, FRAITraceTaskStats> Tasks;
+
+	// Keyed by agent and task name
+	auto MakeKey = [](const FRAIDecisionEvent& Event) { return (static_cast<uint64>(Event.AgentId) << 32) | Event.TaskNameId; };
+	TMap<uint64, double> EnterTimes;
+	TMap<uint64, double> ExitTimes;
+	TMap<uint64, double> SnapshotTimes;
+
+	auto GetTask = [&Tasks, &Names](uint32 NameId) -> FRAITraceTaskStats&
+	{
+		FRAITraceTaskStats& Task = Tasks.FindOrAdd(NameId);
+		if (Task.Name.IsEmpty())
+		{
+			const FString* Name = Names.Find(NameId);
+			Task.Name = Name ? *Name : FString::Printf(TEXT("Name%u"), NameId);
+		}
+		return Task;
+	};
+
+	for (const FRAIDecisionEvent& Event : Events)
+	{
+		FRAITraceAgentStats& Agent = Agents.FindOrAdd(Event.AgentId);
+		Agent.AgentId = Event.AgentId;
+		Agent.FirstTime = FMath::Min(Agent.FirstTime, Event.WorldTime);
+		Agent.LastTime = FMath::Max(Agent.LastTime, Event.WorldTime);
+
+		const uint64 Key = MakeKey(Event);
+
+		switch (Event.Type)
+		{
+		case ERAIDecisionEventType::TaskEnter:
+			{
+				FRAITraceTaskStats& Task = GetTask(Event.TaskNameId);
+				Agent.Enters++;
+				Task.Enters++;
+
+				const double* ExitTime = ExitTimes.Find(Key);
+				if (ExitTime && Event.WorldTime - *ExitTime <= RestartWindow)
+				{
+					Agent.Restarts++;
+					Task.Restarts++;
+				}
+
+				// Only primary tasks are scored, invoked tasks never have a snapshot
+				const double* SnapshotTime = SnapshotTimes.Find(Key);
+				if (SnapshotTime && Event.WorldTime - *SnapshotTime > StaleSeconds)
+				{
+					Agent.StaleEnters++;
+					Task.StaleEnters++;
+				}
+
+				EnterTimes.Add(Key, Event.WorldTime);
+				break;
+			}
+
+		case ERAIDecisionEventType::TaskExit:
+			{
+				double EnterTime;
+				if (EnterTimes.RemoveAndCopyValue(Key, EnterTime))
+				{
+					FRAITraceTaskStats& Task = GetTask(Event.TaskNameId);
+					const float Duration = static_cast<float>(Event.WorldTime - EnterTime);
+					Task.Durations.Add(Duration);
+					Task.TotalSeconds += Duration;
+				}
+
+				ExitTimes.Add(Key, Event.WorldTime);
+				break;
+			}
+
+		case ERAIDecisionEventType::TaskInterrupt:
+			Agent.Interrupts++;
+			GetTask(Event.OtherNameId).TimesInterrupted++;
+			break;
+
+		case ERAIDecisionEventType::PrioritySnapshot:
+			SnapshotTimes.Add(Key, Event.WorldTime);
+			break;
+
+		// The priority was kept on purpose, by dependency tracking or a field that does not rescore, so the start is not stale
+		case ERAIDecisionEventType::PriorityCacheHit:
+			SnapshotTimes.Add(Key, Event.WorldTime);
+			Agent.CachedEnters++;
+			GetTask(Event.TaskNameId).CachedEnters++;
+			break;
+
+		case ERAIDecisionEventType::LoopDetected:
+			Agent.LoopPenalties++;
+			GetTask(Event.TaskNameId).LoopPenalties++;
+			break;
+
+		case ERAIDecisionEventType::ReinvokeFallback:
+			Agent.Reinvokes++;
+			GetTask(Event.TaskNameId).Reinvokes++;
+			break;
+
+		case ERAIDecisionEventType::WaitTimeout:
+			Agent.WaitTimeouts++;
+			GetTask(Event.TaskNameId).WaitTimeouts++;
+			break;
+
+		case ERAIDecisionEventType::TaskInvoke:
+		case ERAIDecisionEventType::TaskReturn:
+		default:
+			break;
+		}
+	}
+
+	TArray<FRAITraceAgentStats> SortedAgents;
+	Agents.GenerateValueArray(SortedAgents);
+	SortedAgents.Sort([](const FRAITraceAgentStats& A, const FRAITraceAgentStats& B) { return A.GetThrashPerMinute() > B.GetThrashPerMinute(); });
+
+	TArray<FRAITraceTaskStats> SortedTasks;
+	Tasks.GenerateValueArray(SortedTasks);
+	SortedTasks.Sort([](const FRAITraceTaskStats& A, const FRAITraceTaskStats& B) { return A.TotalSeconds > B.TotalSeconds; });
+	for (FRAITraceTaskStats& Task : SortedTasks)
+	{
+		Task.Durations.Sort();
+	}
+
+	// Agents.csv
+	FString AgentsCsv = TEXT("AgentId,Minutes,Enters,Interrupts,Restarts,ThrashPerMinute,LoopPenalties,Reinvokes,WaitTimeouts,StaleEnters,CachedEnters\n");
+	for (const FRAITraceAgentStats& Agent : SortedAgents)
+	{
+		AgentsCsv += FString::Printf(TEXT("%u,%.3f,%d,%d,%d,%.3f,%d,%d,%d,%d,%d\n"), Agent.AgentId, Agent.GetMinutes(), Agent.Enters, Agent.Interrupts,
+		                             Agent.Restarts, Agent.GetThrashPerMinute(), Agent.LoopPenalties, Agent.Reinvokes, Agent.WaitTimeouts,
+		                             Agent.StaleEnters, Agent.CachedEnters);
+	}
+
+	// Tasks.csv
+	FString TasksCsv = TEXT("Task,Enters,Completed,TotalSeconds,MeanSeconds,P50Seconds,P90Seconds,P99Seconds,MaxSeconds,Restarts,TimesInterrupted,LoopPenalties,Reinvokes,WaitTimeouts,StaleEnters,CachedEnters\n");
+	for (const FRAITraceTaskStats& Task : SortedTasks)
+	{
+		const int32 Completed = Task.Durations.Num();
+		TasksCsv += FString::Printf(TEXT("%s,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%d,%d,%d,%d,%d,%d,%d\n"), *Task.Name, Task.Enters, Completed,
+		                            Task.TotalSeconds, Completed > 0 ? Task.TotalSeconds / Completed : 0.0,
+		                            GetPercentile(Task.Durations, 0.5f), GetPercentile(Task.Durations, 0.9f), GetPercentile(Task.Durations, 0.99f),
+		                            Completed > 0 ? Task.Durations.Last() : 0.f, Task.Restarts, Task.TimesInterrupted, Task.LoopPenalties,
+		                            Task.Reinvokes, Task.WaitTimeouts, Task.StaleEnters, Task.CachedEnters);
+	}
+
+	// Summary.json
+	TSharedRef<FJsonObject> Summary = MakeShared<FJsonObject>();
+	Summary->SetStringField(TEXT("Trace"), TracePath);
+	Summary->SetNumberField(TEXT("RecordedEvents"), static_cast<double>(Header.TotalEvents));
+	Summary->SetNumberField(TEXT("AnalyzedEvents"), Events.Num());
+	Summary->SetNumberField(TEXT("DroppedEvents"), static_cast<double>(Header.DroppedEvents));
+	Summary->SetNumberField(TEXT("Agents"), SortedAgents.Num());
+	Summary->SetNumberField(TEXT("DurationSeconds"), Events.Num() > 0 ? Events.Last().WorldTime - Events[0].WorldTime : 0.0);
+
+	FRAITraceAgentStats Totals;
+	for (const FRAITraceAgentStats& Agent : SortedAgents)
+	{
+		Totals.Enters += Agent.Enters;
+		Totals.Interrupts += Agent.Interrupts;
+		Totals.Restarts += Agent.Restarts;
+		Totals.LoopPenalties += Agent.LoopPenalties;
+		Totals.Reinvokes += Agent.Reinvokes;
+		Totals.WaitTimeouts += Agent.WaitTimeouts;
+		Totals.StaleEnters += Agent.StaleEnters;
+		Totals.CachedEnters += Agent.CachedEnters;
+	}
+
+	TSharedRef<FJsonObject> TotalsObject = MakeShared<FJsonObject>();
+	TotalsObject->SetNumberField(TEXT("Enters"), Totals.Enters);
+	TotalsObject->SetNumberField(TEXT("Interrupts"), Totals.Interrupts);
+	TotalsObject->SetNumberField(TEXT("Restarts"), Totals.Restarts);
+	TotalsObject->SetNumberField(TEXT("LoopPenalties"), Totals.LoopPenalties);
+	TotalsObject->SetNumberField(TEXT("Reinvokes"), Totals.Reinvokes);
+	TotalsObject->SetNumberField(TEXT("WaitTimeouts"), Totals.WaitTimeouts);
+	TotalsObject->SetNumberField(TEXT("StaleEnters"), Totals.StaleEnters);
+	TotalsObject->SetNumberField(TEXT("CachedEnters"), Totals.CachedEnters);
+	Summary->SetObjectField(TEXT("Totals"), TotalsObject);
+
+	constexpr int32 TopCount = 10;
+	auto MakeAgentArray = [TopCount](const TArray<FRAITraceAgentStats>& Source)
+	{
+		TArray<TSharedPtr<FJsonValue>> Array;
+		for (int32 Index = 0; Index < FMath::Min(TopCount, Source.Num()); ++Index)
+		{
+			const FRAITraceAgentStats& Agent = Source[Index];
+			TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+			Object->SetNumberField(TEXT("AgentId"), Agent.AgentId);
+			Object->SetNumberField(TEXT("ThrashPerMinute"), Agent.GetThrashPerMinute());
+			Object->SetNumberField(TEXT("Interrupts"), Agent.Interrupts);
+			Object->SetNumberField(TEXT("Restarts"), Agent.Restarts);
+			Object->SetNumberField(TEXT("LoopPenalties"), Agent.LoopPenalties);
+			Object->SetNumberField(TEXT("Reinvokes"), Agent.Reinvokes);
+			Array.Add(MakeShared<FJsonValueObject>(Object));
+		}
+		return Array;
+	};
+
+	Summary->SetArrayField(TEXT("TopThrashingAgents"), MakeAgentArray(SortedAgents));
+
+	TArray<FRAITraceAgentStats> ByLoopPenalties = SortedAgents;
+	ByLoopPenalties.Sort([](const FRAITraceAgentStats& A, const FRAITraceAgentStats& B) { return A.LoopPenalties > B.LoopPenalties; });
+	Summary->SetArrayField(TEXT("TopLoopPenaltyAgents"), MakeAgentArray(ByLoopPenalties));
+
+	TArray<TSharedPtr<FJsonValue>> TaskArray;
+	for (const FRAITraceTaskStats& Task : SortedTasks)
+	{
+		TSharedRef<FJsonObject> Object = MakeShared<FJsonObject>();
+		Object->SetStringField(TEXT("Task"), Task.Name);
+		Object->SetNumberField(TEXT("Enters"), Task.Enters);
+		Object->SetNumberField(TEXT("TotalSeconds"), Task.TotalSeconds);
+		Object->SetNumberField(TEXT("P50Seconds"), GetPercentile(Task.Durations, 0.5f));
+		Object->SetNumberField(TEXT("P90Seconds"), GetPercentile(Task.Durations, 0.9f));
+		Object->SetNumberField(TEXT("P99Seconds"), GetPercentile(Task.Durations, 0.99f));
+		Object->SetNumberField(TEXT("StaleEnters"), Task.StaleEnters);
+		Object->SetNumberField(TEXT("CachedEnters"), Task.CachedEnters);
+		TaskArray.Add(MakeShared<FJsonValueObject>(Object));
+	}
+	Summary->SetArrayField(TEXT("Tasks"), TaskArray);
+
+	FString SummaryJson;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&SummaryJson);
+	FJsonSerializer::Serialize(Summary, Writer);
+
+	const FString AgentsPath = OutputDirectory / TEXT("Agents.csv");
+	const FString TasksPath = OutputDirectory / TEXT("Tasks.csv");
+	const FString SummaryPath = OutputDirectory / TEXT("Summary.json");
+	if (!FFileHelper::SaveStringToFile(AgentsCsv, *AgentsPath) || !FFileHelper::SaveStringToFile(TasksCsv, *TasksPath) ||
+		!FFileHelper::SaveStringToFile(SummaryJson, *SummaryPath))
+	{
+		UE_LOG(LogRAIEditor, Error, TEXT("Could not write the analysis to %s"), *OutputDirectory);
+		return 1;
+	}
+
+	UE_LOG(LogRAIEditor, Display, TEXT("%d agents, %d interrupts, %d restarts, %d loop penalties, %d reinvoke fallbacks, %d stale task starts"),
+	       SortedAgents.Num(), Totals.Interrupts, Totals.Restarts, Totals.LoopPenalties, Totals.Reinvokes, Totals.StaleEnters);
+	UE_LOG(LogRAIEditor, Display, TEXT("Wrote %s, %s and %s"), *AgentsPath, *TasksPath, *SummaryPath);
+	return 0;
+}
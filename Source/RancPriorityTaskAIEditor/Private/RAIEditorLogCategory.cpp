@@ -0,0 +1,5 @@
+﻿// Copyright Rancorous Games, 2024
+
+#include "RAIEditorLogCategory.h"
+
+DEFINE_LOG_CATEGORY(LogRAIEditor);
@@ -0,0 +1,7 @@
+﻿// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include <Logging/LogMacros.h>
+
+DECLARE_LOG_CATEGORY_EXTERN(LogRAIEditor, Display, All);
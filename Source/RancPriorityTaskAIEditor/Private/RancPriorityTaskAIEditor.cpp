@@ -0,0 +1,6 @@
+// Copyright Epic Games, Inc. All Rights Reserved.
+
+#include "Modules/ModuleManager.h"
+
+// Holds the commandlets, which have no reason to ship with the game
+IMPLEMENT_MODULE(FDefaultModuleImpl, RancPriorityTaskAIEditor)
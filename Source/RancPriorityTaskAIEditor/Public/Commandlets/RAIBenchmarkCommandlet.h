@@ -0,0 +1,61 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RAITaskComponent.h"
+#include "RAIBenchmarkCommandlet.generated.h"
+
+/**
+ * Synthetic native task driven by URAIBenchmarkCommandlet. A task with a NextInChain invokes it when it begins, the last task of
+ * a chain stays active for ActiveUpdates benchmark updates, after which the chain unwinds by one EndTask per update.
+ */
+UCLASS(NotBlueprintable, Transient, ClassGroup=(RAI))
+class RANCPRIORITYTASKAIEDITOR_API URAIBenchmarkTask : public URAITaskComponent
+{
+	GENERATED_BODY()
+
+public:
+
+	/* Task invoked when this task begins, invalid for the last task of a chain */
+	FRAITaskHandle NextInChain;
+
+	/* How many benchmark updates the last task of a chain stays active */
+	int32 ActiveUpdates = 1;
+
+	/* Called by the benchmark once per update on the active task of each agent */
+	void StepBenchmark();
+
+protected:
+
+	virtual void BeginTask_Implementation(const FRAITaskInvokeArguments& InvokeArguments) override;
+
+	virtual void OnPerceptionStimulus_Implementation(AActor* Actor, FAIStimulus Stimulus) override;
+
+	int32 RemainingUpdates = 0;
+	int32 StimuliReceived = 0;
+};
+
+/**
+ * Headless scale benchmark of the manager and task lifecycle, needs no content and runs with -nullrhi on any desktop platform.
+ * Spawns synthetic agents with native tasks and drives UpdateActiveTasks, InvokeTask chains, EndTask unwinding and perception
+ * fan-out directly, without ticking the world. Stimuli go through the manager's perception queue like the controller's.
+ * Reports ns per agent update, allocator calls per agent update and, with -llm, peak memory per agent, the pawns excluded.
+ *
+ * Usage: -run=RAIBenchmark -nullrhi [-llm] [-Sizes=10,100,1000,10000] [-Tasks=8] [-ChainDepth=2] [-ActiveUpdates=5] [-Updates=100]
+ *        [-PerceptionEvery=4] [-Csv=<file>] [-Baseline=<file>] [-Tolerance=0.25] [-Record]
+ * With -Baseline the results are compared to an earlier -Csv output and the commandlet fails if ns or allocations per update
+ * regressed by more than Tolerance. The decision recorder is disabled unless -Record is given.
+ */
+UCLASS()
+class RANCPRIORITYTASKAIEDITOR_API URAIBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	URAIBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};
@@ -0,0 +1,29 @@
+// Copyright Rancorous Games, 2024
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "RAITraceAnalyzerCommandlet.generated.h"
+
+/**
+ * Offline analysis of a decision trace written by FRAIDecisionRecorder.
+ * Reports task thrashing, time spent in each task, loop detection penalties, reinvoke fallbacks and tasks begun on stale priorities.
+ *
+ * Usage: -run=RAITraceAnalyzer [-Trace=<file.rai>] [-Out=<directory>] [-StaleSeconds=2] [-RestartWindow=2]
+ * StaleSeconds must be longer than the rai.Recorder.SnapshotKeyframe the trace was recorded with. Starts on a priority that was
+ * kept from an earlier update on purpose are recorded as PriorityCacheHit and reported as CachedEnters instead of stale.
+ * Without -Trace the newest trace in Saved/RAITrace is analyzed. Writes Agents.csv, Tasks.csv and Summary.json to the output
+ * directory, which defaults to the folder of the trace.
+ */
+UCLASS()
+class RANCPRIORITYTASKAIEDITOR_API URAITraceAnalyzerCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	URAITraceAnalyzerCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+};